@@ -13,8 +13,6 @@
 #define min(a, b) ((a < b) ? a : b)
 #define max(a, b) ((a > b) ? a : b)
 
-#define maxAgents 6000000
-
 #define TIMING 0
 
 #define MEASURE_START ICL_STARTED
@@ -16,6 +16,12 @@
 #define LOCAL_SIZE 64
 #endif
 
+// number of consecutive agents processed by each work-item of the coarsened kernels, which replace killAgents, updateAgents and killUpdateAgents if it
+// is greater than one. Passed as build option, see -coarsening
+#ifndef COARSENING
+#define COARSENING 1
+#endif
+
 
 typedef REAL Temperature;
 
@@ -122,6 +128,14 @@ struct Population {
 	UINT numPotentiallyInfective;
 };
 
+// the agents of a population as a list of spans of consecutive slots, one per state range, written once per time step by the agentSpans kernel. The
+// kernels number their work-items over the spans one after another, see agentSlot
+struct AgentSpans {
+	UINT start[8]; // first slot of the span of each state
+	UINT firstItem[8 + 1]; // work-item of the first agent of each span, followed by the number of agents in all spans
+	UINT end; // end of the gravids, the slot of the work-items without agent
+};
+
 struct Stats {
 	// aquatic
 	UINT numEggs;
@@ -141,7 +155,61 @@ struct Stats {
 	UINT numMales;
 };
 
-//store random seeds generated on cpu to generate ranodm numbers on GPU
+// replicates are independent populations of the same scenario, stored one after another in all buffers. The kernels are launched with the replicate in
+// dimension 1, REPLICATE_CAPACITY is the maximum number of agents of each replicate and passed as build option
+#define REPLICATE ((UINT)get_global_id(1))
+#define AGENT_OFFSET (REPLICATE * REPLICATE_CAPACITY)
+// each replicate consists of NUM_PATCHES populations, one for each patch. The patch of an agent is given by the population it is stored in. The forcing
+// table holds FORCING_TABLE_ROWS rows for each patch, both are passed as build options
+#define PATCH (REPLICATE % NUM_PATCHES)
+#define FORCING_ROW(row) (PATCH * FORCING_TABLE_ROWS + (row))
+// number of partial sums of each replicate in the buffer of calcL1de and calcGender
+#define PARTIAL_SUMS (2 * LOCAL_SIZE)
+
+// the state ranges of a population start at multiples of RANGE_ALIGNMENT agents, with a gap of at least one agent after the previous range which the
+// chunked scan needs. Passed as build option, see WorkSizes, and independent of the work-group sizes since the kernels map their work-items to the
+// agents with agentSlot
+#ifndef RANGE_ALIGNMENT
+#define RANGE_ALIGNMENT 64
+#endif
+#define ALIGN_RANGE(end) ((((end) + RANGE_ALIGNMENT) / RANGE_ALIGNMENT) * RANGE_ALIGNMENT)
+
+#ifdef __OPENCL_VERSION__
+/*
+ * maps a work-item to the slot of an agent. The work-items are numbered over the spans of a population one after another, skipping the gaps between
+ * them like importAgents does for the imported agents, so no work-item tests for the gaps. Its span is found with a binary search over the first
+ * work-items of the spans
+ * @param spans the spans of the work-item's population
+ * @param item the index of the work-item, less than spans->firstItem[8] for all work-items with an agent
+ * @return the slot of the agent, or the end of the gravids if item is beyond the last agent
+ */
+UINT agentSlot(__constant struct AgentSpans* spans, UINT item) {
+	// the last span starting at or before item, empty spans start at the same item as the next one and are passed over
+	UINT s = (item >= spans->firstItem[4]) ? 4 : 0;
+	s += (item >= spans->firstItem[s + 2]) ? 2 : 0;
+	s += (item >= spans->firstItem[s + 1]) ? 1 : 0;
+	return (item < spans->firstItem[8]) ? spans->start[s] + item - spans->firstItem[s] : spans->end;
+}
+#endif
+
+// the hourly mortality rate of an agent depends only on its state range, on its age in days (capped at 99) for adults and larvae, and on the larvae 1 day
+// equivalent and the carrying capacity of its population for larvae. It is tabulated once per time step and population, the agents only look up their
+// entry: one per age in days for adults and larvae, followed by one for eggs and one for pupae
+#define MORTALITY_DAYS 100
+#define MORTALITY_ADULT 0
+#define MORTALITY_LARVA MORTALITY_DAYS
+#define MORTALITY_EGG (2 * MORTALITY_DAYS)
+#define MORTALITY_PUPA (2 * MORTALITY_DAYS + 1)
+#define MORTALITY_TABLE_SIZE (2 * MORTALITY_DAYS + 2)
+
+// population and bites and cycles at the start of a time step, recorded on the device in a ring buffer that is drained by the host every few steps
+struct StatsRecord {
+	struct Population pop;
+	struct BitesNcycles bnc;
+};
+
+// key and counter of the counter based random number generator: z1 and z2 hold the run seed, z3 the time step and z4 the index of the seed,
+// which is combined with the replicate. Set once on the host, the time step is advanced on the device
 struct Seeds {
 	UINT z1;
 	UINT z2;
@@ -0,0 +1,61 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ */
+#pragma once
+
+#include "agent.h"
+
+/*
+ * header of a checkpoint file. It is followed by the populations (two per replicate), the eggs and biomass and the bites and cycles of each replicate,
+ * the seeds and the agents, agent ages and agent states of the living ranges of each replicate's current population, without the gaps between them
+ */
+struct CheckpointHeader {
+	char magic[8];
+	UINT step; // the time step the simulation continues with
+	UINT numReplicates;
+	UINT nSeeds;
+	UINT numAgents; // number of agents stored, the sum of the lengths of all ranges
+	UINT agentSizes[3]; // sizes of struct Agent, AgentAge and AgentState, to reject checkpoints of another build
+	unsigned long long runSeed;
+};
+
+/*
+ * the state of a simulation at the start of a time step in host memory
+ */
+struct Checkpoint {
+	struct CheckpointHeader header;
+	struct Population* pops;
+	struct EggsNbiomass* enb;
+	struct BitesNcycles* bnc;
+	struct Seeds* seeds;
+	struct Agent* agents;
+	struct AgentAge* agentAges;
+	struct AgentState* agentStates;
+};
+
+/*
+ * allocates a checkpoint for the given populations, the current one of replicate r is at pops[2 * r]
+ * @param pops the populations of all replicates, copied to the checkpoint
+ * @return the checkpoint, the state except the populations still has to be filled in
+ */
+struct Checkpoint* createCheckpoint(UINT step, UINT numReplicates, UINT nSeeds, unsigned long long runSeed, struct Population* pops);
+
+/*
+ * @return the range of state s (0 for EGG to 7 for GRAVID) of a population
+ */
+struct AgentRange* checkpointRange(struct Population* pop, UINT s);
+
+/*
+ * writes a checkpoint to a temporary file which replaces path once it is complete, such that an interrupted write keeps the previous checkpoint
+ * @return 0 on success, -1 otherwise
+ */
+int writeCheckpoint(const char* path, struct Checkpoint* cp);
+
+/*
+ * reads a checkpoint written by writeCheckpoint
+ * @return the checkpoint, or NULL if the file cannot be read or was written by an incompatible build
+ */
+struct Checkpoint* readCheckpoint(const char* path);
+
+void releaseCheckpoint(struct Checkpoint* cp);
@@ -9,8 +9,9 @@
 #define UINT uint
 #define BOOL bool
 
-// only for eclipse/VS for syntax highlighting and to avoid warnings
+// only for eclipse/VS for syntax highlighting and to avoid warnings. Also used to compile the model functions for the host engine
 #ifndef __OPENCL_VERSION__
+typedef unsigned int uint;
 /* Define out keywords causing errors */
 #define __kernel
 #define __global
@@ -26,3 +27,18 @@
 #else
 #define align /*__attribute__ ((aligned))*/
 #endif
+
+// math functions of the hot paths. Kernels built with -DFAST_MATH (option -fastmath) use the native built-ins, which are faster but less accurate
+#if defined(__OPENCL_VERSION__) && defined(FAST_MATH)
+#define MATH_EXP(x) native_exp(x)
+#define MATH_POW(x, y) native_powr(x, y)
+#define MATH_LOG(x) native_log(x)
+#define MATH_SIN(x) native_sin(x)
+#define MATH_SQRT(x) native_sqrt(x)
+#else
+#define MATH_EXP(x) exp(x)
+#define MATH_POW(x, y) pow(x, y)
+#define MATH_LOG(x) log(x)
+#define MATH_SIN(x) sin(x)
+#define MATH_SQRT(x) sqrt(x)
+#endif
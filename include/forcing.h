@@ -0,0 +1,64 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ */
+#pragma once
+
+#include "agent.h"
+
+// kinds of records stored in a binary forcing file
+#define FORCING_TEMPERATURE 0 // one Temperature per time step
+#define FORCING_ENVIRONMENT 1 // one struct Environment per time step
+
+/*
+ * header of a binary forcing file, followed by numSteps records of recordSize bytes. The records are stored in the layout used by the simulation,
+ * such that a mapped file is used without any conversion
+ */
+struct ForcingHeader {
+	char magic[8];
+	UINT kind; // FORCING_TEMPERATURE or FORCING_ENVIRONMENT
+	UINT recordSize; // size of one record, to reject files of another build
+	UINT numSteps;
+	REAL hoursInTimeStep;
+	UINT reserved[2];
+};
+
+/*
+ * @return true if path is a binary forcing file, false if it is a text file or cannot be opened
+ */
+bool isForcingFile(const char* path);
+
+/*
+ * writes a binary forcing file
+ * @param records numSteps records of recordSize bytes
+ * @return 0 on success, -1 otherwise
+ */
+int writeForcing(const char* path, UINT kind, UINT recordSize, UINT numSteps, REAL hoursInTimeStep, const void* records);
+
+/*
+ * maps a binary forcing file read-only into memory
+ * @param kind the kind of records expected
+ * @param recordSize the size of the records expected
+ * @param header will hold the header of the file
+ * @return the records of the file, or NULL if it cannot be mapped or holds other records. Released with unmapForcing
+ */
+void* mapForcing(const char* path, UINT kind, UINT recordSize, struct ForcingHeader* header);
+
+void unmapForcing(void* records);
+
+/*
+ * parses a temperature text file, holding one value per time step
+ * @param temperature will hold the allocated temperatures
+ * @param numSteps the number of time steps to read, or 0 to read the whole file
+ * @return the number of time steps read, which is less than numSteps if the file is short, or -1 if the file cannot be opened
+ */
+long long readTemperatureText(const char* path, Temperature** temperature, UINT numSteps);
+
+/*
+ * parses an environment text file, holding the coverage and effectiveness of IRS, ITN, larvacide and ovitraps and the bloodmeal success per line
+ * @param env will hold the allocated environments
+ * @param numSteps the number of time steps to read, or 0 to read the whole file
+ * @param carryingCapacity the carrying capacity of all time steps, the text format does not hold it
+ * @return the number of time steps read, which is less than numSteps if the file is short, or -1 if the file cannot be opened
+ */
+long long readEnvironmentText(const char* path, struct Environment** env, UINT numSteps, REAL carryingCapacity);
@@ -7,57 +7,113 @@
 #include "device_types.h"
 #include "agent.h"
 
-// taken from GPU Gems3
+// counter based random number generator Philox4x32-10, taken from Salmon et al.: Parallel Random Numbers: As Easy as 1, 2, 3 (SC 2011)
+// Every call is a pure function of the key (run seed) and the counter (agent slot, time step, seed index and replicate, draw block), therefore no
+// generator state has to be stored or copied between host and device. The agent slot is passed explicitly, such that a work-item can process several
+// agents
 
-// S1, S2, S3, and M are all constants, and z is part of the
-// private per-thread generator state.
-unsigned TausStep(unsigned z, int S1, int S2, int S3, unsigned M)
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u // golden ratio
+#define PHILOX_W1 0xBB67AE85u // sqrt(3) - 1
+
+// 2^-24, converts the upper 24 bits of a random integer to a REAL
+#define PHILOX_TO_REAL 5.9604644775390625e-8f
+
+/*
+ * applies the ten Philox rounds to ctr
+ * @param ctr the counter, will hold four random integers
+ * @param key0 lower half of the key
+ * @param key1 upper half of the key
+ */
+void Philox4x32(UINT* ctr, UINT key0, UINT key1)
 {
-	unsigned b=(((z << S1) ^ z) >> S2);
-	return (((z & M) << S3) ^ b);
+	for(UINT round = 0; round < 10; ++round) {
+		UINT hi0 = mul_hi(PHILOX_M0, ctr[0]), lo0 = PHILOX_M0 * ctr[0];
+		UINT hi1 = mul_hi(PHILOX_M1, ctr[2]), lo1 = PHILOX_M1 * ctr[2];
+
+		ctr[0] = hi1 ^ ctr[1] ^ key0;
+		ctr[1] = lo1;
+		ctr[2] = hi0 ^ ctr[3] ^ key1;
+		ctr[3] = lo0;
+
+		key0 += PHILOX_W0;
+		key1 += PHILOX_W1;
+	}
 }
 
-// A and C are constants
-unsigned LCGStep(unsigned z, unsigned A, unsigned C)
+/*
+ * generates four uniform random numbers in (0, 1] for an agent of the calling work-item's replicate
+ * @param seeds the seed to be used, z1 and z2 hold the run seed, z3 the time step and z4 the index of the seed
+ * @param gid the slot of the agent
+ * @param block index of the block of four numbers, several blocks can be drawn from the same seed in the same time step
+ * @param u will hold the four random numbers
+ */
+void PhiloxUniforms(__constant struct Seeds* seeds, UINT gid, UINT block, REAL* u)
 {
-	return (A*z+C);
+	UINT ctr[4];
+	ctr[0] = gid;
+	ctr[1] = seeds->z3;
+	// the replicate in the upper half gives every replicate its own stream
+	ctr[2] = seeds->z4 | ((UINT)get_global_id(1) << 16);
+	ctr[3] = block;
+	Philox4x32(ctr, seeds->z1, seeds->z2);
+
+	// excluding zero, such that the result can be passed to log
+	for(UINT i = 0; i < 4; ++i)
+		u[i] = ((ctr[i] >> 8) + 1u) * PHILOX_TO_REAL;
 }
 
 /*
  * uniform random number generator
- * @param z1 random integer
- * @param z2 random integer
- * @param z3 random integer
- * @param z4 random integer
+ * @param seeds the seed to be used
+ * @param gid the slot of the agent
+ * @param draw index of the number, different draws from the same seed are independent
+ * @return a uniform random number in (0, 1]
+ */
+REAL randUniformN(__constant struct Seeds* seeds, UINT gid, UINT draw)
+{
+	REAL u[4];
+	PhiloxUniforms(seeds, gid, draw / 4, u);
+	return u[draw % 4];
+}
+
+/*
+ * uniform random number generator, returns the first draw of the seed
+ * @param seeds the seed to be used
+ * @param gid the slot of the agent
+ */
+REAL randUniform(__constant struct Seeds* seeds, UINT gid)
+{
+	return randUniformN(seeds, gid, 0);
+}
+
+#ifdef __OPENCL_VERSION__
+/*
+ * vectorized uniform random number generator
+ * @param seeds the seed to be used
+ * @param gid the slot of the agent
+ * @param block index of the block, returns draws 4*block to 4*block+3 of randUniformN
+ * @return four uniform random numbers in (0, 1]
  */
-REAL HybridTaus(__constant struct Seeds* seeds)
+float4 randUniform4(__constant struct Seeds* seeds, UINT gid, UINT block)
 {
-	UINT gid = get_global_id(0);
-	// Tausworthe state components should be greater than 128
-	UINT z1 = seeds->z1 + 128u;
-	UINT z2 = seeds->z2 + 128u + gid;
-	UINT z3 = seeds->z3 + 128u;
-	// multiplying by gid in order to have different seed for each thread
-	UINT z4 = seeds->z4 * gid;
-
-	// Combined period is lcm(p1,p2,p3,p4)~ 2^121
-	return 2.3283064365387e-10f * (              // Periods
-		TausStep(z1, 13, 19, 12, 4294967294UL) ^  // p1=2^31-1
-		TausStep(z2, 2, 25, 4, 4294967288UL) ^    // p2=2^30-1
-		TausStep(z3, 3, 11, 17, 4294967280UL) ^   // p3=2^28-1
-		LCGStep(z4, 1664525, 1013904223UL)       // p4=2^32
-	);
+	uint4 ctr = (uint4)(gid, seeds->z3, seeds->z4 | ((UINT)get_global_id(1) << 16), block);
+	Philox4x32((UINT*)&ctr, seeds->z1, seeds->z2);
+	return convert_float4((ctr >> 8) + 1u) * PHILOX_TO_REAL;
 }
+#endif
 
 /*
  * BoxMuller algorithm to generate a normal distributed random number out of two uniform distributed random numbers
- * @param seeds an array with at least two seeds
+ * @param seeds the seed to be used, the first two draws of it are consumed
+ * @param gid the slot of the agent
  */
-REAL BoxMuller(__constant struct Seeds* seeds, REAL mean, REAL stdDev)
+REAL BoxMuller(__constant struct Seeds* seeds, UINT gid, REAL mean, REAL stdDev)
 {
-	UINT offset = get_global_size(0);
-	REAL u0=HybridTaus(&seeds[0]), u1=HybridTaus (&seeds[1]);
-	REAL r=sqrt(-2*log(u0));
-	REAL theta=2*M_PI_F*u1;
-	return (r*sin(theta)) * stdDev + mean;
+	REAL u[4];
+	PhiloxUniforms(seeds, gid, 0, u);
+	REAL r=MATH_SQRT(-2*MATH_LOG(u[0]));
+	REAL theta=2*M_PI_F*u[1];
+	return (r*MATH_SIN(theta)) * stdDev + mean;
 }
@@ -0,0 +1,50 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ */
+#pragma once
+
+#include "agent.h"
+
+/*
+ * Decomposition of the patches over several processes. Built with MPI (make MPI=1) every process is a rank which simulates its own part of the
+ * patches on its own device, without MPI a single rank simulates all of them. Adults migrating to a patch of another rank are collected in a halo
+ * population of that patch on the device. At the end of every time step they are packed into one contiguous buffer per rank and sent to the owner
+ * of the patch, which adds them to its population during the compaction of the next time step
+ */
+
+// header of the migrants of one state from one replicate to one patch in an exchanged buffer, followed by count agents, count ages and count states
+struct MigrantBlock {
+	UINT replicate;
+	UINT patch; // index in the patch file
+	UINT state; // 0 for EGG to 7 for GRAVID
+	UINT count;
+};
+
+extern UINT haloRank;
+extern UINT haloSize;
+
+void haloInit(int* argc, char*** argv);
+void haloFinalize();
+
+/*
+ * copies size bytes at data from rank 0 to all other ranks
+ */
+void haloBroadcast(void* data, UINT size);
+
+/*
+ * assigns each patch to a rank, handing out the patches from the largest to the smallest weight to the rank with the smallest total weight so far.
+ * All ranks calculate the same assignment
+ * @param weights the expected number of agents of each patch
+ * @param owner will hold the rank of each patch
+ */
+void partitionPatches(const REAL* weights, UINT numPatches, UINT numRanks, UINT* owner);
+
+/*
+ * exchanges a buffer with every rank, including the calling one
+ * @param sendBuffers the buffer sent to each rank
+ * @param sendSizes the size of the buffer sent to each rank in bytes
+ * @param recvSizes will hold the size of the buffer received from each rank
+ * @return the buffers received from all ranks one after another, to be freed by the caller
+ */
+char* haloExchange(char** sendBuffers, UINT* sendSizes, UINT* recvSizes);
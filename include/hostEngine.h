@@ -0,0 +1,41 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ */
+#pragma once
+
+#include "agent.h"
+
+/*
+ * callback used by the host engine to report the statistics of each time step
+ */
+typedef void (*HostStatsCallback)(struct Stats* stats, struct BitesNcycles* bnc, UINT step);
+
+/*
+ * runs the whole simulation on the host using a pool of threads, without any OpenCL runtime. It executes the same per step pipeline as the OpenCL
+ * kernels and produces the same population layout
+ * @param numThreads the number of threads to use, 0 to use one per online core
+ * @param capacity the initial number of agents, including the padding between the state ranges. It is doubled when the agents come close to it
+ * @param initialAgentCount the number of eggs in the initial population
+ * @param environment array with the environment of each time step
+ * @param temperature array with the temperature of each time step
+ * @param numSteps the number of time steps to simulate
+ * @param hoursInTimeStep the length of a time step in hours
+ * @param nSeeds the number of seeds of the random number generator
+ * @param runSeed the seed of the whole run, the same seed reproduces the same run
+ * @param report function called with the statistics of each time step, may be NULL
+ * @param pop will hold the population after the last time step
+ * @return the number of agent updates performed, i.e. the sum of all living agents over all time steps
+ */
+unsigned long long hostRun(UINT numThreads, UINT capacity, UINT initialAgentCount, struct Environment* environment, Temperature* temperature,
+		UINT numSteps, REAL hoursInTimeStep, UINT nSeeds, unsigned long long runSeed, HostStatsCallback report, struct Population* pop);
+
+/*
+ * @return the number of threads hostRun uses if numThreads is 0
+ */
+UINT hostDefaultThreads();
+
+/*
+ * @return the name of the instruction set of the loops hostRun runs over all agents, the widest one the CPU supports
+ */
+const char* hostInstructionSet();
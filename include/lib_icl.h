@@ -28,6 +28,11 @@ if(!(__condition)) { \
 	printf(__message, ##__VA_ARGS__); \
 }
 
+// prefix of the files in which compiled programs are cached by icl_create_kernel
+#ifndef ICL_BINARY_CACHE_PATH
+#define ICL_BINARY_CACHE_PATH ""
+#endif
+
 #define ICL_CPU	CL_DEVICE_TYPE_CPU
 #define ICL_GPU	CL_DEVICE_TYPE_GPU
 #define ICL_ACL	CL_DEVICE_TYPE_ACCELERATOR
@@ -80,6 +85,12 @@ typedef struct _icl_buffer {
 	icl_device* dev; // derive the device directly from the buffer
 } icl_buffer;
 
+/*
+ * ICL_SOURCE	build from file, using a cached binary if the source, the included headers, the build options, the device and the driver are unchanged
+ * ICL_BINARY	load the cached binary only, fails if there is no valid one
+ * ICL_STRING	build from the string passed as file name, never cached
+ * ICL_NO_CACHE	build from file, never cached
+ */
 typedef enum {ICL_SOURCE, ICL_BINARY, ICL_STRING, ICL_NO_CACHE} icl_create_kernel_flag;
 
 typedef struct _icl_kernel {
@@ -108,6 +119,7 @@ extern void icl_read_buffer_offset(const icl_buffer* buf, cl_bool blocking, size
 extern void icl_write_buffer(icl_buffer* buf, cl_bool blocking, size_t size, const void* source_ptr, icl_event* event_wait, icl_event* event);
 extern void icl_write_buffer_offset(icl_buffer* buf, cl_bool blocking, size_t offset, size_t size, const void* source_ptr, icl_event* wait_event, icl_event* event);
 extern void icl_copy_buffer(icl_buffer* src_buf, icl_buffer* dest_buf, size_t size, icl_event* event_wait, icl_event* event);
+extern void icl_copy_buffer_offset(icl_buffer* src_buf, icl_buffer* dest_buf, size_t src_offset, size_t dest_offset, size_t size, icl_event* event_wait, icl_event* event);
 /*
  * @author      Ivan Grasso
  * @date		05/01/2012
@@ -0,0 +1,58 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ */
+#pragma once
+
+#include "agent.h"
+
+/*
+ * Adults migrate between neighbouring patches of the same replicate while they are compacted. The connectivity is a sparse matrix of edges, each
+ * moving a fraction of the adults of its source patch to its target patch in every time step. The number of migrants of each edge and state is drawn
+ * once per time step, the migrants of a state are a window of consecutive agents starting at a random one. They are written to the range of their
+ * state in the target patch, after the agents which stay there
+ */
+
+// adults, from IMMATURE (state 3) to GRAVID (state 7), migrate
+#define FIRST_MIGRATING_STATE 3
+// index of the first random number drawn for the migration, after the draws of the agents
+#define MIGRATION_DRAW 256
+
+struct MigrationEdge {
+	UINT from; // source patch
+	UINT to; // target patch
+	REAL rate; // fraction of the adults of the source patch moving to the target patch in each time step
+};
+
+// UINTs per population in the migration state: number of emigrants of each state, first agent of the window of emigrants of each state, number of
+// agents staying in the patch of each state and position of the agents imported from other ranks in the range of each state
+#define MIGRATION_POP_STRIDE (4 * 8)
+// UINTs per population in the imports from other ranks: number of imported agents of each state and index of the first one in the inbox
+#define MIGRATION_IMPORT_STRIDE (2 * 8)
+// UINTs per edge of each replicate in the migration state: number of migrants of each state and their offset in the immigrants of the target patch
+#define MIGRATION_EDGE_STRIDE (2 * 8)
+
+#ifndef __OPENCL_VERSION__
+#include "lib_icl.h"
+
+/*
+ * device buffers of the migration between patches
+ */
+struct MigrationGraph {
+	icl_buffer* edges; // struct MigrationEdge, sorted by their source patch
+	icl_buffer* outStart; // index of the first edge of each patch in edges, plus the number of edges
+	icl_buffer* inEdges; // indices of the edges, sorted by their target patch
+	icl_buffer* inStart; // index of the first edge of each patch in inEdges, plus the number of edges
+	icl_buffer* popMigration; // MIGRATION_POP_STRIDE UINTs per population
+	icl_buffer* edgeMigration; // MIGRATION_EDGE_STRIDE UINTs per edge of each replicate
+	UINT numEdges;
+
+	// agents imported from other ranks, added to their populations by the next compaction
+	icl_buffer* imports; // MIGRATION_IMPORT_STRIDE UINTs per population
+	icl_buffer* inboxAgents;
+	icl_buffer* inboxAges;
+	icl_buffer* inboxStates;
+	UINT inboxCapacity;
+	UINT maxImports; // the largest number of agents imported by a single population, no imports if zero
+};
+#endif
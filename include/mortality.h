@@ -0,0 +1,92 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ */
+#pragma once
+
+#include "device_types.h"
+#include "agent.h"
+#include "gpuRand.h"
+
+/*
+ * calculates an entry of the mortality table, see MORTALITY_TABLE_SIZE. The daily mortality rate is converted to an hourly one
+ * @param entry the index of the entry in the table
+ * @param numLarvae1DayEquiv the larvae 1 day equivalent of the population
+ * @param carryingCapacity the environment's carrying capacity
+ * @return the hourly mortality rate
+ */
+REAL tabulateMortality(UINT entry, UINT numLarvae1DayEquiv, REAL carryingCapacity) {
+	REAL DMR;	// DMR = Daily Mortality Rate
+
+	if(entry < MORTALITY_LARVA) { // adults
+		UINT ageInDays = entry - MORTALITY_ADULT;
+		REAL a, B, s;
+		a = 0.1f;
+		B = 25.0f;
+		s = 0.1f;
+		DMR = (a * MATH_EXP(ageInDays/B)) / (1.0f + (a * B * s * (MATH_EXP(ageInDays/B) - 1.0f)) );
+	} else if(entry < MORTALITY_EGG) { // larvae
+		UINT ageInDays = entry - MORTALITY_LARVA;
+		REAL rainfallCoefficient = 1.0f;
+		REAL a = 0.1f;
+		DMR = a * MATH_EXP( (REAL)numLarvae1DayEquiv / (ageInDays * carryingCapacity * rainfallCoefficient) );
+		DMR = min(DMR, 0.8f);	// Clip if larger than 1.0
+	} else { // eggs and pupae
+		DMR = 0.1f;
+	}
+
+	REAL DSR = 1.0f - DMR;	// DSR = Daily Survival Rate
+	REAL HSR = MATH_POW(DSR, 1.0f/24.0f);	// HSR = Hourly Survival Rate
+	REAL HMR = 1.0f - HSR;	// HMR = Hourly Mortality Rate
+
+	return HMR;
+}
+
+/*
+ * decides if an agent dies in the current time step, looking up its hourly mortality rate in the table of its population
+ * @param pop the properties (number of agents in certain state) of the current population
+ * @param gid the index of the agent
+ * @param ageInHours the agent's age in hours
+ * @param mortality the mortality table of the agent's population, written by the mortalityTable kernel
+ * @param seeds Seeds to be used for the random number generator on the device, seeds[0] is used
+ * @return true if the agent has to be killed
+ */
+bool agentDies(__constant struct Population* pop, UINT gid, REAL ageInHours, __global const REAL* mortality, __constant struct Seeds* seeds) {
+	UINT ageInDays = (UINT)min(ageInHours / 24.0f, 99.0f);
+
+	REAL probability = randUniform(&seeds[0], gid);
+	UINT entry;
+
+	if(gid >= pop->immatures.start) { // adults
+		entry = MORTALITY_ADULT + ageInDays;
+	} else if(gid < pop->eggs.end) {
+		entry = MORTALITY_EGG;
+	} else if(gid < pop->larvae.end) {
+		entry = MORTALITY_LARVA + ageInDays;
+	} else { // pupae
+		entry = MORTALITY_PUPA;
+	}
+
+	return probability <= mortality[entry];
+}
+
+/*
+ * resets the newEggs counter and the BitesNcycles counters and calculates the total biomass for the update of the current time step
+ * @param pop the properties (number of agents in certain state) of the current population
+ * @param enb the eggs and biomass struct to reset
+ * @param bnc structure to store the informations about bites and cycles, will be nulled
+ */
+void resetCounters(__constant struct Population* pop, __global struct EggsNbiomass* enb, __global struct BitesNcycles* bnc) {
+	// reset newEgg counter for next iteration of update
+	enb->newEggs = 0;
+
+	// calculate the total biomass
+	UINT totalBiomass = pop->numLarvae1DayEquiv + (pop->eggs.end) + (pop->pupae.end - pop->pupae.start);
+	enb->totalBiomass = totalBiomass;
+
+	// null BitesNcycles
+	bnc->numBitesReported = 0;
+	bnc->numInfectBitesReported = 0;
+	bnc->numCyclesReported = 0;
+	bnc->sumCyclesReported = 0;
+}
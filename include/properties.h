@@ -82,12 +82,13 @@ bool eggsTransitionTime(UINT worldTime) {
  * Specifies the larva Delay. Larva will transform into a pupa once the development exceeds the delay.
  * This version uses a normal distributed random number
  * @param seeds Seeds for the OpenCL device random number generator
+ * @param gid the index of the agent
  * @return The larva delay depending on a normal distribution
  */
-REAL larvaDelay(__constant struct Seeds* seeds) {
+REAL larvaDelay(__constant struct Seeds* seeds, UINT gid) {
 	REAL mean = 1.0f;
 	REAL stdDev = 0.1f;
-	return BoxMuller(seeds, mean, stdDev); // resembles Simulation.randomNormalDouble(mean, stdDev)
+	return BoxMuller(seeds, gid, mean, stdDev); // resembles Simulation.randomNormalDouble(mean, stdDev)
 }
 
 // development rates to be used to calculate the larva development in each time step
@@ -254,12 +255,12 @@ bool bloodMealDigestingsTransitionTime(UINT worldTime) {
  * Calculates the number of eggs that an agent hold when evolving from blood meal digesting to gravid. New eggs are only generated if the agent does not already
  * contain eggs
  */
-UINT generateEggs(__constant struct Seeds* seeds, UINT* numEggBatches) {
+UINT generateEggs(__constant struct Seeds* seeds, UINT gid, UINT* numEggBatches) {
 	REAL eggBatchSize = 170.0f;
 	REAL stdDev = 30.0f;
-	UINT eggs = (UINT)(BoxMuller(seeds, eggBatchSize, stdDev) + 0.5f); //  (int)Math.round(Simulation.randomNormalDouble(170.0, 30.0));
+	UINT eggs = (UINT)(BoxMuller(seeds, gid, eggBatchSize, stdDev) + 0.5f); //  (int)Math.round(Simulation.randomNormalDouble(170.0, 30.0));
 	if (eggs < 0) eggs = 0;
-	eggs = (UINT)(eggs * pow(.8f, (REAL)*numEggBatches) + 0.5f);//(int)Math.round((eggs * pow(.8f, (REAL)batch)));
+	eggs = (UINT)(eggs * MATH_POW(.8f, (REAL)*numEggBatches) + 0.5f);//(int)Math.round((eggs * pow(.8f, (REAL)batch)));
 
 	++(*numEggBatches);
 	return eggs; // Normally distributed now.
@@ -301,7 +302,7 @@ INT layEggs(__private struct Agent* agent, __private struct AgentState* agentSta
 	UINT potentialEggs = (UINT)ceil((REAL)agent->availableEggs * potentialBiomass);
 
 	//add new eggs, single counter for the entire environment, hence an atomic operation must be used
-	UINT idx = atomic_add(&(enb->newEggs), potentialEggs);
+	atomic_add(&(enb->newEggs), potentialEggs);
 
 	return agent->availableEggs - potentialEggs;
 }
@@ -1,6 +1,7 @@
 
 #pragma once
 #include "abms.h"
+#include "migration.h"
 
 void segmented_scan_init(size_t _wx, UINT n, icl_device *dev, const char* build_options, icl_create_kernel_flag flag);
 void segmented_scan_release();
@@ -10,4 +11,36 @@ void scan(icl_buffer *data, icl_buffer *flag, UINT n);
 
 void recursive_scan(icl_buffer *d_data, icl_buffer *d_part, icl_buffer *d_flag, UINT n);
 
+/*
+ * multicore prefix scan for CPU devices. Writes the prefix sums in the layout oldToNewAgents expects: the area of each state reaches from the start of the
+ * range its agents can come from to the end of its own range. At each index of the area the prefix sum holds the number of living agents of the state
+ * up to this index minus one, at the end of the range the total minus one. The areas of eggs, immatures and blood meal digestings are stored in
+ * prefixSum1, the ones of larvae, mate seekings and gravids in prefixSum2 and the ones of pupae and blood meal seekings in prefixSum3, relative to the
+ * start of the larvae
+ * @param numReplicates the number of replicates scanned in parallel
+ * @param chunksPerComputeUnit the number of chunks scanned by each compute unit, more than one balances chunks with many dead agents
+ * @param spans the spans of the agents of each replicate, written by the agentSpans kernel
+ */
+void chunk_scan_init(UINT numReplicates, UINT chunksPerComputeUnit, icl_device* dev, const char* build_options, icl_create_kernel_flag flag);
+void chunk_scan(icl_buffer* agentStates, icl_buffer* pop, icl_buffer* spans, icl_buffer* prefixSum1, icl_buffer* prefixSum2, icl_buffer* prefixSum3);
+void chunk_scan_release();
+
+/*
+ * compaction for GPUs. Calculates the new position of the agents of all states with a single scan and copies them to the new arrays. Writes the
+ * next generation's population to position 1 of pop
+ * @param wx the work-group size, must be a power of two. It is reduced if the kernels cannot be launched with it on the device
+ * @param maxN the capacity of each replicate, must be the REPLICATE_CAPACITY the kernels are built with
+ * @param numReplicates the number of replicates compacted in parallel
+ * @param migration the migration graph of the device, NULL if the kernels are built without MIGRATION
+ * @param spans the spans of the agents of each replicate, written by the agentSpans kernel
+ * @param seeds the seeds of the current time step, used to draw the migrants
+ * @param numAgents the number of agents in the state ranges of the current arrays, the maximum of all replicates
+ * @param event event of the kernel copying the agents
+ */
+void compaction_init(size_t wx, UINT maxN, UINT numReplicates, struct MigrationGraph* migration, icl_device* dev, const char* build_options,
+		icl_create_kernel_flag flag);
+void compaction(icl_buffer* agents, icl_buffer* agentAges, icl_buffer* agentStates, icl_buffer* newAgents, icl_buffer* newAgentAges,
+		icl_buffer* newAgentStates, icl_buffer* pop, icl_buffer* spans, icl_buffer* enb, icl_buffer* seeds, UINT numAgents, icl_event* event);
+void compaction_release();
+
 
@@ -0,0 +1,21 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ */
+#pragma once
+
+#include "agent.h"
+
+/*
+ * derives the statistics of a time step from the population ranges and the numbers of larva one day equivalents, females and potentially infective
+ * agents stored in pop
+ * @param pop the properties (number of agents in certain state) of the current population
+ * @return the statistics of the population
+ */
+struct Stats populationStats(struct Population* pop);
+
+/*
+ * @param stats statistics of a population
+ * @return the number of living agents in all states
+ */
+UINT numAgents(struct Stats* stats);
@@ -0,0 +1,58 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ */
+#pragma once
+
+#include "agent.h"
+
+/*
+ * A statistics file starts with a StatsFileHeader and one StatsColumn per column. It is followed by blocks of rows, each holding the number of rows
+ * of the block and then the values of each column of these rows one after another. All values are four bytes wide
+ */
+#define STATS_COLUMN_UINT 0
+#define STATS_COLUMN_REAL 1
+
+struct StatsFileHeader {
+	char magic[8];
+	UINT numColumns;
+	UINT reserved;
+};
+
+struct StatsColumn {
+	char name[24];
+	UINT type; // STATS_COLUMN_UINT or STATS_COLUMN_REAL
+	UINT reserved;
+};
+
+/*
+ * statistics of one replicate at one time step
+ */
+struct StatsRow {
+	UINT step;
+	UINT replicate;
+	UINT patch;
+	UINT phase; // 0 for the burn-in or a run without scenarios, s + 1 for scenario s
+	REAL hours; // simulated time in hours at the start of the time step
+	Temperature temperature;
+	struct Stats stats;
+	struct BitesNcycles bnc;
+};
+
+struct StatsWriter;
+
+/*
+ * creates a statistics file and starts the thread writing it
+ * @return the writer, or NULL if the file cannot be created
+ */
+struct StatsWriter* openStatsWriter(const char* path);
+
+/*
+ * queues a row for the writer thread. Must always be called by the same thread, it only waits if the writer thread falls behind by a whole queue
+ */
+void pushStats(struct StatsWriter* writer, struct StatsRow* row);
+
+/*
+ * writes all queued rows, stops the writer thread and closes the file
+ */
+void closeStatsWriter(struct StatsWriter* writer);
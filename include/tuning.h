@@ -0,0 +1,48 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ */
+#pragma once
+
+#include "host_types.h"
+#include "lib_icl.h"
+
+/*
+ * work sizes of the kernels whose best value depends on the device. They are read from the profile of the device written by -autotune, the devices
+ * without profile use the defaults of their type
+ */
+struct WorkSizes {
+	UINT updateGroupSize; // work-group size of killAgents, updateAgents and killUpdateAgents
+	UINT coarsening; // number of consecutive agents processed by each work-item of these kernels
+	UINT compactionGroupSize; // work-group size of the compaction, used on GPUs and accelerators
+	UINT chunksPerComputeUnit; // number of chunks of the chunked scan per compute unit, used on CPUs
+	UINT rangeAlignment; // the state ranges start at multiples of it, see RANGE_ALIGNMENT
+};
+
+/*
+ * @return the work sizes used on devices of the type of dev without profile
+ */
+struct WorkSizes defaultWorkSizes(icl_device* dev);
+
+/*
+ * writes the name of the profile of dev to path. The profile belongs to the name and driver version of the device, an updated driver is tuned again
+ */
+void workSizesProfile(icl_device* dev, char* path, size_t size);
+
+/*
+ * reads the profile of dev into sizes. Work sizes missing in the profile keep their value
+ * @return 0 if the profile was read, -1 if the device has no profile
+ */
+int loadWorkSizes(icl_device* dev, struct WorkSizes* sizes);
+
+/*
+ * writes sizes to the profile of dev, replacing an existing one
+ * @return 0 on success, -1 if the profile cannot be written
+ */
+int storeWorkSizes(icl_device* dev, struct WorkSizes* sizes);
+
+/*
+ * @return size, halved until the kernel can be launched with work-groups of that size on its device, whose limit depends on the registers and
+ * local memory the kernel uses
+ */
+UINT fittingGroupSize(icl_kernel* kernel, UINT size);
@@ -8,10 +8,12 @@
  * @param agents Array holding all agents' age
  * @param pop the properties (number of agents in certain state) of the current population. The correct information is found at position 1 of this buffer since
  * 				it is calculated after the oldToNewAgents and before the calcL1de kernel
- * @param histogram buffer where the histogram will be stored
+ * @param histogram buffer where the histogram will be stored, all replicates are added to the same histogram
  */
 __kernel void ageHistogram(__global struct AgentAge* agents, __constant struct Population* pop, __global UINT* histogram) {
 	UINT gid = get_global_id(0);
+	agents += AGENT_OFFSET;
+	pop += 2 * REPLICATE;
 
 	UINT offset = pop[1].immatures.start;
 	UINT group = get_group_id(0);
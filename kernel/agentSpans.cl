@@ -0,0 +1,30 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ */
+
+#include "device_types.h"
+#include "agent.h"
+
+#define NUM_STATES 8
+
+/*
+ * writes the spans of the agents of each population for agentSlot, using a single thread per replicate. Has to run after the population of the time
+ * step is final and before the agents are killed
+ * @param pop the properties (number of agents in certain state) of the current population
+ * @param spans will hold the spans of each population
+ */
+__kernel void agentSpans(__constant struct Population* pop, __global struct AgentSpans* spans) {
+	pop += 2 * REPLICATE;
+	spans += REPLICATE;
+
+	UINT first = 0;
+	for(UINT s = 0; s < NUM_STATES; ++s) {
+		struct AgentRange range = (&pop->eggs)[s];
+		spans->start[s] = range.start;
+		spans->firstItem[s] = first;
+		first += range.end - range.start;
+	}
+	spans->firstItem[NUM_STATES] = first;
+	spans->end = pop->gravids.end;
+}
@@ -15,6 +15,9 @@
  * 							  in the range [#groups, 2*#groups] each group stores the partial sum of the potential infected females
  */
 __kernel void calcFemalesPerGroup(__global struct AgentAge* agents, __constant struct Population* pop, __global UINT* intermediateFemales) {
+	agents += AGENT_OFFSET;
+	pop += 2 * REPLICATE;
+	intermediateFemales += REPLICATE * PARTIAL_SUMS;
 	UINT gid = get_global_id(0);
 	UINT lid = get_local_id(0);
 	UINT offset = pop->immatures.start;
@@ -64,7 +67,9 @@ __kernel void calcFemalesPerGroup(__global struct AgentAge* agents, __constant s
  * @param intermediateFemales Array holding the partial sums as generated by calcFemalesPerGroup.
  */
 __kernel void calcFemalesTotal(__global struct Population* pop, __global UINT* intermediateFemales) {
-	// kernel is inteded to be executed by only one group in order to get the final result
+	// kernel is inteded to be executed by only one group per replicate in order to get the final result
+	pop += 2 * REPLICATE;
+	intermediateFemales += REPLICATE * PARTIAL_SUMS;
 	UINT id = get_local_id(0);
 
 	__local UINT females[LOCAL_SIZE];
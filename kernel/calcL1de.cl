@@ -15,6 +15,9 @@
  * @param intermediateL1de Array will be filled with partial sum of days for each group.
  */
 __kernel void calcL1dePerGroup(__global struct AgentAge* agents, __constant struct Population* pop, __global UINT* intermediateL1de) {
+	agents += AGENT_OFFSET;
+	pop += 2 * REPLICATE;
+	intermediateL1de += REPLICATE * PARTIAL_SUMS;
 	UINT gid = get_global_id(0);
 	UINT lid = get_local_id(0);
 	UINT offset = pop[1].larvae.start;
@@ -51,7 +54,9 @@ __kernel void calcL1dePerGroup(__global struct AgentAge* agents, __constant stru
  * @param numberOfSlots The number of partial sums that are provided by calcL1dePerGroup
  */
 __kernel void calcL1deTotal(__global struct Population* gPop, __global UINT* intermediateL1de, UINT numberOfSlots) {
-	// kernel is inteded to be executed by only one group in order to get the final result
+	// kernel is inteded to be executed by only one group per replicate in order to get the final result
+	gPop += 2 * REPLICATE;
+	intermediateL1de += REPLICATE * PARTIAL_SUMS;
 	UINT id = get_local_id(0);
 	UINT larvae1DequivPrivate = 0;
 	bool anyLarvae = (gPop[1].larvae.end - gPop[1].larvae.start) != 0;
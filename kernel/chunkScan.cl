@@ -0,0 +1,168 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ */
+
+#include "device_types.h"
+#include "agent.h"
+
+#define NUM_STATES 8
+
+/*
+ * prefix sum area of a state as expected by oldToNewAgents. The areas of state s are stored in prefix sum s%3, the ones in prefixSum3 are relative to
+ * pop->larvae.start
+ * @param pop the properties (number of agents in certain state) of the current population
+ * @param s index of the state (0 for EGG to 7 for GRAVID)
+ * @param start will hold the first index of the area in agentStates
+ * @param end will hold the last index of the area in agentStates, it is written to prefixSum as well
+ */
+void scanArea(__constant struct Population* pop, UINT s, UINT* start, UINT* end) {
+	switch(s) {
+	case 0: *start = 0; *end = pop->eggs.end; break;
+	case 1: *start = pop->eggs.start; *end = pop->larvae.end; break;
+	case 2: *start = pop->larvae.start; *end = pop->pupae.end; break;
+	case 3: *start = pop->pupae.start; *end = pop->immatures.end; break;
+	case 4: *start = pop->immatures.start; *end = pop->mateSeekings.end; break;
+	case 5: *start = pop->mateSeekings.start; *end = pop->gravids.end; break;
+	case 6: *start = pop->bmSeekings.start; *end = pop->bmDigestings.end; break;
+	default: *start = pop->bmDigestings.start; *end = pop->gravids.end; break;
+	}
+}
+
+/*
+ * slots of the calling thread's chunk. The agents of all ranges, numbered with agentSlot, are split evenly into the chunks. The first chunk begins at
+ * slot 0 and the last one ends behind gravids.end, such that the chunks cover the ends of all scan areas
+ * @param spans the spans of the agents of the population
+ * @param begin will hold the first slot of the chunk
+ * @param end will hold the slot behind the chunk
+ */
+void chunkSlots(__constant struct AgentSpans* spans, UINT* begin, UINT* end) {
+	UINT chunk = get_global_id(0);
+	UINT numChunks = get_global_size(0);
+	UINT chunkSize = (spans->firstItem[8] + numChunks - 1) / numChunks;
+	*begin = (chunk == 0) ? 0 : agentSlot(spans, chunk * chunkSize);
+	*end = (chunk == numChunks - 1) ? spans->end + 1 : agentSlot(spans, (chunk + 1) * chunkSize);
+}
+
+/*
+ * @return the range of state s (0 for EGG to 7 for GRAVID)
+ */
+struct AgentRange stateRange(__constant struct Population* pop, UINT s) {
+	switch(s) {
+	case 0: return pop->eggs;
+	case 1: return pop->larvae;
+	case 2: return pop->pupae;
+	case 3: return pop->immatures;
+	case 4: return pop->mateSeekings;
+	case 5: return pop->bmSeekings;
+	case 6: return pop->bmDigestings;
+	default: return pop->gravids;
+	}
+}
+
+/*
+ * 1st pass of the chunked prefix scan. Each thread counts the living agents of each state inside its scan area in one chunk of agentStates. Only the
+ * ranges are walked, the gaps between them are skipped
+ * @param agentStates The array holding all agents' state information
+ * @param pop the properties (number of agents in certain state) of the current population
+ * @param spans the spans of the agents of each population, written by agentSpans
+ * @param counts will hold NUM_STATES counters for each chunk
+ */
+__kernel void chunkCount(__global struct AgentState* agentStates, __constant struct Population* pop, __constant struct AgentSpans* spans,
+		__global UINT* counts) {
+	UINT gid = get_global_id(0);
+	agentStates += AGENT_OFFSET;
+	pop += 2 * REPLICATE;
+	counts += REPLICATE * get_global_size(0) * NUM_STATES;
+	UINT begin, end;
+	chunkSlots(spans + REPLICATE, &begin, &end);
+
+	UINT count[NUM_STATES];
+	UINT areaStart[NUM_STATES];
+	UINT areaEnd[NUM_STATES];
+	for(UINT s = 0; s < NUM_STATES; ++s) {
+		count[s] = 0;
+		scanArea(pop, s, &areaStart[s], &areaEnd[s]);
+	}
+
+	for(UINT r = 0; r < NUM_STATES; ++r) {
+		struct AgentRange range = stateRange(pop, r);
+		UINT last = min(end, range.end);
+		for(UINT idx = max(begin, range.start); idx < last; ++idx) {
+			struct AgentState agentState = agentStates[idx];
+			if(agentState.dead) continue;
+
+			UINT s = 31 - clz((UINT)agentState.state);
+			if(idx >= areaStart[s] && idx <= areaEnd[s])
+				++count[s];
+		}
+	}
+
+	for(UINT s = 0; s < NUM_STATES; ++s)
+		counts[gid * NUM_STATES + s] = count[s];
+}
+
+/*
+ * 2nd pass of the chunked prefix scan, using a single thread per replicate. Replaces the counters of each state by the number of agents of this state in all previous
+ * chunks
+ * @param counts NUM_STATES counters for each chunk
+ * @param numChunks the number of chunks
+ */
+__kernel void chunkOffsets(__global UINT* counts, UINT numChunks) {
+	counts += REPLICATE * numChunks * NUM_STATES;
+	for(UINT s = 0; s < NUM_STATES; ++s) {
+		UINT sum = 0;
+		for(UINT c = 0; c < numChunks; ++c) {
+			UINT count = counts[c * NUM_STATES + s];
+			counts[c * NUM_STATES + s] = sum;
+			sum += count;
+		}
+	}
+}
+
+/*
+ * 3rd pass of the chunked prefix scan. Each thread rescans the ranges in its chunk, starting at the offsets of the 2nd pass, and writes the prefix sums
+ * described in scan.h. Besides the slots of the ranges only the end of each scan area is written, oldToNewAgents reads the totals there
+ * @param agentStates The array holding all agents' state information
+ * @param pop the properties (number of agents in certain state) of the current population
+ * @param spans the spans of the agents of each population, written by agentSpans
+ * @param prefixSum1 will hold the prefix sum for all eggs, immatures and blood meal digestings
+ * @param prefixSum2 will hold the prefix sum for all larvae, mate seekings and gravids
+ * @param prefixSum3 will hold the prefix sum for all pupae and blood meal seekings
+ * @param counts the offsets calculated by chunkOffsets
+ */
+__kernel void chunkScan(__global struct AgentState* agentStates, __constant struct Population* pop, __constant struct AgentSpans* spans,
+		__global INT* prefixSum1, __global INT* prefixSum2, __global INT* prefixSum3, __global UINT* counts) {
+	UINT gid = get_global_id(0);
+	agentStates += AGENT_OFFSET;
+	pop += 2 * REPLICATE;
+	prefixSum1 += AGENT_OFFSET;
+	prefixSum2 += AGENT_OFFSET;
+	prefixSum3 += AGENT_OFFSET;
+	counts += REPLICATE * get_global_size(0) * NUM_STATES;
+	UINT begin, end;
+	chunkSlots(spans + REPLICATE, &begin, &end);
+
+	for(UINT s = 0; s < NUM_STATES; ++s) {
+		UINT areaStart, areaEnd;
+		scanArea(pop, s, &areaStart, &areaEnd);
+
+		__global INT* prefixSum = (s % 3 == 0) ? prefixSum1 : (s % 3 == 1) ? prefixSum2 : prefixSum3;
+		UINT offset = (s % 3 == 2) ? pop->larvae.start : 0;
+		enum State match = (enum State)(1 << s);
+
+		INT curr = (INT)counts[gid * NUM_STATES + s] - 1;
+		for(UINT r = 0; r < NUM_STATES; ++r) {
+			struct AgentRange range = stateRange(pop, r);
+			UINT last = min(min(end, range.end), areaEnd + 1);
+			for(UINT idx = max(max(begin, range.start), areaStart); idx < last; ++idx) {
+				if(!agentStates[idx].dead && (agentStates[idx].state == match)) ++curr;
+
+				prefixSum[idx - offset] = curr;
+			}
+		}
+
+		if(areaEnd >= begin && areaEnd < end)
+			prefixSum[areaEnd - offset] = curr;
+	}
+}
@@ -0,0 +1,277 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ */
+
+#include "device_types.h"
+#include "agent.h"
+#include "migration.h"
+
+#define NUM_STATES 8
+
+/*
+ * The counters of all eight states are packed into a single ulong2, with 16 bits per state: states 0 to 3 in x, states 4 to 7 in y. In this way the
+ * counts and the prefix sums of all states are calculated in a single local reduction or scan. The work-group size must be a power of two and must not
+ * exceed 65535
+ */
+
+/*
+ * @param gid the slot of the agent as returned by agentSlot, pop->gravids.end for work-items without agent
+ * @return a packed counter which is one for the state of the agent at gid, or zero if gid is not a living agent
+ */
+ulong2 stateFlag(__global struct AgentState* agentStates, struct Population* pop, UINT gid) {
+	ulong2 flag = (ulong2)(0, 0);
+	if(gid >= pop->gravids.end) return flag;
+
+	struct AgentState agentState = agentStates[gid];
+	if(agentState.dead) return flag;
+
+	UINT s = 31 - clz((UINT)agentState.state);
+	if(s < 4)
+		flag.x = 1ul << (16 * s);
+	else
+		flag.y = 1ul << (16 * (s - 4));
+
+	return flag;
+}
+
+/*
+ * @return the counter of state s in the packed counters
+ */
+UINT stateCount(ulong2 counters, UINT s) {
+	return (UINT)(((s < 4 ? counters.x : counters.y) >> (16 * (s % 4))) & 0xFFFF);
+}
+
+/*
+ * @return the offset of the calling work-item's replicate in the group counters, which hold NUM_STATES counters for each work-group that fits into
+ * REPLICATE_CAPACITY
+ */
+UINT groupCountsOffset() {
+	return REPLICATE * ((REPLICATE_CAPACITY + get_local_size(0) - 1) / get_local_size(0)) * NUM_STATES;
+}
+
+struct AgentRange getRange(__global struct Population* pop, UINT s) {
+	switch(s) {
+	case 0: return pop->eggs;
+	case 1: return pop->larvae;
+	case 2: return pop->pupae;
+	case 3: return pop->immatures;
+	case 4: return pop->mateSeekings;
+	case 5: return pop->bmSeekings;
+	case 6: return pop->bmDigestings;
+	default: return pop->gravids;
+	}
+}
+
+/*
+ * 1st step of the compaction. Each work-group counts the living agents of each state in its part of agentStates. The work-items are mapped to the
+ * agents with agentSlot, the parts of the work-groups skip the gaps between the state ranges
+ * @param agentStates The array holding all agents' state information
+ * @param pop the properties (number of agents in certain state) of the current population
+ * @param spans the spans of the agents of each population, written by agentSpans
+ * @param groupCounts will hold NUM_STATES counters for each work-group
+ * @param sums local memory of one ulong2 per work-item
+ */
+__kernel void compactCount(__global struct AgentState* agentStates, __constant struct Population* pop, __constant struct AgentSpans* spans,
+		__global UINT* groupCounts, __local ulong2* sums) {
+	UINT gid = get_global_id(0);
+	UINT lid = get_local_id(0);
+	agentStates += AGENT_OFFSET;
+	groupCounts += groupCountsOffset();
+	struct Population privatePop = pop[2 * REPLICATE];
+
+	sums[lid] = stateFlag(agentStates, &privatePop, agentSlot(spans + REPLICATE, gid));
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for(UINT stride = get_local_size(0) / 2; stride > 0; stride >>= 1) {
+		if(lid < stride)
+			sums[lid] += sums[lid + stride];
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	for(UINT s = lid; s < NUM_STATES; s += get_local_size(0))
+		groupCounts[get_group_id(0) * NUM_STATES + s] = stateCount(sums[0], s);
+}
+
+/*
+ * 2nd step of the compaction, using a single work-group per replicate. Replaces the counters of each work-group by the number of agents of the same state in all
+ * previous work-groups and writes the properties of the next generation's population to position 1 in population
+ * @param groupCounts NUM_STATES counters for each work-group of compactCount
+ * @param numGroups the number of work-groups of compactCount
+ * @param population the properties (number of agents in certain state) of the current population at positon 0. The properties of the next iteraiont's
+ * 			population will be written to position 1.
+ * @param enb eggs and biomass struct to get the number of newly generated eggs
+ * @param sums local memory of NUM_STATES UINTs per work-item plus NUM_STATES UINTs for the totals
+ */
+__kernel void compactOffsets(__global UINT* groupCounts, UINT numGroups, __global struct Population* population, __constant struct EggsNbiomass* enb,
+		__local UINT* sums) {
+	UINT lid = get_local_id(0);
+	UINT lsize = get_local_size(0);
+	groupCounts += groupCountsOffset();
+	population += 2 * REPLICATE;
+	enb += REPLICATE;
+	UINT groupsPerItem = (numGroups + lsize - 1) / lsize;
+	UINT begin = min(lid * groupsPerItem, numGroups);
+	UINT end = min(begin + groupsPerItem, numGroups);
+
+	// sum of the groups of each work-item
+	UINT sum[NUM_STATES];
+	for(UINT s = 0; s < NUM_STATES; ++s)
+		sum[s] = 0;
+	for(UINT g = begin; g < end; ++g)
+		for(UINT s = 0; s < NUM_STATES; ++s)
+			sum[s] += groupCounts[g * NUM_STATES + s];
+
+	for(UINT s = 0; s < NUM_STATES; ++s)
+		sums[s * lsize + lid] = sum[s];
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	// exclusive scan over the work-items, one work-item per state
+	__local UINT* totals = sums + NUM_STATES * lsize;
+	for(UINT s = lid; s < NUM_STATES; s += lsize) {
+		UINT total = 0;
+		for(UINT i = 0; i < lsize; ++i) {
+			UINT count = sums[s * lsize + i];
+			sums[s * lsize + i] = total;
+			total += count;
+		}
+		totals[s] = total;
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	// offsets for each group
+	for(UINT s = 0; s < NUM_STATES; ++s) {
+		UINT offset = sums[s * lsize + lid];
+		for(UINT g = begin; g < end; ++g) {
+			UINT count = groupCounts[g * NUM_STATES + s];
+			groupCounts[g * NUM_STATES + s] = offset;
+			offset += count;
+		}
+	}
+
+	if(lid == 0) { // write new properties array
+		__global struct Population* offset = &population[1];
+
+		offset->eggs.start = 0;
+		offset->eggs.end = totals[0] + enb->newEggs;
+		// assure a space between states of at least one
+		offset->larvae.start = ALIGN_RANGE(offset->eggs.end);
+		offset->larvae.end = offset->larvae.start + totals[1];
+		offset->pupae.start = ALIGN_RANGE(offset->larvae.end);
+		offset->pupae.end = offset->pupae.start + totals[2];
+		offset->immatures.start = ALIGN_RANGE(offset->pupae.end);
+		offset->immatures.end = offset->immatures.start + totals[3];
+		offset->mateSeekings.start = ALIGN_RANGE(offset->immatures.end);
+		offset->mateSeekings.end = offset->mateSeekings.start + totals[4];
+		offset->bmSeekings.start = ALIGN_RANGE(offset->mateSeekings.end);
+		offset->bmSeekings.end = offset->bmSeekings.start + totals[5];
+		offset->bmDigestings.start = ALIGN_RANGE(offset->bmSeekings.end);
+		offset->bmDigestings.end = offset->bmDigestings.start + totals[6];
+		offset->gravids.start = ALIGN_RANGE(offset->bmDigestings.end);
+		offset->gravids.end = offset->gravids.start + totals[7];
+	}
+}
+
+/*
+ * @return the new position of an adult of state s in the agent arrays of all populations, moving it to another patch if it is in the window of emigrants
+ * drawn by migrationDraw
+ * @param population the properties of all populations, the next iteration's including the migrants
+ * @param rank the number of living agents of the same state before the agent
+ * @param edges the edges of all patches, sorted by their source patch
+ * @param outStart index of the first edge of each patch in edges
+ * @param popMigration migration state of all populations
+ * @param edgeMigration migration state of all edges of all replicates
+ * @param numEdges the number of edges
+ */
+UINT migrationIndex(__global struct Population* population, UINT s, UINT rank, __global const struct MigrationEdge* edges, __global const UINT* outStart,
+		__global const UINT* popMigration, __global const UINT* edgeMigration, UINT numEdges) {
+	__global const UINT* popMig = popMigration + REPLICATE * MIGRATION_POP_STRIDE;
+	UINT emigrants = popMig[s];
+	UINT stay = popMig[2 * NUM_STATES + s];
+	UINT start = getRange(&population[2 * REPLICATE + 1], s).start;
+	if(emigrants == 0)
+		return AGENT_OFFSET + start + rank;
+
+	// rotate the ranks, such that the window of emigrants comes first
+	UINT count = emigrants + stay;
+	UINT r = (rank + count - popMig[NUM_STATES + s]) % count;
+	if(r >= emigrants)
+		return AGENT_OFFSET + start + r - emigrants;
+
+	UINT firstPopulation = REPLICATE - PATCH;
+	edgeMigration += (REPLICATE / NUM_PATCHES) * numEdges * MIGRATION_EDGE_STRIDE;
+	UINT e = outStart[PATCH];
+	for(; r >= edgeMigration[e * MIGRATION_EDGE_STRIDE + s]; ++e)
+		r -= edgeMigration[e * MIGRATION_EDGE_STRIDE + s];
+
+	// immigrants are placed after the agents staying in the target patch
+	UINT target = firstPopulation + edges[e].to;
+	return target * REPLICATE_CAPACITY + getRange(&population[2 * target + 1], s).start + popMigration[target * MIGRATION_POP_STRIDE + 2 * NUM_STATES + s] +
+			edgeMigration[e * MIGRATION_EDGE_STRIDE + NUM_STATES + s] + r;
+}
+
+/*
+ * 3rd step of the compaction. Copies the living agents to their new position, which is the start of the new range of their state plus the offset of the
+ * work-group plus the number of agents with the same state before them in the work-group. Has to be run with the same work-group size as compactCount
+ * @param oldAgents array holding all agents of the current iteration
+ * @param oldAgendAges array holding all agents' age information of the current iteration
+ * @param oldAgendStates array holding all agents' state information of the current iteration
+ * @param newAgents array that holds the eggs generated in the current iteration and to which the still living agents of the current iteration will be added
+ * @param newAgentAges array that holds the age of the eggs generated in the current iteration and to which the age information of the still living
+ * 			agents of the current iteration will be added
+ * @param newAgentStates array that holds the state of the eggs generated in the current iteration and to which the state information of the still living
+ * 			agents of the current iteration will be added
+ * @param groupOffsets the offsets calculated by compactOffsets
+ * @param population the properties of the current population at positon 0 and of the next iteration's population at position 1
+ * @param spans the spans of the agents of each population, written by agentSpans
+ * @param enb eggs and biomass struct to get the number of newly generated eggs
+ * @param scan local memory of one ulong2 per work-item
+ * @param edges, outStart, popMigration, edgeMigration, numEdges the migration graph and state, only used if built with MIGRATION. Adults are then
+ * 			copied to the population of their target patch, see migrationIndex
+ */
+__kernel void compactAgents(__global struct Agent* oldAgents, __global struct AgentAge* oldAgentAges, __global struct AgentState* oldAgentStates,
+		__global struct Agent* newAgents, __global struct AgentAge* newAgentAges, __global struct AgentState* newAgentStates,
+		__global UINT* groupOffsets, __global struct Population* population, __constant struct AgentSpans* spans, __constant struct EggsNbiomass* enb,
+		__local ulong2* scan, __global const struct MigrationEdge* edges, __global const UINT* outStart, __global const UINT* popMigration,
+		__global const UINT* edgeMigration, UINT numEdges) {
+	UINT gid = get_global_id(0);
+	UINT lid = get_local_id(0);
+	oldAgents += AGENT_OFFSET;
+	oldAgentAges += AGENT_OFFSET;
+	oldAgentStates += AGENT_OFFSET;
+	groupOffsets += groupCountsOffset();
+	enb += REPLICATE;
+
+	// the new arrays are indexed across all populations, migrants are copied to the population of their target patch
+	struct Population pop = population[2 * REPLICATE];
+	UINT slot = agentSlot(spans + REPLICATE, gid);
+	ulong2 flag = stateFlag(oldAgentStates, &pop, slot);
+
+	// inclusive scan of the packed counters in the work-group
+	scan[lid] = flag;
+	barrier(CLK_LOCAL_MEM_FENCE);
+	for(UINT stride = 1; stride < get_local_size(0); stride <<= 1) {
+		ulong2 prev = lid >= stride ? scan[lid - stride] : (ulong2)(0, 0);
+		barrier(CLK_LOCAL_MEM_FENCE);
+		scan[lid] += prev;
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	if(flag.x == 0 && flag.y == 0) return;
+
+	struct AgentState agentState = oldAgentStates[slot];
+	UINT s = 31 - clz((UINT)agentState.state);
+
+	UINT rank = groupOffsets[get_group_id(0) * NUM_STATES + s] + stateCount(scan[lid] - flag, s);
+#ifdef MIGRATION
+	UINT newIdx = s >= FIRST_MIGRATING_STATE ? migrationIndex(population, s, rank, edges, outStart, popMigration, edgeMigration, numEdges) :
+			AGENT_OFFSET + getRange(&population[2 * REPLICATE + 1], s).start + (s == 0 ? enb->newEggs : 0) + rank;
+#else
+	// start copying in old eggs after the newly generated ones
+	UINT newIdx = AGENT_OFFSET + getRange(&population[2 * REPLICATE + 1], s).start + (s == 0 ? enb->newEggs : 0) + rank;
+#endif
+
+	newAgents[newIdx] = oldAgents[slot];
+	newAgentAges[newIdx] = oldAgentAges[slot];
+	newAgentStates[newIdx] = agentState;
+}
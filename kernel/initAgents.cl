@@ -20,12 +20,17 @@
  * @param agentAges the agentAges array where the new agents' age information will be written to
  * @param agentStates the agentStates array where the new agents' state information will be written to
  * @param enb EggsNbiomass structure containing also the number of agent eggs that will be put in agents in this step
- * @param temperature the temperature in this timestep as a floating point number
+ * @param temperatures the temperatures of the forcing table on the device
+ * @param row the row of the current time step in the forcing table of each patch
  * @param seeds seeds for the random number generator
  */
 __kernel void initAgents(__global struct Agent* agents, __global struct AgentAge* agentAges, __global struct AgentState* agentStates,
-		__constant struct EggsNbiomass* enb, Temperature temperature, __constant struct Seeds* seeds) {
-	UINT initialAgentCount = enb->newEggs;
+		__constant struct EggsNbiomass* enb, __global const Temperature* temperatures, UINT row, __constant struct Seeds* seeds) {
+	Temperature temperature = temperatures[FORCING_ROW(row)];
+	agents += AGENT_OFFSET;
+	agentAges += AGENT_OFFSET;
+	agentStates += AGENT_OFFSET;
+	UINT initialAgentCount = enb[REPLICATE].newEggs;
 	UINT id = get_global_id(0);
 
 	if(id >= initialAgentCount)
@@ -41,7 +46,7 @@ __kernel void initAgents(__global struct Agent* agents, __global struct AgentAge
 	agentAge.ageInHours = 0.0f;
 	agentAge.hoursInState = 0.0f;
 
-	agentAge.isFemale = HybridTaus(&seeds[3]) <= 0.5; //TODO random;
+	agentAge.isFemale = randUniformN(&seeds[3], id, 1) <= 0.5; //TODO random;
 	agentAge.cumulativeSporogonicDevelopment = 0.0f;
 	agentAges[id] = agentAge;
 
@@ -52,7 +57,7 @@ __kernel void initAgents(__global struct Agent* agents, __global struct AgentAge
 	agent.cycleLength = 0u;
 	agent.cumulativeLarvalDelay = 0.0f; // set field needed in larva state already now
 
-	REAL probability = HybridTaus(&seeds[2]); //TODO random defines "bin"
+	REAL probability = randUniformN(&seeds[2], id, 1); //TODO random defines "bin"
 
 	agent.delay = eggsIncubation(temperature) + eggsHatching(probability); //set time for incubation + hatching
 
@@ -6,6 +6,9 @@
 #include "device_types.h"
 #include "agent.h"
 #include "gpuRand.h"
+#include "mortality.h"
+
+#define NUM_STATES 8
 
 UINT calcDiff(struct AgentRange range) {
 	return range.end - range.start;
@@ -16,45 +19,32 @@ UINT calcDiff(struct AgentRange range) {
  * @param agents the agents age array to read the age
  * @param agentStates array holding the sate information of all agents
  * @param pop the properties (number of agents in certain state) of the current population
+ * @param spans the spans of the agents of each population, written by agentSpans
  * @param enb this kernel resets the newEggs counter and calculates the total biomass
  * @param bnc structure to store the informations about bites and cycles. Will be nulled in this kernel
  * @param seeds Seeds to be used for the random number generator on the device
- * @param carryingCapacity the environment's carrying capacity
+ * @param mortality the mortality tables of all populations, written by the mortalityTable kernel
  */
 __kernel void killAgents(__global struct AgentAge* agents, __global struct AgentState* agentStates, __constant struct Population* pop,
-		__global struct EggsNbiomass* enb, __global struct BitesNcycles* bnc, __constant struct Seeds* seeds, REAL carryingCapacity) {
-	UINT gid = get_global_id(0);
-
-	bool valid = !((gid >= pop->eggs.end && gid < pop->larvae.start) ||
-				   (gid >= pop->larvae.end && gid < pop->pupae.start) ||
-				   (gid >= pop->pupae.end && gid < pop->immatures.start) ||
-				   (gid >= pop->immatures.end && gid < pop->mateSeekings.start) ||
-				   (gid >= pop->mateSeekings.end && gid < pop->bmSeekings.start) ||
-				   (gid >= pop->bmSeekings.end && gid < pop->bmDigestings.start) ||
-				   (gid >= pop->bmDigestings.end && gid < pop->gravids.start) ||
-				   (gid >= pop->gravids.end));
-
-	if(gid == 0) {
-		// reset newEgg counter for next iteration of update
-		enb->newEggs = 0;
-
-		// calculate the total biomass
-		UINT totalBiomass = pop->numLarvae1DayEquiv + (pop->eggs.end) + (pop->pupae.end - pop->pupae.start);
-		enb->totalBiomass = totalBiomass;
-
-		// null BitesNcycles
-		bnc->numBitesReported = 0;
-		bnc->numInfectBitesReported = 0;
-		bnc->numCyclesReported = 0;
-		bnc->sumCyclesReported = 0;
+		__constant struct AgentSpans* spans, __global struct EggsNbiomass* enb, __global struct BitesNcycles* bnc, __constant struct Seeds* seeds, __global const REAL* mortality) {
+	mortality += REPLICATE * MORTALITY_TABLE_SIZE;
+	agents += AGENT_OFFSET;
+	agentStates += AGENT_OFFSET;
+	pop += 2 * REPLICATE;
+	spans += REPLICATE;
+	enb += REPLICATE;
+	bnc += REPLICATE;
+
+	if(get_global_id(0) == 0) {
+		// reset newEgg and BitesNcycles counters and calculate the total biomass for the update
+		resetCounters(pop, enb, bnc);
 	}
 
-	if(!valid) return;
+	UINT gid = agentSlot(spans, get_global_id(0));
+	if(gid >= pop->gravids.end) return;
 
 	struct AgentAge agent = agents[gid];
-	UINT ageInDays = (UINT)min(agent.ageInHours / 24.0f, 99.0f);
 
-	REAL probability = HybridTaus(&seeds[0]); // TODO random
 /*
 if(gid >= pop->eggs.start && gid < pop->eggs.end)
 	if(agents[gid].state != EGG) printf("%d Not an egg %d [%d %d]\n", gid, agents[gid].state, pop->eggs.start, pop->eggs.end);
@@ -81,68 +71,39 @@ if(gid >= pop->gravids.start && gid < pop->gravids.end)
 	if(agents[gid].state != GRAVID) printf("%d Not gravid %d [%d %d]\n", gid, agents[gid].state, pop->gravids.start, pop->gravids.end);
 */
 
-	// killing adults
-	if(gid >= pop->immatures.start) {
-		REAL a, B, s;
-		a = 0.1f;
-		B = 25.0f;
-		s = 0.1f;
-		REAL DMR = (a * exp(ageInDays/B)) / (1.0f + (a * B * s * (exp(ageInDays/B) - 1.0f)) );
-		REAL DSR = 1.0f - DMR;	// DSR = Daily Survival Rate
-		REAL HSR = pow(DSR, 1.0f/24.0f);	// HSR = Hourly Survival Rate
-		REAL HMR = 1.0f - HSR;	// HMR = Hourly Mortality Rate
-
-		if (probability <= HMR) {	// Kill this agent
-			agentStates[gid].dead = true;
-		}
-
-		//agents[gid] = agent;
-		return;
+	if(agentDies(pop, gid, agent.ageInHours, mortality, seeds)) {	// Kill this agent
+		agentStates[gid].dead = true;
 	}
+}
 
-	if(gid < pop->eggs.end) {
-		REAL DMR = 0.1f;	// DMR = Daily Mortality Rate
-		REAL DSR = 1.0f - DMR;	// DSR = Daily Survival Rate
-		REAL HSR = pow(DSR, 1.0f/24.0f);	// HSR = Hourly Survival Rate
-		REAL HMR = 1.0f - HSR;	// HMR = Hourly Mortality Rate
-
-		if (probability <= HMR) {	// Kill this agent
-			agentStates[gid].dead = true;
-		}
-
-		//agents[gid] = agent;
-		return;
+/*
+ * same as killAgents, but each work-item processes a tile of COARSENING consecutive agents of the spans, numbered like agentSlot numbers the
+ * work-items. It walks the spans overlapping its tile, leaving the compiler of CPU devices a plain loop over the slots of each span to vectorize
+ * all parameters as in killAgents
+ */
+__kernel void killAgentsCoarse(__global struct AgentAge* agents, __global struct AgentState* agentStates, __constant struct Population* pop,
+		__constant struct AgentSpans* spans, __global struct EggsNbiomass* enb, __global struct BitesNcycles* bnc, __constant struct Seeds* seeds, __global const REAL* mortality) {
+	UINT item = get_global_id(0) * COARSENING;
+	mortality += REPLICATE * MORTALITY_TABLE_SIZE;
+	agents += AGENT_OFFSET;
+	agentStates += AGENT_OFFSET;
+	pop += 2 * REPLICATE;
+	spans += REPLICATE;
+	enb += REPLICATE;
+	bnc += REPLICATE;
+	UINT tileEnd = min(item + COARSENING, spans->firstItem[NUM_STATES]);
+
+	if(item == 0) {
+		// reset newEgg and BitesNcycles counters and calculate the total biomass for the update
+		resetCounters(pop, enb, bnc);
 	}
 
-	if(gid < pop->larvae.end) {
-		REAL rainfallCoefficient = 1.0f;
-		REAL a = 0.1f;
-		REAL DMR = a * exp( (REAL)pop->numLarvae1DayEquiv / (ageInDays * carryingCapacity * rainfallCoefficient) );
-		DMR = min(DMR, 0.8f);	// Clip if larger than 1.0
-
-		REAL DSR = 1.0f - DMR;	// DSR = Daily Survival Rate
-		REAL HSR = pow(DSR, 1.0f/24.0f);	// HSR = Hourly Survival Rate
-		REAL HMR = 1.0f - HSR;	// HMR = Hourly Mortality Rate
-
-		if (probability <= HMR) {	// Kill this agent
-			agentStates[gid].dead = true;
+	for(UINT s = 0; s < NUM_STATES; ++s) {
+		// the items of span s left in the tile, their slots follow the first slot of the span
+		UINT last = min(spans->firstItem[s + 1], tileEnd);
+		for(UINT gid = spans->start[s] + item - spans->firstItem[s]; item < last; ++item, ++gid) {
+			if(agentDies(pop, gid, agents[gid].ageInHours, mortality, seeds))	// Kill this agent
+				agentStates[gid].dead = true;
 		}
-
-		//agents[gid] = agent;
-		return;
 	}
-
-	// pupae state
-	REAL DMR = 0.1f;	// DMR = Daily Mortality Rate
-	REAL DSR = 1.0f - DMR;	// DSR = Daily Survival Rate
-	REAL HSR = pow(DSR, 1.0f/24.0f);	// HSR = Hourly Survival Rate
-	REAL HMR = 1.0f - HSR;	// HMR = Hourly Mortality Rate
-
-	if (probability <= HMR) {	// Kill this agent
-		agentStates[gid].dead = true;
-	}
-
-	//agents[gid] = agent;
-
-	return;
 }
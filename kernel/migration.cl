@@ -0,0 +1,145 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ */
+
+#include "device_types.h"
+#include "agent.h"
+#include "gpuRand.h"
+#include "migration.h"
+
+#define NUM_STATES 8
+
+/*
+ * @return the range of state s (0 for EGG to 7 for GRAVID) of a population, the ranges are consecutive in struct Population
+ */
+__global struct AgentRange* migrationRange(__global struct Population* pop, UINT s) {
+	return &pop->eggs + s;
+}
+
+/*
+ * 1st step of the migration, run after compactOffsets with a single work-item per population. Draws the number of migrants of each outgoing edge of the
+ * population's patch and the window of emigrants of each state
+ * @param population the properties of the current population at position 0 and of the next iteration's population, without migration, at position 1
+ * @param edges the edges of all patches, sorted by their source patch
+ * @param outStart index of the first edge of each patch in edges, plus the number of edges
+ * @param popMigration migration state of each population, see MIGRATION_POP_STRIDE
+ * @param edgeMigration migration state of each edge of each replicate, see MIGRATION_EDGE_STRIDE
+ * @param seeds seeds for the random number generator, the draws use the slot 0
+ * @param numEdges the number of edges
+ */
+__kernel void migrationDraw(__global struct Population* population, __global const struct MigrationEdge* edges, __global const UINT* outStart,
+		__global UINT* popMigration, __global UINT* edgeMigration, __constant struct Seeds* seeds, UINT numEdges) {
+	UINT patch = PATCH;
+	__global struct Population* next = &population[2 * REPLICATE + 1];
+	popMigration += REPLICATE * MIGRATION_POP_STRIDE;
+	edgeMigration += (REPLICATE / NUM_PATCHES) * numEdges * MIGRATION_EDGE_STRIDE;
+
+	UINT count[NUM_STATES], remaining[NUM_STATES];
+	for(UINT s = 0; s < NUM_STATES; ++s) {
+		__global struct AgentRange* range = migrationRange(next, s);
+		count[s] = range->end - range->start;
+		remaining[s] = count[s];
+	}
+
+	// the draws of the states of an edge, and of the windows, are two blocks of four
+	REAL u[NUM_STATES];
+	for(UINT e = outStart[patch]; e < outStart[patch + 1]; ++e) {
+		vstore4(randUniform4(seeds, 0, (MIGRATION_DRAW + e * NUM_STATES) / 4), 0, u);
+		vstore4(randUniform4(seeds, 0, (MIGRATION_DRAW + e * NUM_STATES) / 4 + 1), 1, u);
+
+		for(UINT s = 0; s < NUM_STATES; ++s) {
+			UINT migrants = 0;
+			if(s >= FIRST_MIGRATING_STATE) {
+				// the expected number of migrants, rounded up with the probability of its fractional part
+				REAL expected = count[s] * edges[e].rate;
+				migrants = min((UINT)(expected + 1.0f - u[s]), remaining[s]);
+			}
+			remaining[s] -= migrants;
+			edgeMigration[e * MIGRATION_EDGE_STRIDE + s] = migrants;
+		}
+	}
+
+	vstore4(randUniform4(seeds, 0, (MIGRATION_DRAW + (numEdges + 1) * NUM_STATES) / 4), 0, u);
+	vstore4(randUniform4(seeds, 0, (MIGRATION_DRAW + (numEdges + 1) * NUM_STATES) / 4 + 1), 1, u);
+	for(UINT s = 0; s < NUM_STATES; ++s) {
+		UINT emigrants = count[s] - remaining[s];
+		popMigration[s] = emigrants;
+		popMigration[NUM_STATES + s] = emigrants > 0 ? min((UINT)(u[s] * count[s]), count[s] - 1) : 0;
+	}
+}
+
+/*
+ * 2nd step of the migration, run with a single work-item per population. Calculates the offsets of the immigrants from each incoming edge and writes the
+ * properties of the next iteration's population including the migrants and the agents imported from other ranks to position 1 in population
+ * @param population the properties of the current population at position 0 and of the next iteration's population, without migration, at position 1
+ * @param inEdges indices of the edges sorted by their target patch
+ * @param inStart index of the first incoming edge of each patch in inEdges, plus the number of edges
+ * @param popMigration migration state of each population, see MIGRATION_POP_STRIDE
+ * @param edgeMigration migration state of each edge of each replicate, see MIGRATION_EDGE_STRIDE
+ * @param imports the agents imported from other ranks, see MIGRATION_IMPORT_STRIDE
+ * @param numEdges the number of edges
+ */
+__kernel void migrationRanges(__global struct Population* population, __global const UINT* inEdges, __global const UINT* inStart,
+		__global UINT* popMigration, __global UINT* edgeMigration, __global const UINT* imports, UINT numEdges) {
+	UINT patch = PATCH;
+	__global struct Population* next = &population[2 * REPLICATE + 1];
+	popMigration += REPLICATE * MIGRATION_POP_STRIDE;
+	edgeMigration += (REPLICATE / NUM_PATCHES) * numEdges * MIGRATION_EDGE_STRIDE;
+	imports += REPLICATE * MIGRATION_IMPORT_STRIDE;
+
+	UINT end = 0;
+	for(UINT s = 0; s < NUM_STATES; ++s) {
+		__global struct AgentRange* range = migrationRange(next, s);
+		UINT stay = range->end - range->start - popMigration[s];
+
+		UINT immigrants = 0;
+		for(UINT i = inStart[patch]; i < inStart[patch + 1]; ++i) {
+			UINT e = inEdges[i];
+			edgeMigration[e * MIGRATION_EDGE_STRIDE + NUM_STATES + s] = immigrants;
+			immigrants += edgeMigration[e * MIGRATION_EDGE_STRIDE + s];
+		}
+		popMigration[2 * NUM_STATES + s] = stay;
+		popMigration[3 * NUM_STATES + s] = stay + immigrants;
+
+		// same layout as written by compactOffsets, a space of at least one between the states
+		range->start = s == 0 ? 0 : ALIGN_RANGE(end);
+		range->end = range->start + stay + immigrants + imports[s];
+		end = range->end;
+	}
+}
+
+/*
+ * copies the agents imported from other ranks to the end of the ranges of their state, run after compactAgents with one work-item per imported agent
+ * of the population with the most imports
+ * @param newAgents array holding all agents of the next iteration
+ * @param newAgentAges array holding all agents' age information of the next iteration
+ * @param newAgentStates array holding all agents' state information of the next iteration
+ * @param inboxAgents the imported agents of all populations, grouped by population and state
+ * @param inboxAges the age information of the imported agents
+ * @param inboxStates the state information of the imported agents
+ * @param population the properties of the next iteration's population at position 1, written by migrationRanges
+ * @param imports the number of imported agents of each population and state and their position in the inbox, see MIGRATION_IMPORT_STRIDE
+ * @param popMigration migration state of each population, see MIGRATION_POP_STRIDE
+ */
+__kernel void importAgents(__global struct Agent* newAgents, __global struct AgentAge* newAgentAges, __global struct AgentState* newAgentStates,
+		__global const struct Agent* inboxAgents, __global const struct AgentAge* inboxAges, __global const struct AgentState* inboxStates,
+		__global struct Population* population, __global const UINT* imports, __global const UINT* popMigration) {
+	UINT gid = get_global_id(0);
+	__global struct Population* next = &population[2 * REPLICATE + 1];
+	imports += REPLICATE * MIGRATION_IMPORT_STRIDE;
+	popMigration += REPLICATE * MIGRATION_POP_STRIDE;
+
+	UINT first = 0;
+	for(UINT s = 0; s < NUM_STATES; ++s) {
+		if(gid < first + imports[s]) {
+			UINT newIdx = AGENT_OFFSET + migrationRange(next, s)->start + popMigration[3 * NUM_STATES + s] + gid - first;
+			UINT inboxIdx = imports[NUM_STATES + s] + gid - first;
+			newAgents[newIdx] = inboxAgents[inboxIdx];
+			newAgentAges[newIdx] = inboxAges[inboxIdx];
+			newAgentStates[newIdx] = inboxStates[inboxIdx];
+			return;
+		}
+		first += imports[s];
+	}
+}
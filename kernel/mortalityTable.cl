@@ -0,0 +1,24 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ */
+
+#include "device_types.h"
+#include "agent.h"
+#include "mortality.h"
+
+/*
+ * tabulates the hourly mortality rates of each population for the current time step, one work-item per entry. Has to run after the larvae 1 day
+ * equivalent is calculated and before the agents are killed
+ * @param pop the properties (number of agents in certain state) of the current population
+ * @param environments the environments of the forcing table on the device, used to get the carrying capacity
+ * @param row the row of the current time step in the forcing table of each patch
+ * @param mortality will hold MORTALITY_TABLE_SIZE hourly mortality rates per population
+ */
+__kernel void mortalityTable(__constant struct Population* pop, __global const struct Environment* environments, UINT row, __global REAL* mortality) {
+	UINT gid = get_global_id(0);
+	if(gid >= MORTALITY_TABLE_SIZE) return;
+	pop += 2 * REPLICATE;
+
+	mortality[REPLICATE * MORTALITY_TABLE_SIZE + gid] = tabulateMortality(gid, pop->numLarvae1DayEquiv, environments[FORCING_ROW(row)].carryingCapacity);
+}
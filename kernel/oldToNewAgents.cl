@@ -24,7 +24,7 @@ void printPopulation(struct Population* pop) {
 */
 
 void calcNewRange(struct AgentRange* newRange, UINT startingPoint, UINT size) {
-	newRange->start = ((startingPoint + LOCAL_SIZE) / LOCAL_SIZE) * LOCAL_SIZE;
+	newRange->start = ALIGN_RANGE(startingPoint);
 	newRange->end = newRange->start + size;
 }
 
@@ -44,17 +44,31 @@ void calcNewRange(struct AgentRange* newRange, UINT startingPoint, UINT size) {
  * @param prefixSum3 array with a prefix sum for all pupae and blood meal seekings of the current iteration
  * @param population the properties (number of agents in certain state) of the current population at positon 0. The properties of the next iteraiont's
  * 			population will be written to position 1.
+ * @param spans the spans of the agents of each population, written by agentSpans
  * @param enb eggs and biomass struct to get the number of newly generated eggs
  */
 __kernel void oldToNewAgents(__global struct Agent* oldAgents, __global struct AgentAge* oldAgentAges, __global struct AgentState* oldAgentStates,
 		__global struct Agent* newAgents, __global struct AgentAge* newAgentAges, __global struct AgentState* newAgentStates,
 		__global INT* prefixSum1, __global INT* prefixSum2, __global INT* prefixSum3,
-		__global struct Population* population,	__constant struct EggsNbiomass* enb) {
+		__global struct Population* population, __constant struct AgentSpans* spans, __constant struct EggsNbiomass* enb) {
 
 	UINT gid = get_global_id(0);
+	oldAgents += AGENT_OFFSET;
+	oldAgentAges += AGENT_OFFSET;
+	oldAgentStates += AGENT_OFFSET;
+	newAgents += AGENT_OFFSET;
+	newAgentAges += AGENT_OFFSET;
+	newAgentStates += AGENT_OFFSET;
+	prefixSum1 += AGENT_OFFSET;
+	prefixSum2 += AGENT_OFFSET;
+	prefixSum3 += AGENT_OFFSET;
+	population += 2 * REPLICATE;
+	spans += REPLICATE;
+	enb += REPLICATE;
 	struct Population pop = population[0];
 
-	if(gid == pop.gravids.end) { // write new properties array
+	// the work-item behind the last agent writes the new properties array
+	if(gid == spans->firstItem[8]) {
 #define USE_PRIVATE 0
 #if USE_PRIVATE
 		// NVIDIA cannot handle this version
@@ -73,25 +87,25 @@ for(INT i = 0; i < environment->newEggs; ++i)
 		printf("\t%d is not an egg %d\n", i, newAgents[i].state);
 */
 		// assure a space between states of at leas one in order to avoid overwriting of last element of prefix sum
-		offset->larvae.start = ((offset->eggs.end + LOCAL_SIZE) / LOCAL_SIZE) * LOCAL_SIZE;
+		offset->larvae.start = ALIGN_RANGE(offset->eggs.end);
 		offset->larvae.end = offset->larvae.start + prefixSum2[pop.larvae.end] + 1;
 //		calcNewRange(&offset->larvae, offset->eggs.end, prefixSum2[pop.larvae.end]);
-		offset->pupae.start = ((offset->larvae.end + LOCAL_SIZE) / LOCAL_SIZE) * LOCAL_SIZE;
+		offset->pupae.start = ALIGN_RANGE(offset->larvae.end);
 		offset->pupae.end = offset->pupae.start + prefixSum3[pop.pupae.end-pop.larvae.start] + 1;
 //		calcNewRange(&offset->pupae, offset->larvae.end, prefixSum3[pop.pupae.end]);
-		offset->immatures.start = ((offset->pupae.end + LOCAL_SIZE) / LOCAL_SIZE) * LOCAL_SIZE;
+		offset->immatures.start = ALIGN_RANGE(offset->pupae.end);
 		offset->immatures.end = offset->immatures.start + prefixSum1[pop.immatures.end] + 1;
 //		calcNewRange(&offset->immatures, offset->pupae.end, prefixSum1[pop.immatures.end]);
-		offset->mateSeekings.start = ((offset->immatures.end + LOCAL_SIZE) / LOCAL_SIZE) * LOCAL_SIZE;
+		offset->mateSeekings.start = ALIGN_RANGE(offset->immatures.end);
 		offset->mateSeekings.end = offset->mateSeekings.start + prefixSum2[pop.mateSeekings.end] + 1;
 //		calcNewRange(&offset->mateSeekings, offset->immatures.end, prefixSum2[pop.mateSeekings.end]);
-		offset->bmSeekings.start = ((offset->mateSeekings.end + LOCAL_SIZE) / LOCAL_SIZE) * LOCAL_SIZE;
+		offset->bmSeekings.start = ALIGN_RANGE(offset->mateSeekings.end);
 		offset->bmSeekings.end = offset->bmSeekings.start + prefixSum3[pop.gravids.end-pop.larvae.start] + 1;
 //		calcNewRange(&offset->bmSeekings, offset->mateSeekings.end, prefixSum3[pop.gravids.end]);
-		offset->bmDigestings.start = ((offset->bmSeekings.end + LOCAL_SIZE) / LOCAL_SIZE) * LOCAL_SIZE;
+		offset->bmDigestings.start = ALIGN_RANGE(offset->bmSeekings.end);
 		offset->bmDigestings.end = offset->bmDigestings.start + prefixSum1[pop.bmDigestings.end] + 1;
 //		calcNewRange(&offset->bmDigestings, offset->bmSeekings.end, prefixSum1[pop.bmDigestings.end]);
-		offset->gravids.start = ((offset->bmDigestings.end + LOCAL_SIZE) / LOCAL_SIZE) * LOCAL_SIZE;
+		offset->gravids.start = ALIGN_RANGE(offset->bmDigestings.end);
 		offset->gravids.end = offset->gravids.start + prefixSum2[pop.gravids.end] + 1;
 //		calcNewRange(&offset.gravids, offset.bmDigestings.end, prefixSum2[pop.gravids.end]);
 #if USE_PRIVATE
@@ -99,16 +113,9 @@ for(INT i = 0; i < environment->newEggs; ++i)
 #endif
 	}
 
-	bool valid = !((gid >= pop.eggs.end && gid < pop.larvae.start) ||
-				   (gid >= pop.larvae.end && gid < pop.pupae.start) ||
-				   (gid >= pop.pupae.end && gid < pop.immatures.start) ||
-				   (gid >= pop.immatures.end && gid < pop.mateSeekings.start) ||
-				   (gid >= pop.mateSeekings.end && gid < pop.bmSeekings.start) ||
-				   (gid >= pop.bmSeekings.end && gid < pop.bmDigestings.start) ||
-				   (gid >= pop.bmDigestings.end && gid < pop.gravids.start) ||
-				   (gid >= pop.gravids.end));
-
-	if(!valid) return;
+	// the other work-items copy the agents, mapped to them with agentSlot
+	gid = agentSlot(spans, gid);
+	if(gid >= pop.gravids.end) return;
 
 	struct AgentState agentState = oldAgentStates[gid];
 
@@ -135,8 +142,8 @@ for(INT i = 0; i < environment->newEggs; ++i)
 	// add all moved eggs to offset
 	offset.eggs.end += (pop.eggs.end > 0) ? prefixSum1[pop.eggs.end] + 1 : 0; // TODO check if
 
-	// round offset to the next multiple of LOCAL_SIZE
-	offset.larvae.start = ((offset.eggs.end + LOCAL_SIZE) / LOCAL_SIZE) * LOCAL_SIZE;
+	// round offset to the next multiple of RANGE_ALIGNMENT
+	offset.larvae.start = ALIGN_RANGE(offset.eggs.end);
 
 	if(state == LARVA) {
 		UINT newIdx = offset.larvae.start + prefixSum2[gid];
@@ -148,8 +155,8 @@ for(INT i = 0; i < environment->newEggs; ++i)
 
 	// add all moved larvae to offset
 	offset.larvae.end = offset.larvae.start + prefixSum2[pop.larvae.end] + 1;
-	// round offset to the next multiple of LOCAL_SIZE
-	offset.pupae.start = ((offset.larvae.end + LOCAL_SIZE) / LOCAL_SIZE) * LOCAL_SIZE;
+	// round offset to the next multiple of RANGE_ALIGNMENT
+	offset.pupae.start = ALIGN_RANGE(offset.larvae.end);
 
 	if(state == PUPA) {
 //printf("bmd %d %d\n", gid, offset.larvae.start);
@@ -162,8 +169,8 @@ for(INT i = 0; i < environment->newEggs; ++i)
 
 	// add all moved pupae to offset
 	offset.pupae.end = offset.pupae.start + prefixSum3[pop.pupae.end-pop.larvae.start] + 1;
-	// round offset to the next multiple of LOCAL_SIZE
-	offset.immatures.start = ((offset.pupae.end + LOCAL_SIZE) / LOCAL_SIZE) * LOCAL_SIZE;
+	// round offset to the next multiple of RANGE_ALIGNMENT
+	offset.immatures.start = ALIGN_RANGE(offset.pupae.end);
 
 	if(state == IMMATURE) {
 		UINT newIdx = offset.immatures.start + prefixSum1[gid];
@@ -175,8 +182,8 @@ for(INT i = 0; i < environment->newEggs; ++i)
 
 	// add all moved immatures to offset
 	offset.immatures.end = offset.immatures.start + prefixSum1[pop.immatures.end] + 1;
-	// round offset to the next multiple of LOCAL_SIZE
-	offset.mateSeekings.start = ((offset.immatures.end + LOCAL_SIZE) / LOCAL_SIZE) * LOCAL_SIZE;
+	// round offset to the next multiple of RANGE_ALIGNMENT
+	offset.mateSeekings.start = ALIGN_RANGE(offset.immatures.end);
 
 	if(state == MATESEEKING) {
 //printf("%d : %d \n", prefixSum1[gid], agent.state);
@@ -189,8 +196,8 @@ for(INT i = 0; i < environment->newEggs; ++i)
 
 	// add all moved mate seekings to offset
 	offset.mateSeekings.end = offset.mateSeekings.start + prefixSum2[pop.mateSeekings.end] + 1;
-	// round offset to the next multiple of LOCAL_SIZE
-	offset.bmSeekings.start = ((offset.mateSeekings.end + LOCAL_SIZE) / LOCAL_SIZE) * LOCAL_SIZE;
+	// round offset to the next multiple of RANGE_ALIGNMENT
+	offset.bmSeekings.start = ALIGN_RANGE(offset.mateSeekings.end);
 
 	if(state == BMS) {
 		UINT newIdx = offset.bmSeekings.start + prefixSum3[gid-pop.larvae.start];
@@ -202,8 +209,8 @@ for(INT i = 0; i < environment->newEggs; ++i)
 
 	// add all moved blood meal seekings to offset
 	offset.bmSeekings.end = offset.bmSeekings.start + prefixSum3[pop.gravids.end-pop.larvae.start] + 1;
-	// round offset to the next multiple of LOCAL_SIZE
-	offset.bmDigestings.start = ((offset.bmSeekings.end + LOCAL_SIZE) / LOCAL_SIZE) * LOCAL_SIZE;
+	// round offset to the next multiple of RANGE_ALIGNMENT
+	offset.bmDigestings.start = ALIGN_RANGE(offset.bmSeekings.end);
 
 	if(state == BMD) {
 		UINT newIdx = offset.bmDigestings.start + prefixSum1[gid];
@@ -215,8 +222,8 @@ for(INT i = 0; i < environment->newEggs; ++i)
 
 	// add all moved blood meal seekings to offset
 	offset.bmDigestings.end = offset.bmDigestings.start + prefixSum1[pop.bmDigestings.end] + 1;
-	// round offset to the next multiple of LOCAL_SIZE
-	offset.gravids.start = ((offset.bmDigestings.end + LOCAL_SIZE) / LOCAL_SIZE) * LOCAL_SIZE;
+	// round offset to the next multiple of RANGE_ALIGNMENT
+	offset.gravids.start = ALIGN_RANGE(offset.bmDigestings.end);
 
 	if(state == GRAVID) {
 		UINT newIdx = offset.gravids.start + prefixSum2[gid];
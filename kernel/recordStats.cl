@@ -0,0 +1,21 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ */
+
+#include "device_types.h"
+#include "agent.h"
+
+/*
+ * copies the properties of the current population and the bites and cycles of the last time step to the ring buffer, using a single thread per
+ * replicate. Has to be run after calcL1deTotal and calcFemalesTotal
+ * @param pop the properties (number of agents in certain state) of the current population at position 0
+ * @param bnc the bites and cycles of the last time step
+ * @param ring the ring buffer the host reads every few time steps, holding the records of all replicates for each slot
+ * @param slot the position to write to in ring
+ */
+__kernel void recordStats(__global struct Population* pop, __global struct BitesNcycles* bnc, __global struct StatsRecord* ring, UINT slot) {
+	__global struct StatsRecord* record = &ring[slot * get_global_size(1) + REPLICATE];
+	record->pop = pop[2 * REPLICATE];
+	record->bnc = bnc[REPLICATE];
+}
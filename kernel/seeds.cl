@@ -0,0 +1,18 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ */
+
+#include "device_types.h"
+#include "agent.h"
+
+/*
+ * advances the time step counter of all seeds of the counter based random number generator, using a single thread. This replaces the upload of new
+ * seeds from the host in every time step
+ * @param seeds the seeds of the random number generator
+ * @param nSeeds the number of seeds
+ */
+__kernel void advanceSeeds(__global struct Seeds* seeds, UINT nSeeds) {
+	for(UINT i = 0; i < nSeeds; ++i)
+		++seeds[i].z3;
+}
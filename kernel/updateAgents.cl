@@ -10,6 +10,9 @@
 #include "device_types.h"
 #include "agent.h"
 #include "gpuRand.h"
+#include "mortality.h"
+
+#define NUM_STATES 8
 
 // default values for probabilities if not defined in agents specific header file
 #ifndef BITE_HUMAN_PROBABILITY
@@ -23,41 +26,17 @@
 #endif
 
 /*
- * initializes the environment with several eggs of agents
- * @param agents the agents that will be updated
- * @param agentAges age information of the agents to update
- * @param agentStates state information of the agents to update
- * @param pop the properties (number of agents in certain state) of the current population
- * @param environment the environment, used to get the carrying capacity and properties of interventions
- * @param temperature the temperature in this timestep as a floating point number
- * @param bnc single struct that will be filled with the information about the bites and performed cycles using atomic operations
- * @param enb structure to store the number of laid eggs and to read the total biomass
- * @param seeds seeds for the random number generator
- * @param elapsedTimeInHours the time in hours since the last update
- * @param worldTime the current world time ranging from 0 to 23
+ * updates a single living agent. Only the parts of the agent that changed are written back
+ * @param gid the index of the agent
+ * @param agentState state information of the agent, already read from agentStates
+ * @param agentAge age information of the agent, already read from agentAges
+ * all other parameters as in updateAgents
  */
-__kernel void updateAgents(__global struct Agent* agents, __global struct AgentAge* agentAges, __global struct AgentState* agentStates,
+void updateAgent(UINT gid, struct AgentState agentState, struct AgentAge agentAge,
+		__global struct Agent* agents, __global struct AgentAge* agentAges, __global struct AgentState* agentStates,
 		__constant struct Population* pop, struct Environment environment, Temperature temperature, __global struct BitesNcycles* bnc,
-		 __global struct EggsNbiomass* enb, __constant struct Seeds* seeds,	REAL elapsedTimeInHours, UINT worldTime) {
-
-	UINT gid = get_global_id(0);
-
-	bool valid = !((gid >= pop->eggs.end && gid < pop->larvae.start) ||
-				   (gid >= pop->larvae.end && gid < pop->pupae.start) ||
-				   (gid >= pop->pupae.end && gid < pop->immatures.start) ||
-				   (gid >= pop->immatures.end && gid < pop->mateSeekings.start) ||
-				   (gid >= pop->mateSeekings.end && gid < pop->bmSeekings.start) ||
-				   (gid >= pop->bmSeekings.end && gid < pop->bmDigestings.start) ||
-				   (gid >= pop->bmDigestings.end && gid < pop->gravids.start) ||
-				   (gid >= pop->gravids.end));
-
-	if(!valid) return;
-
-	struct AgentState agentState = agentStates[gid];
-	if(agentState.dead) return;
-
+		__global struct EggsNbiomass* enb, __constant struct Seeds* seeds, REAL elapsedTimeInHours, UINT worldTime) {
 	struct Agent agent = agents[gid];
-	struct AgentAge agentAge = agentAges[gid];
 
 	agentAge.ageInHours += elapsedTimeInHours;
 	agentAge.hoursInState += elapsedTimeInHours;
@@ -76,7 +55,7 @@ __kernel void updateAgents(__global struct Agent* agents, __global struct AgentA
 			agentAge.hoursInState = 0.0f;
 			// agent.timeEntered = environment.totalTime; not used
 			// agent.cumulativeLarvalDleay = 0.0f; already set at egg creation
-			agent.delay = larvaDelay(seeds+1);
+			agent.delay = larvaDelay(seeds+1, gid);
 
 			agentState.state = LARVA;
 			agents[gid] = agent;
@@ -88,7 +67,7 @@ __kernel void updateAgents(__global struct Agent* agents, __global struct AgentA
 
 	if(gid < pop->larvae.end) {
 		if (environment.larvacideValue > 0.0f && agentAge.hoursInState == elapsedTimeInHours) { // TODO check if first time to update the larva only
-			REAL larvacide = HybridTaus(&seeds[2]);
+			REAL larvacide = randUniform(&seeds[2], gid);
 			if (larvacide <= environment.larvacideValue) {
 				agentState.dead = true;	// Mark this agent as 'dead'
 				agentStates[gid] = agentState;
@@ -160,11 +139,11 @@ __kernel void updateAgents(__global struct Agent* agents, __global struct AgentA
 		++agent.cycleLength;
 
 		if((agentAge.hoursInState >= agent.delay) && bloodMealSeekingsTransitionTime(worldTime)) {
-			REAL bloodmealSuccessProbability = HybridTaus(&seeds[1]); //TODO random
+			REAL bloodmealSuccessProbability = randUniform(&seeds[1], gid); //TODO random
 			if(bloodmealSuccessProbability <= environment.bloodmealSuccess) {
 
 				if(environment.ITNValue * BITE_HUMAN_PROBABILITY * BITE_INDOOR_PROBABILITY > 0.0f) {
-					REAL ITN = HybridTaus(&seeds[2]); //TODO random
+					REAL ITN = randUniform(&seeds[2], gid); //TODO random
 					if(ITN <= environment.ITNValue * BITE_HUMAN_PROBABILITY * BITE_INDOOR_PROBABILITY) {
 						agentState.dead = true;
 						agentStates[gid] = agentState;
@@ -172,7 +151,7 @@ __kernel void updateAgents(__global struct Agent* agents, __global struct AgentA
 					}
 				}
 
-				int bitesAhuman = BITE_HUMAN_PROBABILITY < 1.0f ? (HybridTaus(&seeds[3]) <= BITE_HUMAN_PROBABILITY) : 1;
+				int bitesAhuman = BITE_HUMAN_PROBABILITY < 1.0f ? (randUniform(&seeds[3], gid) <= BITE_HUMAN_PROBABILITY) : 1;
 
 				agent.humanBloodmealCount += 1u * bitesAhuman;
 
@@ -198,7 +177,7 @@ __kernel void updateAgents(__global struct Agent* agents, __global struct AgentA
 
 	if(gid < pop->bmDigestings.end) {
 		if(environment.IRSValue * REST_INDOOR_PROBABILITY > 0.0f) {
-			REAL ITN = HybridTaus(&seeds[2]); //TODO random
+			REAL ITN = randUniform(&seeds[2], gid); //TODO random
 			if(ITN <= environment.IRSValue * REST_INDOOR_PROBABILITY) {
 				agentState.dead = true;
 				agentStates[gid] = agentState;
@@ -210,7 +189,7 @@ __kernel void updateAgents(__global struct Agent* agents, __global struct AgentA
 
 		if(agentAge.hoursInState >= agent.delay && bloodMealDigestingsTransitionTime(worldTime)) {
 			if(agent.availableEggs <= 0 && agentAge.isFemale) { // generate eggs
-				agent.availableEggs = generateEggs(seeds+1, &agent.numEggBatches);
+				agent.availableEggs = generateEggs(seeds+1, gid, &agent.numEggBatches);
 			}
 
 			// gravid state enter
@@ -230,11 +209,11 @@ __kernel void updateAgents(__global struct Agent* agents, __global struct AgentA
 	// gravid state
 	++agent.cycleLength;
 	if(gravidsEggLayTime(worldTime)) {
-		bool shouldLayEggs = HybridTaus(&seeds[1]) < 0.25f; // TODO random
+		bool shouldLayEggs = randUniform(&seeds[1], gid) < 0.25f; // TODO random
 
 		if(shouldLayEggs) {
 			if(environment.oviTrapValue > 0.0f) {
-				REAL OVITrap = HybridTaus(&seeds[2]); // TODO random
+				REAL OVITrap = randUniform(&seeds[2], gid); // TODO random
 				if(OVITrap <= environment.oviTrapValue) {
 					agentState.dead = true;
 					agent.availableEggs = 0;
@@ -268,3 +247,188 @@ __kernel void updateAgents(__global struct Agent* agents, __global struct AgentA
 	agentAges[gid] = agentAge;
 
 }
+
+/*
+ * initializes the environment with several eggs of agents
+ * @param agents the agents that will be updated
+ * @param agentAges age information of the agents to update
+ * @param agentStates state information of the agents to update
+ * @param pop the properties (number of agents in certain state) of the current population
+ * @param spans the spans of the agents of each population, written by agentSpans
+ * @param environments the environments of the forcing table on the device, used to get the carrying capacity and properties of interventions
+ * @param temperatures the temperatures of the forcing table on the device
+ * @param row the row of the current time step in the forcing table of each patch
+ * @param bnc single struct that will be filled with the information about the bites and performed cycles using atomic operations
+ * @param enb structure to store the number of laid eggs and to read the total biomass
+ * @param seeds seeds for the random number generator
+ * @param elapsedTimeInHours the time in hours since the last update
+ * @param worldTime the current world time ranging from 0 to 23
+ */
+__kernel void updateAgents(__global struct Agent* agents, __global struct AgentAge* agentAges, __global struct AgentState* agentStates,
+		__constant struct Population* pop, __constant struct AgentSpans* spans, __global const struct Environment* environments,
+		__global const Temperature* temperatures, UINT row, __global struct BitesNcycles* bnc, __global struct EggsNbiomass* enb, __constant struct Seeds* seeds,
+		REAL elapsedTimeInHours, UINT worldTime) {
+
+	struct Environment environment = environments[FORCING_ROW(row)];
+	Temperature temperature = temperatures[FORCING_ROW(row)];
+	agents += AGENT_OFFSET;
+	agentAges += AGENT_OFFSET;
+	agentStates += AGENT_OFFSET;
+	pop += 2 * REPLICATE;
+	spans += REPLICATE;
+	bnc += REPLICATE;
+	enb += REPLICATE;
+
+	UINT gid = agentSlot(spans, get_global_id(0));
+	if(gid >= pop->gravids.end) return;
+
+	struct AgentState agentState = agentStates[gid];
+	if(agentState.dead) return;
+
+	updateAgent(gid, agentState, agentAges[gid], agents, agentAges, agentStates, pop, environment, temperature, bnc, enb, seeds,
+			elapsedTimeInHours, worldTime);
+}
+
+/*
+ * same as updateAgents, but each work-item processes a tile of COARSENING consecutive agents of the spans, walking the spans overlapping its tile
+ * like killAgentsCoarse
+ * all parameters as in updateAgents
+ */
+__kernel void updateAgentsCoarse(__global struct Agent* agents, __global struct AgentAge* agentAges, __global struct AgentState* agentStates,
+		__constant struct Population* pop, __constant struct AgentSpans* spans, __global const struct Environment* environments,
+		__global const Temperature* temperatures, UINT row, __global struct BitesNcycles* bnc, __global struct EggsNbiomass* enb, __constant struct Seeds* seeds,
+		REAL elapsedTimeInHours, UINT worldTime) {
+
+	UINT item = get_global_id(0) * COARSENING;
+	struct Environment environment = environments[FORCING_ROW(row)];
+	Temperature temperature = temperatures[FORCING_ROW(row)];
+	agents += AGENT_OFFSET;
+	agentAges += AGENT_OFFSET;
+	agentStates += AGENT_OFFSET;
+	pop += 2 * REPLICATE;
+	spans += REPLICATE;
+	bnc += REPLICATE;
+	enb += REPLICATE;
+	UINT tileEnd = min(item + COARSENING, spans->firstItem[NUM_STATES]);
+
+	for(UINT s = 0; s < NUM_STATES; ++s) {
+		// the items of span s left in the tile, their slots follow the first slot of the span
+		UINT last = min(spans->firstItem[s + 1], tileEnd);
+		for(UINT gid = spans->start[s] + item - spans->firstItem[s]; item < last; ++item, ++gid) {
+			struct AgentState agentState = agentStates[gid];
+			if(agentState.dead) continue;
+
+			updateAgent(gid, agentState, agentAges[gid], agents, agentAges, agentStates, pop, environment, temperature, bnc, enb, seeds,
+					elapsedTimeInHours, worldTime);
+		}
+	}
+}
+
+/*
+ * resets the counters for killUpdateAgents and calculates the total biomass, like killAgents does for updateAgents. Has to be run with a single thread
+ * per replicate
+ * @param pop the properties (number of agents in certain state) of the current population
+ * @param enb this kernel resets the newEggs counter and calculates the total biomass
+ * @param bnc structure to store the informations about bites and cycles. Will be nulled in this kernel
+ */
+__kernel void resetUpdateCounters(__constant struct Population* pop, __global struct EggsNbiomass* enb, __global struct BitesNcycles* bnc) {
+	resetCounters(pop + 2 * REPLICATE, enb + REPLICATE, bnc + REPLICATE);
+}
+
+/*
+ * kills agents and updates the states of the survivors in a single pass, equivalent to killAgents followed by updateAgents. Each agent's state and age
+ * are read only once. resetUpdateCounters has to be run before this kernel
+ * @param agents the agents that will be updated
+ * @param agentAges age information of the agents to update
+ * @param agentStates state information of the agents to update
+ * @param pop the properties (number of agents in certain state) of the current population
+ * @param spans the spans of the agents of each population, written by agentSpans
+ * @param environments the environments of the forcing table on the device, used to get the carrying capacity and properties of interventions
+ * @param temperatures the temperatures of the forcing table on the device
+ * @param row the row of the current time step in the forcing table of each patch
+ * @param bnc single struct that will be filled with the information about the bites and performed cycles using atomic operations
+ * @param enb structure to store the number of laid eggs and to read the total biomass
+ * @param seeds seeds for the random number generator
+ * @param elapsedTimeInHours the time in hours since the last update
+ * @param worldTime the current world time ranging from 0 to 23
+ * @param mortality the mortality tables of all populations, written by the mortalityTable kernel
+ */
+__kernel void killUpdateAgents(__global struct Agent* agents, __global struct AgentAge* agentAges, __global struct AgentState* agentStates,
+		__constant struct Population* pop, __constant struct AgentSpans* spans, __global const struct Environment* environments,
+		__global const Temperature* temperatures, UINT row, __global struct BitesNcycles* bnc, __global struct EggsNbiomass* enb, __constant struct Seeds* seeds,
+		REAL elapsedTimeInHours, UINT worldTime,
+		__global const REAL* mortality) {
+
+	struct Environment environment = environments[FORCING_ROW(row)];
+	Temperature temperature = temperatures[FORCING_ROW(row)];
+	mortality += REPLICATE * MORTALITY_TABLE_SIZE;
+	agents += AGENT_OFFSET;
+	agentAges += AGENT_OFFSET;
+	agentStates += AGENT_OFFSET;
+	pop += 2 * REPLICATE;
+	spans += REPLICATE;
+	bnc += REPLICATE;
+	enb += REPLICATE;
+
+	UINT gid = agentSlot(spans, get_global_id(0));
+	if(gid >= pop->gravids.end) return;
+
+	struct AgentState agentState = agentStates[gid];
+	if(agentState.dead) return;
+
+	struct AgentAge agentAge = agentAges[gid];
+
+	if(agentDies(pop, gid, agentAge.ageInHours, mortality, seeds)) {	// Kill this agent
+		agentState.dead = true;
+		agentStates[gid] = agentState;
+		return;
+	}
+
+	updateAgent(gid, agentState, agentAge, agents, agentAges, agentStates, pop, environment, temperature, bnc, enb, seeds,
+			elapsedTimeInHours, worldTime);
+}
+
+/*
+ * same as killUpdateAgents, but each work-item processes a tile of COARSENING consecutive agents of the spans, walking the spans overlapping its tile
+ * like killAgentsCoarse
+ * all parameters as in killUpdateAgents
+ */
+__kernel void killUpdateAgentsCoarse(__global struct Agent* agents, __global struct AgentAge* agentAges, __global struct AgentState* agentStates,
+		__constant struct Population* pop, __constant struct AgentSpans* spans, __global const struct Environment* environments,
+		__global const Temperature* temperatures, UINT row, __global struct BitesNcycles* bnc, __global struct EggsNbiomass* enb, __constant struct Seeds* seeds,
+		REAL elapsedTimeInHours, UINT worldTime,
+		__global const REAL* mortality) {
+
+	UINT item = get_global_id(0) * COARSENING;
+	struct Environment environment = environments[FORCING_ROW(row)];
+	Temperature temperature = temperatures[FORCING_ROW(row)];
+	mortality += REPLICATE * MORTALITY_TABLE_SIZE;
+	agents += AGENT_OFFSET;
+	agentAges += AGENT_OFFSET;
+	agentStates += AGENT_OFFSET;
+	pop += 2 * REPLICATE;
+	spans += REPLICATE;
+	bnc += REPLICATE;
+	enb += REPLICATE;
+	UINT tileEnd = min(item + COARSENING, spans->firstItem[NUM_STATES]);
+
+	for(UINT s = 0; s < NUM_STATES; ++s) {
+		// the items of span s left in the tile, their slots follow the first slot of the span
+		UINT last = min(spans->firstItem[s + 1], tileEnd);
+		for(UINT gid = spans->start[s] + item - spans->firstItem[s]; item < last; ++item, ++gid) {
+			struct AgentState agentState = agentStates[gid];
+			if(agentState.dead) continue;
+
+			struct AgentAge agentAge = agentAges[gid];
+
+			if(agentDies(pop, gid, agentAge.ageInHours, mortality, seeds)) {	// Kill this agent
+				agentState.dead = true;
+				agentStates[gid] = agentState;
+				continue;
+			}
+
+			updateAgent(gid, agentState, agentAge, agents, agentAges, agentStates, pop, environment, temperature, bnc, enb, seeds,
+					elapsedTimeInHours, worldTime);
+		}
+	}
+}
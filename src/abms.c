@@ -6,9 +6,19 @@
 #include <stdio.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 
 #include "abms.h"
 #include "scan.h"
+#include "stats.h"
+#include "hostEngine.h"
+#include "checkpoint.h"
+#include "forcing.h"
+#include "statsWriter.h"
+#include "migration.h"
+#include "halo.h"
+#include "tuning.h"
 
 #define FACTOR 320 
 
@@ -17,37 +27,175 @@ long long maxSteps = 8760;
 struct Environment* environment;
 UINT initialAgentCount = 100 * FACTOR;
 REAL carryingCapacity = 500.0f * (REAL)FACTOR;
-Temperature* temperature;
+
+// forcing of a patch, mapped from binary files or parsed from text files
+struct PatchForcing {
+	Temperature* temperature;
+	struct Environment* environment;
+	bool temperatureMapped;
+	bool environmentMapped;
+};
+
+// patches are sites with their own forcing and population. Each replicate consists of numPatches populations, stored one after another in all
+// buffers like the replicates. Without a patch file there is a single patch given by the temperature and environment files
+UINT numPatches = 1;
+struct PatchForcing* patches;
+const char* patchPath = NULL;
+
+// with several ranks each one simulates a part of the numGlobalPatches patches of the patch file. The numPatches patches on its device are its own
+// numLocalPatches patches followed by its halo patches, which collect the migrants to patches of other ranks
+UINT numGlobalPatches = 1;
+UINT numLocalPatches = 1;
+UINT* globalPatch; // index in the patch file of each patch on the device
+UINT* devicePatch; // index on the device of each patch of the patch file, numGlobalPatches if it is not on the device
+UINT* haloOwner; // rank of each patch on the device
+
+// migration of adults between the patches of each replicate, read from the migration file. Each line holds the source patch, the target patch and the
+// fraction of the adults of the source patch moving to the target patch in each time step
+const char* migrationPath = NULL;
+struct MigrationEdge* migrationEdges = NULL; // sorted by the source patch
+UINT numMigrationEdges = 0;
+UINT* migrationOutStart; // index of the first edge of each patch in migrationEdges, plus the number of edges
+UINT* migrationInEdges; // indices of the edges, sorted by their target patch
+UINT* migrationInStart; // index of the first edge of each patch in migrationInEdges, plus the number of edges
+// device buffers of the migration of the calling thread's device, NULL without migration
+__thread struct MigrationGraph* migrationGraph = NULL;
 
 UINT nSeeds = 4u; // number of seeds for random number generator
+unsigned long long runSeed; // seed of the whole run, taken from the time if not given as argument
+bool fixedSeed = false;
+// type of the OpenCL devices simulated on, see -device
+cl_device_type deviceType = DEVICE_TYPE;
+// number of consecutive agents processed by each work-item of killAgents, updateAgents and killUpdateAgents, overrides the work sizes of the devices
+// if not 0. Coarsened tiles give the compilers of CPU devices loops to vectorize, GPUs are faster with a work-item per agent
+UINT coarsening = 0;
+// alignment of the state ranges in agents, overrides the work sizes of the devices if not 0
+UINT rangeAlignment = 0;
+// work sizes of the device driven by the calling thread, from its profile or the defaults of its type
+__thread struct WorkSizes workSizes;
+// CPU devices scan the states in parallel chunks and sort the agents with oldToNewAgents, the others compact all states with a single scan
+__thread bool useChunkScan;
+
+// benchmark the candidate work sizes on each device before the runs, storing the fastest ones in its profile
+bool autotune = false;
+// time steps simulated for each candidate, and the number of times each candidate is simulated, keeping the fastest
+#define AUTOTUNE_STEPS 240
+#define AUTOTUNE_REPEATS 2
+// set while the calling thread tunes its device. run() then measures the time of the update kernels and of the creation of the new agents' arrays
+__thread bool tuning = false;
+__thread double tunedUpdateTime;
+__thread icl_timer* tunedScanTimer;
+// build the kernels with the native math built-ins and relaxed floating point, bin/compareStats measures the effect on the statistics
+bool fastMath = false;
 
 #define DEBUG 1
-
-UINT buffSize = max(max(2*LOCAL_SIZE, 100), maxAgents);
+// kill and update agents with a single kernel instead of killAgents followed by updateAgents
+#define FUSED_UPDATE 1
+// number of host slots for the statistics readback. The statistics of a batch of time steps are printed while the device works on the next batch
+#define STATS_SLOTS 2
 
 //TODO: Fix this for MacOS X. MacOS X seemingly requires this to be an absolute path (relative path doesn't seem to work)
 #define KENRNEL_INCLUDE_PATH "include"
-char kernelBuildArgs[512];
-
-// timing
-icl_event* initEvent;
-icl_event* killEvent;
-icl_event* updateEvent;
-icl_event* preScanEvent;
-icl_event* oldToNewEvent;
+const char* speciesHeader = "properties.h";
+// build options of the kernels, thread local since they contain the capacity of the device driven by the thread
+__thread char kernelBuildArgs[512];
+
+// number of time steps enqueued back to back between two synchronizations with the host. The first step of each batch uses the exact population for
+// the global work sizes, the others a conservative upper bound
+UINT stepsPerSync = 1;
+
+// number of independent replicates of the scenario simulated together
+UINT numReplicates = 1;
+// number of populations simulated together, numPatches for each replicate. Each population has its own part of all buffers with a capacity of
+// replicateCapacity agents
+UINT numPopulations = 1;
+
+// the capacity of each replicate is chosen at the start of a run from the initial population, unless given with -capacity, and limited by the memory of
+// the device. Once the agents of a replicate reach GROWTH_THRESHOLD of it, it is doubled at the next synchronization with the host. Thread local,
+// since every device grows on its own
+#define INITIAL_CAPACITY_FACTOR 8
+#define GROWTH_THRESHOLD 0.75
+// fraction of the device memory left for all buffers except the agent buffers
+#define MEMORY_RESERVE 0.1
+UINT initialReplicateCapacity = 0;
+__thread UINT replicateCapacity;
+
+// scenarios forked from a shared burn-in. The first burnInSteps time steps are simulated once with the environment file, then each scenario continues
+// from a device copy of that state with the interventions of its own file, which holds the time steps after the burn-in only
+#define MAX_SCENARIOS 64
+UINT burnInSteps = 0;
+UINT numScenarios = 0;
+const char* scenarioPaths[MAX_SCENARIOS];
+struct Environment* scenarioEnvironments = NULL;
+// agents, agent ages, agent states, populations, eggs and biomass, bites and cycles and seeds. The first NUM_AGENT_BUFFERS hold one element per agent
+#define NUM_STATE_BUFFERS 7
+#define NUM_AGENT_BUFFERS 3
+#define NUM_STATES 8
+
+// the temperature and environment of FORCING_CHUNK_STEPS time steps are uploaded to the device at once. The table on the device holds two chunks for
+// each patch, the next chunk is uploaded while the kernels of the current one run. The kernels read the row of their time step, so the memory needed
+// on the device does not depend on the number of time steps
+#define FORCING_CHUNK_STEPS 512
+#define FORCING_TABLE_ROWS (2 * FORCING_CHUNK_STEPS)
+struct ForcingTable {
+	icl_buffer* environments;
+	icl_buffer* temperatures;
+};
+
+// binary statistics file written instead of printing the statistics of each time step. With several runs, the run index is appended to the file name
+const char* statsPath = NULL;
+__thread struct StatsWriter* statsWriter = NULL;
+
+// checkpoints of the state at the start of a time step, taken every checkpointInterval steps at a synchronization with the host. The living agents are
+// read from the device without waiting and written to the file by a separate thread while the simulation continues. With several runs, the run index
+// is appended to the file names
+UINT checkpointInterval = 0; // 0 for no checkpoints
+const char* checkpointPath = NULL;
+const char* resumePath = NULL;
+__thread pthread_t checkpointWriter;
+__thread bool checkpointPending = false;
+__thread unsigned long long currentRunSeed; // seed of the run driven by this thread, stored in its checkpoints
+
+// host engine, used if requested or if no OpenCL device is found
+bool useHostEngine = false;
+UINT numHostThreads = 0; // 0 to use one thread per core
+
+// ensemble of independent runs, each with its own seed. The runs are scheduled dynamically on all devices, a device picks up the next run as soon as
+// it has finished the previous one, such that faster devices simulate more runs
+UINT numRuns = 1;
+UINT nextRun = 0;
+pthread_mutex_t schedulerMutex = PTHREAD_MUTEX_INITIALIZER;
+// output of each run, copied to stdout in the order of the runs once all previous runs are complete
+FILE** runFiles;
+UINT nextOutput = 0;
+
+// output of the run simulated by the calling thread
+__thread FILE* runOutput;
+
+// timing, thread local as every device is driven by its own host thread
+__thread icl_event* initEvent;
+__thread icl_event* killEvent;
+__thread icl_event* updateEvent;
+__thread icl_event* oldToNewEvent;
 
 #if TIMING
-double initTime;
-icl_timer* l1deTimer;
-icl_timer* genderTimer;
-icl_timer* randTimer;
-double killTime;
-double updateTime;
-double preScanTime;
-icl_timer* scanTimer;
-double oldToNewTime;
+__thread double initTime;
+__thread icl_timer* l1deTimer;
+__thread icl_timer* genderTimer;
+__thread icl_timer* randTimer;
+__thread double killTime;
+__thread double updateTime;
+__thread icl_timer* scanTimer;
+__thread double oldToNewTime;
 #endif
 
+/*
+ * @return the output of the run simulated by the calling thread, stdout for the host engine
+ */
+FILE* output() {
+	return runOutput ? runOutput : stdout;
+}
+
 // swap buffers
 void swap(icl_buffer** a, icl_buffer** b)
 {
@@ -56,100 +204,649 @@ void swap(icl_buffer** a, icl_buffer** b)
 	*b = tmp;
 }
 
-UINT calcNum(struct AgentRange range) {
-	return range.end - range.start;
-}
-
 void printRange(struct AgentRange* range) {
-	printf("[%d\t%d]\t%d\r\n", range->start, range->end, range->end - range->start);
+	fprintf(output(), "[%d\t%d]\t%d\r\n", range->start, range->end, range->end - range->start);
 }
 
-void printStats(struct Stats* stats, struct BitesNcycles* bnc, UINT i) {
+void printStats(struct Stats* stats, struct BitesNcycles* bnc, Temperature temperature, UINT i) {
 	UINT numMature = stats->numImmature + stats->numMating + stats->numBMS + stats->numBMD + stats->numOVI;
 
-	printf("%0.1f, %0.1f", hoursInTimeStep * i, temperature[i]);
+	fprintf(output(), "%0.1f, %0.1f", hoursInTimeStep * i, temperature);
 
-	printf(", %d, %d, %d, %d, %d, %d, %d, %d, %d", numMature, stats->numImmature, stats->numMating, stats->numBMS, stats->numBMD, stats->numOVI,
+	fprintf(output(), ", %d, %d, %d, %d, %d, %d, %d, %d, %d", numMature, stats->numImmature, stats->numMating, stats->numBMS, stats->numBMD, stats->numOVI,
 			stats->numFemales, stats->numPotentiallyInfective, stats->numMales);
-	printf(", %d, %d, %d, %d, %d, ", stats->numEggs, stats->numLarvae, stats->numPupae, stats->numLarvae1DazEquiv, stats->numBiomass);
+	fprintf(output(), ", %d, %d, %d, %d, %d, ", stats->numEggs, stats->numLarvae, stats->numPupae, stats->numLarvae1DazEquiv, stats->numBiomass);
 
 //	printf(", %d\r\n", stats->numEggs + stats->numLarvae + stats->numPupae + stats->numImmature + stats->numMating + stats->numBMS + stats->numBMD + stats->numOVI);
-	printf("%d, %d, %d\r\n", bnc->numCyclesReported > 0 ? bnc->sumCyclesReported / bnc->numCyclesReported : 0,
+	fprintf(output(), "%d, %d, %d\r\n", bnc->numCyclesReported > 0 ? bnc->sumCyclesReported / bnc->numCyclesReported : 0,
 			bnc->numBitesReported, bnc->numInfectBitesReported);
 	// 290, 58, 54, 60, 56, 62, 145, 10, 145, 60, 56, 62, 56, 178
 
 }
 
+/*
+ * queues the statistics of a population at a time step for the statistics file of the run, or prints them if there is none
+ * @param population index of the population, numPatches for each replicate
+ * @param phase 0 for the burn-in or a run without scenarios, s + 1 for scenario s
+ */
+void reportStats(struct Stats* stats, struct BitesNcycles* bnc, UINT population, UINT phase, UINT step) {
+	UINT replicate = population / numPatches;
+	UINT patch = population % numPatches;
+	// halo patches are reported by the rank which owns them
+	if(patch >= numLocalPatches)
+		return;
+	if(statsWriter) {
+		struct StatsRow row;
+		row.step = step;
+		row.replicate = replicate;
+		row.patch = globalPatch[patch];
+		row.phase = phase;
+		row.hours = hoursInTimeStep * step;
+		row.temperature = patches[patch].temperature[step];
+		row.stats = *stats;
+		row.bnc = *bnc;
+		pushStats(statsWriter, &row);
+		return;
+	}
+
+	// the replicate and the patch are printed in front of the statistics if there are several
+	if(numReplicates > 1)
+		fprintf(output(), "%d, ", replicate);
+	if(numGlobalPatches > 1)
+		fprintf(output(), "%d, ", globalPatch[patch]);
+	printStats(stats, bnc, patches[patch].temperature[step], step);
+}
+
+/*
+ * statistics callback of the host engine, which simulates a single replicate
+ */
+void reportHostStats(struct Stats* stats, struct BitesNcycles* bnc, UINT step) {
+	if(statsWriter) {
+		reportStats(stats, bnc, 0, 0, step);
+		return;
+	}
+	printStats(stats, bnc, patches[0].temperature[step], step);
+}
+
+/*
+ * @return the number of agents in the state ranges of a population, dead ones included. The kernels map their work-items to these agents with agentSlot
+ */
+UINT numRangeAgents(struct Population* pop) {
+	UINT num = 0;
+	for(UINT s = 0; s < NUM_STATES; ++s) {
+		struct AgentRange* range = &pop->eggs + s;
+		num += range->end - range->start;
+	}
+	return num;
+}
+
 void printPopulation(struct Population* pop) {
-	printf("Eggs \t\t"); printRange(&pop->eggs);
-	printf("Larvae \t\t"); printRange(&pop->larvae);
-	printf("Pupae \t\t"); printRange(&pop->pupae);
-	printf("Immatures \t"); printRange(&pop->immatures);
-	printf("MateSeeking \t"); printRange(&pop->mateSeekings);
-	printf("BMS \t\t"); printRange(&pop->bmSeekings);
-	printf("BMD \t\t"); printRange(&pop->bmDigestings);
-	printf("Gravids \t"); printRange(&pop->gravids);
-}
-
-int readSingleValFile(const char* path, REAL** pointer) {
-	*pointer = (REAL*)malloc(sizeof(REAL) * maxSteps);
-	FILE* temp = fopen(path, "r");
-
-	if(!temp) {
-		printf("Cannot open %s. Check temperature file path\n", path);
+	fprintf(output(), "Eggs \t\t"); printRange(&pop->eggs);
+	fprintf(output(), "Larvae \t\t"); printRange(&pop->larvae);
+	fprintf(output(), "Pupae \t\t"); printRange(&pop->pupae);
+	fprintf(output(), "Immatures \t"); printRange(&pop->immatures);
+	fprintf(output(), "MateSeeking \t"); printRange(&pop->mateSeekings);
+	fprintf(output(), "BMS \t\t"); printRange(&pop->bmSeekings);
+	fprintf(output(), "BMD \t\t"); printRange(&pop->bmDigestings);
+	fprintf(output(), "Gravids \t"); printRange(&pop->gravids);
+}
+
+/*
+ * reads the interventions of numSteps time steps from an environment file, either a text file or a binary forcing file
+ * @param path the environment file
+ * @param env will hold the environment of each time step
+ * @param numSteps the number of time steps to read
+ */
+int readEnvironment(const char* path, struct Environment* env, UINT numSteps) {
+	struct Environment* records;
+	long long steps;
+	struct ForcingHeader header;
+	bool binary = isForcingFile(path);
+	if(binary) {
+		records = (struct Environment*)mapForcing(path, FORCING_ENVIRONMENT, sizeof(struct Environment), &header);
+		if(!records)
+			return -1;
+		steps = header.numSteps;
+	} else {
+		steps = readEnvironmentText(path, &records, numSteps, carryingCapacity);
+		if(steps < 0)
+			return -1;
+	}
+
+	int err = 0;
+	if(steps < numSteps) {
+		printf("%s holds %lld time steps, %d are needed\n", path, steps, numSteps);
+		err = -1;
+	} else {
+		memcpy(env, records, sizeof(struct Environment) * numSteps);
+	}
+
+	if(binary)
+		unmapForcing(records);
+	else
+		free(records);
+	return err;
+}
+
+/*
+ * reads the temperature and the environment of all time steps of a patch. Binary forcing files are mapped and used in place. For the first patch the
+ * number of time steps and the length of a time step are then taken from the environment file. Text files are parsed and all files must hold at
+ * least maxSteps time steps
+ * @param forcing will hold the forcing of the patch
+ * @param first true for the first patch
+ */
+int readPatchForcing(const char* temperaturePath, const char* environmentPath, struct PatchForcing* forcing, bool first) {
+	struct ForcingHeader header;
+	forcing->environmentMapped = isForcingFile(environmentPath);
+	if(forcing->environmentMapped) {
+		forcing->environment = (struct Environment*)mapForcing(environmentPath, FORCING_ENVIRONMENT, sizeof(struct Environment), &header);
+		if(!forcing->environment)
+			return -1;
+		if(first) {
+			maxSteps = header.numSteps;
+			hoursInTimeStep = header.hoursInTimeStep;
+		} else if(header.numSteps < maxSteps || header.hoursInTimeStep != hoursInTimeStep) {
+			printf("%s does not match the time steps of the first patch\n", environmentPath);
+			return -1;
+		}
+	} else {
+		forcing->environment = (struct Environment*)malloc(sizeof(struct Environment) * maxSteps);
+		if(readEnvironment(environmentPath, forcing->environment, maxSteps) < 0)
+			return -1;
+	}
+
+	long long steps;
+	forcing->temperatureMapped = isForcingFile(temperaturePath);
+	if(forcing->temperatureMapped) {
+		forcing->temperature = (Temperature*)mapForcing(temperaturePath, FORCING_TEMPERATURE, sizeof(Temperature), &header);
+		if(!forcing->temperature)
+			return -1;
+		steps = header.numSteps;
+		if(header.hoursInTimeStep != hoursInTimeStep) {
+			printf("%s has time steps of %0.2f hours, the environment has %0.2f hours\n", temperaturePath, header.hoursInTimeStep, hoursInTimeStep);
+			return -1;
+		}
+	} else {
+		steps = readTemperatureText(temperaturePath, &forcing->temperature, maxSteps);
+		if(steps < 0)
+			return -1;
+	}
+	if(steps < maxSteps) {
+		printf("%s holds %lld time steps, %lld are needed\n", temperaturePath, steps, maxSteps);
 		return -1;
 	}
 
-	for(UINT i = 0u; i < maxSteps; ++i)
-		fscanf(temp, "%f", &(*pointer)[i]);
+	return 0;
+}
+
+void releasePatchForcing(struct PatchForcing* forcing) {
+	if(forcing->temperatureMapped)
+		unmapForcing(forcing->temperature);
+	else
+		free(forcing->temperature);
+	if(forcing->environmentMapped)
+		unmapForcing(forcing->environment);
+	else
+		free(forcing->environment);
+}
+
+/*
+ * reads the forcing of all patches, either the temperature and environment files for a single patch or the ones listed in the patch file
+ */
+int readForcing(const char* temperaturePath, const char* environmentPath) {
+	if(!patchPath) {
+		numPatches = 1;
+		patches = (struct PatchForcing*)calloc(1, sizeof(struct PatchForcing));
+		if(readPatchForcing(temperaturePath, environmentPath, &patches[0], true) < 0)
+			return -1;
+	} else {
+		FILE* file = fopen(patchPath, "r");
+		if(!file) {
+			printf("Cannot open %s. Check patch file path\n", patchPath);
+			return -1;
+		}
+
+		// one line per patch with its temperature and environment file
+		char paths[2][512];
+		numPatches = 0;
+		patches = NULL;
+		while(fscanf(file, "%511s %511s", paths[0], paths[1]) == 2) {
+			patches = (struct PatchForcing*)realloc(patches, (numPatches + 1) * sizeof(struct PatchForcing));
+			if(readPatchForcing(paths[0], paths[1], &patches[numPatches], numPatches == 0) < 0) {
+				fclose(file);
+				return -1;
+			}
+			++numPatches;
+		}
+		fclose(file);
+
+		if(numPatches == 0) {
+			printf("%s does not list any patch\n", patchPath);
+			return -1;
+		}
+		printf("Patches:\t%d\n", numPatches);
+	}
+
+	// the first patch is used by the host engine
+	environment = patches[0].environment;
+	numPopulations = numReplicates * numPatches;
 
-	fclose(temp);
 	return 0;
 }
 
-int readEnvironment(const char* path) {
-	environment = (struct Environment*)malloc(sizeof(struct Environment) * maxSteps);
-	FILE* interventions = fopen(path, "r");
+/*
+ * reads the migration file, the edges are sorted by their source patch
+ */
+int readMigration() {
+	if(!migrationPath)
+		return 0;
+	if(numPatches < 2) {
+		printf("Migration needs at least two patches\n");
+		return -1;
+	}
 
-	if(!interventions) {
-		printf("Cannot open %s. Check environment file path\n", path);
+	FILE* file = fopen(migrationPath, "r");
+	if(!file) {
+		printf("Cannot open %s. Check migration file path\n", migrationPath);
 		return -1;
 	}
 
-	REAL coverage, effectiveness;
+	struct MigrationEdge edge;
+	REAL rateSum[numPatches];
+	memset(rateSum, 0, sizeof(rateSum));
+	while(fscanf(file, "%u %u %f", &edge.from, &edge.to, &edge.rate) == 3) {
+		if(edge.from >= numPatches || edge.to >= numPatches || edge.from == edge.to || edge.rate < 0.0f) {
+			printf("Invalid migration from patch %d to patch %d with rate %f\n", edge.from, edge.to, edge.rate);
+			fclose(file);
+			return -1;
+		}
+		rateSum[edge.from] += edge.rate;
+
+		// insertion keeps the edges sorted by their source patch, in the order of the file
+		migrationEdges = (struct MigrationEdge*)realloc(migrationEdges, (numMigrationEdges + 1) * sizeof(struct MigrationEdge));
+		UINT e = numMigrationEdges++;
+		for(; e > 0 && migrationEdges[e - 1].from > edge.from; --e)
+			migrationEdges[e] = migrationEdges[e - 1];
+		migrationEdges[e] = edge;
+	}
+	fclose(file);
 
-	// TODO check how arguments should be used
-	for(UINT i = 0u; i < maxSteps; ++i) {
-		fscanf(interventions, "%f, %f, ", &coverage, &effectiveness);
-		environment[i].IRSValue = coverage * effectiveness;
-		fscanf(interventions, "%f, %f, ", &coverage, &effectiveness);
-		environment[i].ITNValue = coverage * effectiveness;
-		fscanf(interventions, "%f, %f, ", &coverage, &effectiveness);
-		environment[i].larvacideValue = coverage * effectiveness;
-		fscanf(interventions, "%f, %f, ", &coverage, &effectiveness);
-		environment[i].oviTrapValue = coverage * effectiveness;
-		fscanf(interventions, "%f", &(environment[i].bloodmealSuccess));
-		environment[i].carryingCapacity = carryingCapacity; // TODO change this to reading from file, once an appropriate file is available
+	for(UINT p = 0; p < numPatches; ++p) {
+		if(rateSum[p] > 1.0f) {
+			printf("The migration rates of patch %d sum up to more than one\n", p);
+			return -1;
+		}
 	}
-	fclose(interventions);
 
+	printf("Migration:\t%d edges\n", numMigrationEdges);
 	return 0;
 }
 
+/*
+ * builds the index of the edges by source and by target patch on the device
+ */
+void indexMigration() {
+	migrationOutStart = (UINT*)calloc(numPatches + 1, sizeof(UINT));
+	migrationInStart = (UINT*)calloc(numPatches + 1, sizeof(UINT));
+	migrationInEdges = (UINT*)malloc(max(numMigrationEdges, 1u) * sizeof(UINT));
+	for(UINT e = 0; e < numMigrationEdges; ++e) {
+		++migrationOutStart[migrationEdges[e].from + 1];
+		++migrationInStart[migrationEdges[e].to + 1];
+	}
+	for(UINT p = 0; p < numPatches; ++p) {
+		migrationOutStart[p + 1] += migrationOutStart[p];
+		migrationInStart[p + 1] += migrationInStart[p];
+	}
 
-void generateSeeds(icl_buffer* seedsD, struct Seeds* seedsH, icl_device* dev) {
-#if TIMING
+	UINT* next = (UINT*)malloc(numPatches * sizeof(UINT));
+	memcpy(next, migrationInStart, numPatches * sizeof(UINT));
+	for(UINT e = 0; e < numMigrationEdges; ++e)
+		migrationInEdges[next[migrationEdges[e].to]++] = e;
+	free(next);
+}
+
+/*
+ * assigns the patches to the ranks and keeps the ones of the calling rank, followed by its halo patches: the patches of other ranks which are the
+ * target of a migration from one of its own patches. The edges are mapped to the patches on the device, the ones from patches of other ranks are
+ * dropped
+ */
+int decomposePatches() {
+	numGlobalPatches = numPatches;
+	UINT* owner = (UINT*)calloc(numGlobalPatches, sizeof(UINT));
+	if(haloSize > 1) {
+		if(numGlobalPatches < haloSize) {
+			printf("%d ranks need at least as many patches, %d are given\n", haloSize, numGlobalPatches);
+			free(owner);
+			return -1;
+		}
+
+		// the carrying capacity of a patch is the best estimate of its number of agents known before the run
+		REAL* weights = (REAL*)malloc(numGlobalPatches * sizeof(REAL));
+		for(UINT p = 0; p < numGlobalPatches; ++p) {
+			double sum = 0.0;
+			for(UINT i = 0; i < maxSteps; ++i)
+				sum += patches[p].environment[i].carryingCapacity;
+			weights[p] = (REAL)(sum / maxSteps);
+		}
+		partitionPatches(weights, numGlobalPatches, haloSize, owner);
+		free(weights);
+	}
+
+	devicePatch = (UINT*)malloc(numGlobalPatches * sizeof(UINT));
+	globalPatch = (UINT*)malloc(numGlobalPatches * sizeof(UINT));
+	haloOwner = (UINT*)malloc(numGlobalPatches * sizeof(UINT));
+	numPatches = 0;
+	for(UINT p = 0; p < numGlobalPatches; ++p) {
+		devicePatch[p] = numGlobalPatches;
+		if(owner[p] == haloRank) {
+			devicePatch[p] = numPatches;
+			haloOwner[numPatches] = haloRank;
+			globalPatch[numPatches++] = p;
+		}
+	}
+	numLocalPatches = numPatches;
+	for(UINT e = 0; e < numMigrationEdges; ++e) {
+		UINT to = migrationEdges[e].to;
+		if(owner[migrationEdges[e].from] == haloRank && devicePatch[to] == numGlobalPatches) {
+			devicePatch[to] = numPatches;
+			haloOwner[numPatches] = owner[to];
+			globalPatch[numPatches++] = to;
+		}
+	}
+
+	// the edges of the own patches, still sorted by their source patch as the own patches keep their order
+	UINT numEdges = 0;
+	for(UINT e = 0; e < numMigrationEdges; ++e) {
+		if(owner[migrationEdges[e].from] != haloRank)
+			continue;
+		migrationEdges[numEdges] = migrationEdges[e];
+		migrationEdges[numEdges].from = devicePatch[migrationEdges[e].from];
+		migrationEdges[numEdges].to = devicePatch[migrationEdges[e].to];
+		++numEdges;
+	}
+	numMigrationEdges = numEdges;
+
+	// the forcing of the patches on the device in their order on the device
+	struct PatchForcing* all = patches;
+	patches = (struct PatchForcing*)malloc(numPatches * sizeof(struct PatchForcing));
+	for(UINT p = 0; p < numGlobalPatches; ++p) {
+		if(devicePatch[p] < numPatches)
+			patches[devicePatch[p]] = all[p];
+		else
+			releasePatchForcing(&all[p]);
+	}
+	free(all);
+	free(owner);
+
+	environment = patches[0].environment;
+	numPopulations = numReplicates * numPatches;
+	if(haloSize > 1)
+		printf("Rank %d:\t%d patches, %d halo patches\n", haloRank, numLocalPatches, numPatches - numLocalPatches);
+
+	if(migrationPath)
+		indexMigration();
+	return 0;
+}
+
+/*
+ * @return the device buffers of the migration graph, NULL without migration. The graph does not depend on the capacity and is kept for the whole run
+ */
+struct MigrationGraph* createMigrationGraph(icl_device* dev) {
+	if(!migrationPath)
+		return NULL;
+
+	struct MigrationGraph* graph = (struct MigrationGraph*)malloc(sizeof(struct MigrationGraph));
+	UINT numEdges = max(numMigrationEdges, 1u);
+	graph->numEdges = numMigrationEdges;
+	graph->edges = icl_create_buffer(dev, CL_MEM_READ_ONLY, numEdges * sizeof(struct MigrationEdge));
+	graph->outStart = icl_create_buffer(dev, CL_MEM_READ_ONLY, (numPatches + 1) * sizeof(UINT));
+	graph->inEdges = icl_create_buffer(dev, CL_MEM_READ_ONLY, numEdges * sizeof(UINT));
+	graph->inStart = icl_create_buffer(dev, CL_MEM_READ_ONLY, (numPatches + 1) * sizeof(UINT));
+	graph->popMigration = icl_create_buffer(dev, CL_MEM_READ_WRITE, numPopulations * MIGRATION_POP_STRIDE * sizeof(UINT));
+	graph->edgeMigration = icl_create_buffer(dev, CL_MEM_READ_WRITE, numReplicates * numEdges * MIGRATION_EDGE_STRIDE * sizeof(UINT));
+
+	if(numMigrationEdges > 0) {
+		icl_write_buffer(graph->edges, CL_TRUE, numMigrationEdges * sizeof(struct MigrationEdge), migrationEdges, NULL, NULL);
+		icl_write_buffer(graph->inEdges, CL_TRUE, numMigrationEdges * sizeof(UINT), migrationInEdges, NULL, NULL);
+	}
+	icl_write_buffer(graph->outStart, CL_TRUE, (numPatches + 1) * sizeof(UINT), migrationOutStart, NULL, NULL);
+	icl_write_buffer(graph->inStart, CL_TRUE, (numPatches + 1) * sizeof(UINT), migrationInStart, NULL, NULL);
+
+	// no imports until the first exchange with the other ranks
+	UINT* imports = (UINT*)calloc(numPopulations * MIGRATION_IMPORT_STRIDE, sizeof(UINT));
+	graph->imports = icl_create_buffer(dev, CL_MEM_READ_ONLY, numPopulations * MIGRATION_IMPORT_STRIDE * sizeof(UINT));
+	icl_write_buffer(graph->imports, CL_TRUE, numPopulations * MIGRATION_IMPORT_STRIDE * sizeof(UINT), imports, NULL, NULL);
+	free(imports);
+	graph->inboxCapacity = LOCAL_SIZE;
+	graph->inboxAgents = icl_create_buffer(dev, CL_MEM_READ_ONLY, graph->inboxCapacity * sizeof(struct Agent));
+	graph->inboxAges = icl_create_buffer(dev, CL_MEM_READ_ONLY, graph->inboxCapacity * sizeof(struct AgentAge));
+	graph->inboxStates = icl_create_buffer(dev, CL_MEM_READ_ONLY, graph->inboxCapacity * sizeof(struct AgentState));
+	graph->maxImports = 0;
+
+	return graph;
+}
+
+void releaseMigrationGraph(struct MigrationGraph* graph) {
+	if(!graph)
+		return;
+	icl_release_buffers(6, graph->edges, graph->outStart, graph->inEdges, graph->inStart, graph->popMigration, graph->edgeMigration);
+	icl_release_buffers(4, graph->imports, graph->inboxAgents, graph->inboxAges, graph->inboxStates);
+	free(graph);
+}
+
+/*
+ * sets all ranges of a population to empty ones, with the same spacing as the initial population
+ */
+void emptyPopulation(struct Population* pop) {
+	struct AgentRange empty = {1u, 1u};
+	pop->eggs.start = 0u;
+	pop->eggs.end = 0u;
+	pop->larvae = empty;
+	pop->pupae = empty;
+	pop->immatures = empty;
+	pop->mateSeekings = empty;
+	pop->bmSeekings = empty;
+	pop->bmDigestings = empty;
+	pop->gravids = empty;
+}
+
+/*
+ * sends the adults collected in the halo patches to the ranks owning these patches, and uploads the ones received from other ranks to the inbox. They
+ * are added to their populations by the next compaction, the halo patches are emptied. Called by all ranks at the start of every time step, after
+ * popsH is read from the device
+ */
+void exchangeMigrants(struct MigrationGraph* graph, icl_buffer* agents, icl_buffer* agentAges, icl_buffer* agentStates, icl_buffer* popD,
+		struct Population* popsH, icl_device* dev) {
+	size_t agentSize = sizeof(struct Agent) + sizeof(struct AgentAge) + sizeof(struct AgentState);
+	char** send = (char**)malloc(haloSize * sizeof(char*));
+	UINT* sendSizes = (UINT*)calloc(2 * haloSize, sizeof(UINT));
+	UINT* recvSizes = sendSizes + haloSize;
+
+	for(UINT r = 0; r < numPopulations; ++r) {
+		if(r % numPatches < numLocalPatches)
+			continue;
+		for(UINT s = FIRST_MIGRATING_STATE; s < NUM_STATES; ++s) {
+			struct AgentRange* range = &popsH[2 * r].eggs + s;
+			if(range->end > range->start)
+				sendSizes[haloOwner[r % numPatches]] += sizeof(struct MigrantBlock) + (range->end - range->start) * agentSize;
+		}
+	}
+	for(UINT k = 0; k < haloSize; ++k) {
+		send[k] = (char*)malloc(max(sendSizes[k], 1u));
+		sendSizes[k] = 0;
+	}
+
+	// pack the adults of each halo patch, one block per state
+	bool anyHalo = false;
+	for(UINT r = 0; r < numPopulations; ++r) {
+		if(r % numPatches < numLocalPatches)
+			continue;
+		UINT rank = haloOwner[r % numPatches];
+		for(UINT s = FIRST_MIGRATING_STATE; s < NUM_STATES; ++s) {
+			struct AgentRange* range = &popsH[2 * r].eggs + s;
+			UINT count = range->end - range->start;
+			if(count == 0)
+				continue;
+
+			struct MigrantBlock block = {r / numPatches, globalPatch[r % numPatches], s, count};
+			char* data = send[rank] + sendSizes[rank];
+			memcpy(data, &block, sizeof(struct MigrantBlock));
+			data += sizeof(struct MigrantBlock);
+			size_t first = (size_t)r * replicateCapacity + range->start;
+			icl_read_buffer_offset(agents, CL_FALSE, first * sizeof(struct Agent), count * sizeof(struct Agent), data, NULL, NULL);
+			data += count * sizeof(struct Agent);
+			icl_read_buffer_offset(agentAges, CL_FALSE, first * sizeof(struct AgentAge), count * sizeof(struct AgentAge), data, NULL, NULL);
+			data += count * sizeof(struct AgentAge);
+			icl_read_buffer_offset(agentStates, CL_FALSE, first * sizeof(struct AgentState), count * sizeof(struct AgentState), data, NULL, NULL);
+			sendSizes[rank] += sizeof(struct MigrantBlock) + count * agentSize;
+		}
+		emptyPopulation(&popsH[2 * r]);
+		popsH[2 * r + 1] = popsH[2 * r];
+		anyHalo = true;
+	}
 	clFinish(dev->queue);
-	icl_start_timer(randTimer);
-#endif
+	if(anyHalo)
+		icl_write_buffer(popD, CL_TRUE, sizeof(struct Population) * 2 * numPopulations, popsH, NULL, NULL);
+
+	char* recv = haloExchange(send, sendSizes, recvSizes);
+	UINT recvTotal = 0;
+	for(UINT k = 0; k < haloSize; ++k) {
+		recvTotal += recvSizes[k];
+		free(send[k]);
+	}
+	free(send);
+	free(sendSizes);
+
+	// the imports are grouped by population and state in the inbox, in the order they are received
+	UINT* imports = (UINT*)calloc(numPopulations * MIGRATION_IMPORT_STRIDE, sizeof(UINT));
+	for(char* data = recv; data < recv + recvTotal; ) {
+		struct MigrantBlock* block = (struct MigrantBlock*)data;
+		assert(devicePatch[block->patch] < numLocalPatches && "migrants received for a patch of another rank");
+		imports[(block->replicate * numPatches + devicePatch[block->patch]) * MIGRATION_IMPORT_STRIDE + block->state] += block->count;
+		data += sizeof(struct MigrantBlock) + block->count * agentSize;
+	}
+	UINT total = 0;
+	graph->maxImports = 0;
+	for(UINT r = 0; r < numPopulations; ++r) {
+		UINT populationImports = 0;
+		for(UINT s = 0; s < NUM_STATES; ++s) {
+			imports[r * MIGRATION_IMPORT_STRIDE + NUM_STATES + s] = total;
+			total += imports[r * MIGRATION_IMPORT_STRIDE + s];
+			populationImports += imports[r * MIGRATION_IMPORT_STRIDE + s];
+		}
+		graph->maxImports = max(graph->maxImports, populationImports);
+	}
+
+	if(total > graph->inboxCapacity) {
+		icl_release_buffers(3, graph->inboxAgents, graph->inboxAges, graph->inboxStates);
+		graph->inboxCapacity = max(total, 2 * graph->inboxCapacity);
+		graph->inboxAgents = icl_create_buffer(dev, CL_MEM_READ_ONLY, graph->inboxCapacity * sizeof(struct Agent));
+		graph->inboxAges = icl_create_buffer(dev, CL_MEM_READ_ONLY, graph->inboxCapacity * sizeof(struct AgentAge));
+		graph->inboxStates = icl_create_buffer(dev, CL_MEM_READ_ONLY, graph->inboxCapacity * sizeof(struct AgentState));
+	}
+
+	if(total > 0) {
+		struct Agent* inboxAgents = (struct Agent*)malloc(total * sizeof(struct Agent));
+		struct AgentAge* inboxAges = (struct AgentAge*)malloc(total * sizeof(struct AgentAge));
+		struct AgentState* inboxStates = (struct AgentState*)malloc(total * sizeof(struct AgentState));
+		UINT* next = (UINT*)malloc(numPopulations * NUM_STATES * sizeof(UINT));
+		for(UINT r = 0; r < numPopulations; ++r)
+			for(UINT s = 0; s < NUM_STATES; ++s)
+				next[r * NUM_STATES + s] = imports[r * MIGRATION_IMPORT_STRIDE + NUM_STATES + s];
+
+		for(char* data = recv; data < recv + recvTotal; ) {
+			struct MigrantBlock* block = (struct MigrantBlock*)data;
+			UINT* position = &next[(block->replicate * numPatches + devicePatch[block->patch]) * NUM_STATES + block->state];
+			data += sizeof(struct MigrantBlock);
+			memcpy(&inboxAgents[*position], data, block->count * sizeof(struct Agent));
+			data += block->count * sizeof(struct Agent);
+			memcpy(&inboxAges[*position], data, block->count * sizeof(struct AgentAge));
+			data += block->count * sizeof(struct AgentAge);
+			memcpy(&inboxStates[*position], data, block->count * sizeof(struct AgentState));
+			data += block->count * sizeof(struct AgentState);
+			*position += block->count;
+		}
+
+		icl_write_buffer(graph->inboxAgents, CL_FALSE, total * sizeof(struct Agent), inboxAgents, NULL, NULL);
+		icl_write_buffer(graph->inboxAges, CL_FALSE, total * sizeof(struct AgentAge), inboxAges, NULL, NULL);
+		icl_write_buffer(graph->inboxStates, CL_TRUE, total * sizeof(struct AgentState), inboxStates, NULL, NULL);
+		free(inboxAgents);
+		free(inboxAges);
+		free(inboxStates);
+		free(next);
+	}
+	icl_write_buffer(graph->imports, CL_TRUE, numPopulations * MIGRATION_IMPORT_STRIDE * sizeof(UINT), imports, NULL, NULL);
+	free(imports);
+	free(recv);
+}
+
+/*
+ * reads the interventions of all scenarios for the time steps after the burn-in
+ */
+int readScenarios() {
+	if(numScenarios == 0)
+		return 0;
+
+	if(burnInSteps >= maxSteps) {
+		printf("A burn-in of %d time steps leaves no time step for the scenarios\n", burnInSteps);
+		return -1;
+	}
+
+	UINT tailSteps = maxSteps - burnInSteps;
+	scenarioEnvironments = (struct Environment*)malloc(sizeof(struct Environment) * tailSteps * numScenarios);
+	for(UINT s = 0; s < numScenarios; ++s)
+		if(readEnvironment(scenarioPaths[s], &scenarioEnvironments[s * tailSteps], tailSteps) < 0)
+			return -1;
+
+	return 0;
+}
+
+/*
+ * copies the state of a simulation from one set of buffers to another on the device, without any transfer to the host
+ * @param from the NUM_STATE_BUFFERS buffers holding the state to be copied
+ * @param fromCapacity the capacity of each replicate in the agent buffers of from
+ * @param to the NUM_STATE_BUFFERS buffers the state is copied to
+ * @param toCapacity the capacity of each replicate in the agent buffers of to, at least fromCapacity
+ * @param sizes the size of a single agent for the agent buffers, the size of the buffer for all others
+ */
+void copyState(icl_buffer** from, UINT fromCapacity, icl_buffer** to, UINT toCapacity, size_t* sizes) {
+	for(UINT b = 0; b < NUM_AGENT_BUFFERS; ++b)
+		for(UINT r = 0; r < numPopulations; ++r)
+			icl_copy_buffer_offset(from[b], to[b], r * fromCapacity * sizes[b], r * toCapacity * sizes[b], fromCapacity * sizes[b], NULL, NULL);
+	for(UINT b = NUM_AGENT_BUFFERS; b < NUM_STATE_BUFFERS; ++b)
+		icl_copy_buffer(from[b], to[b], sizes[b], NULL, NULL);
+}
+
+
+/*
+ * writes the key of the counter based random number generator to the device, once per run. The time step counter starts at 0 for the initial population
+ * @param seed the seed of the run
+ */
+void initSeeds(icl_buffer* seedsD, unsigned long long seed) {
+	struct Seeds* seedsH = (struct Seeds*)malloc(nSeeds * sizeof(struct Seeds));
 	for(UINT i = 0; i < nSeeds; ++i) {
-		seedsH[i].z1 = rand();
-		seedsH[i].z2 = rand();
-		seedsH[i].z3 = rand();
-		seedsH[i].z4 = rand();
+		seedsH[i].z1 = (UINT)seed;
+		seedsH[i].z2 = (UINT)(seed >> 32);
+		seedsH[i].z3 = 0;
+		seedsH[i].z4 = i;
 	}
 
 	icl_write_buffer(seedsD, CL_TRUE, nSeeds * sizeof(struct Seeds), seedsH, NULL, NULL);
+	free(seedsH);
+}
+
+/*
+ * advances the time step counter of the random number generator on the device, without any transfer from the host
+ */
+void advanceSeeds(icl_buffer* seedsD, icl_kernel* advance, icl_device* dev) {
+	size_t singleWorkSize = 1;
+#if TIMING
+	clFinish(dev->queue);
+	icl_start_timer(randTimer);
+#endif
+	icl_run_kernel(advance, 1, &singleWorkSize, &singleWorkSize, NULL, NULL, 2,
+			(size_t)0, (void *)seedsD,
+			sizeof(UINT), &nSeeds);
 
 #if TIMING
 	clFinish(dev->queue);
@@ -157,23 +854,23 @@ void generateSeeds(icl_buffer* seedsD, struct Seeds* seedsH, icl_device* dev) {
 #endif
 }
 
-void storeHistogram(icl_buffer* agentAges, icl_buffer* pop, icl_buffer* hist, icl_device* dev) {
-	size_t localWorkSize = LOCAL_SIZE;
-	size_t globalWorkSize = ((maxAgents + LOCAL_SIZE) / LOCAL_SIZE) * LOCAL_SIZE; // one additional thread to write properties in oldToNew agents
+void storeHistogram(icl_buffer* agentAges, icl_buffer* pop, icl_buffer* hist, icl_device* dev, const char* path) {
+	size_t localWorkSize[2] = {LOCAL_SIZE, 1};
+	size_t globalWorkSize[2] = {((replicateCapacity + LOCAL_SIZE) / LOCAL_SIZE) * LOCAL_SIZE, numPopulations};
 	icl_kernel* ageHist = icl_create_kernel(dev, "kernel/ageHistogram.cl", "ageHistogram", kernelBuildArgs, ICL_SOURCE);
 
 	UINT* histogram = (UINT*)calloc(100, sizeof(UINT));
 	// set hist buffer to zero
 	icl_write_buffer(hist, CL_TRUE, 100*sizeof(UINT), histogram, NULL, NULL);
 
-	icl_run_kernel(ageHist, 1, &globalWorkSize, &localWorkSize, NULL, NULL, 3,
+	icl_run_kernel(ageHist, 2, globalWorkSize, localWorkSize, NULL, NULL, 3,
 			(size_t)0, agentAges,
 			(size_t)0, pop,
 			(size_t)0, hist);
 
 	icl_read_buffer(hist, CL_TRUE, 100*sizeof(UINT), histogram, NULL, NULL);
 
-	FILE* hFile = fopen("histogram.txt", "w");
+	FILE* hFile = fopen(path, "w");
 	for(UINT i = 0u; i < 100u; ++i)
 		fprintf(hFile, "%d, ", histogram[i]);
 
@@ -182,20 +879,58 @@ void storeHistogram(icl_buffer* agentAges, icl_buffer* pop, icl_buffer* hist, ic
 	free(histogram);
 }
 
-icl_kernel* createInitialPopulation(icl_buffer* agents, icl_buffer* agentAges, icl_buffer* agentStates, struct Population* pop, icl_buffer* enbD,
-		icl_buffer* seeds, icl_device* dev) {
-	icl_kernel* init = icl_create_kernel(dev, "kernel/initAgents.cl", "initAgents", kernelBuildArgs, ICL_SOURCE);
+struct ForcingTable createForcingTable(icl_device* dev) {
+	struct ForcingTable table;
+	table.environments = icl_create_buffer(dev, CL_MEM_READ_ONLY, numPatches * FORCING_TABLE_ROWS * sizeof(struct Environment));
+	table.temperatures = icl_create_buffer(dev, CL_MEM_READ_ONLY, numPatches * FORCING_TABLE_ROWS * sizeof(Temperature));
+	return table;
+}
+
+void releaseForcingTable(struct ForcingTable* table) {
+	icl_release_buffers(2, table->environments, table->temperatures);
+}
+
+/*
+ * uploads a chunk of the forcing of all patches without waiting. The host arrays remain valid for the whole run
+ * @param env the environment of the first patch at firstStep, followed by the ones of the later time steps. It differs from the patch's forcing in
+ * 			scenarios, which are simulated with a single patch only
+ * @param firstStep the first time step of the phase, which is row 0 of the table
+ * @param chunk index of the chunk within the phase, it is written to the half chunk % 2 of the table
+ * @param lastStep the time step after the last one of the phase, no rows are uploaded for it or later time steps
+ */
+void uploadForcingChunk(struct ForcingTable* table, struct Environment* env, UINT firstStep, UINT chunk, UINT lastStep) {
+	UINT begin = firstStep + chunk * FORCING_CHUNK_STEPS;
+	if(begin >= lastStep)
+		return;
+
+	UINT count = min(lastStep - begin, (UINT)FORCING_CHUNK_STEPS);
+	for(UINT p = 0; p < numPatches; ++p) {
+		UINT row = p * FORCING_TABLE_ROWS + (chunk % 2) * FORCING_CHUNK_STEPS;
+		struct Environment* patchEnv = p == 0 ? env : &patches[p].environment[firstStep];
+		icl_write_buffer_offset(table->environments, CL_FALSE, row * sizeof(struct Environment), count * sizeof(struct Environment),
+				&patchEnv[chunk * FORCING_CHUNK_STEPS], NULL, NULL);
+		icl_write_buffer_offset(table->temperatures, CL_FALSE, row * sizeof(Temperature), count * sizeof(Temperature), &patches[p].temperature[begin],
+				NULL, NULL);
+	}
+}
+
+void createInitialPopulation(icl_buffer* agents, icl_buffer* agentAges, icl_buffer* agentStates, struct Population* pop, icl_buffer* enbD,
+		icl_buffer* seeds, icl_kernel* init, struct ForcingTable* forcing) {
+	assert(initialAgentCount < replicateCapacity && "not enough capacity");
 
-	size_t localSize = LOCAL_SIZE;
+	size_t localSize[2] = {LOCAL_SIZE, 1};
 	// overprovisioning, actual number known only on device
-	size_t globalSize = ((maxAgents + LOCAL_SIZE - 1) / LOCAL_SIZE) * LOCAL_SIZE;
+	size_t globalSize[2] = {((replicateCapacity + LOCAL_SIZE - 1) / LOCAL_SIZE) * LOCAL_SIZE, numPopulations};
 
-	icl_run_kernel(init, 1, &globalSize, &localSize, NULL, initEvent, 6,
+	// the first row of the forcing table holds time step 0
+	UINT row = 0;
+	icl_run_kernel(init, 2, globalSize, localSize, NULL, initEvent, 7,
 			(size_t)0, (void *)agents,
 			(size_t)0, (void *)agentAges,
 			(size_t)0, (void *)agentStates,
 			(size_t)0, (void *)enbD,
-			sizeof(Temperature), &temperature[0],
+			(size_t)0, (void *)forcing->temperatures,
+			sizeof(UINT), &row,
 			(size_t)0, (void *)seeds);
 
 	pop->eggs.start = 0u;
@@ -223,36 +958,36 @@ icl_kernel* createInitialPopulation(icl_buffer* agents, icl_buffer* agentAges, i
 	clWaitForEvents(1, initEvent->event);
 	initTime += icl_profile_event(initEvent, MEASURE_START, ICL_FINISHED, ICL_MILLI);
 #endif
-
-	return init;
 }
 
-struct Stats calcStats(icl_buffer* agentAges, icl_buffer* popD, icl_buffer* buff, icl_device* dev,
+/*
+ * enqueues the statistics kernels and records their result together with the bites and cycles of the last time step at position slot of statsRing
+ */
+void calcStats(icl_buffer* agentAges, icl_buffer* popD, icl_buffer* buff, icl_buffer* bnc, icl_buffer* statsRing, icl_device* dev,
 		icl_kernel* calcL1dePerGroup, icl_kernel* calcL1deTotal,
-		icl_kernel* calcFemalesPerGroup, icl_kernel* calcFemalesTotal,
-		struct Population* popH) {
-	size_t localSize = LOCAL_SIZE;
-	UINT upperBound = max(popH->immatures.end, max(popH->bmSeekings.end, max(popH->bmDigestings.end, popH->gravids.end)));
-	UINT adultsRange = upperBound - popH->immatures.start;
+		icl_kernel* calcFemalesPerGroup, icl_kernel* calcFemalesTotal, icl_kernel* recordStats, UINT slot) {
+	size_t localSize[2] = {LOCAL_SIZE, 1};
+	size_t totalSize[2] = {LOCAL_SIZE, numPopulations};
+	UINT numberOfSlots = LOCAL_SIZE;
 
 #if TIMING
 	clFinish(dev->queue);
 	icl_start_timer(l1deTimer);
 #endif
 
-	size_t globalSize = LOCAL_SIZE * LOCAL_SIZE;
+	size_t globalSize[2] = {LOCAL_SIZE * LOCAL_SIZE, numPopulations};
 
-	icl_run_kernel(calcL1dePerGroup, 1, &globalSize, &localSize, NULL, NULL, 3,
+	icl_run_kernel(calcL1dePerGroup, 2, globalSize, localSize, NULL, NULL, 3,
 			(size_t)0, (void *)agentAges,
 			(size_t)0, (void *)popD,
 			(size_t)0, (void *)buff);
 
 
 	// called always, since it also copies the properties array
-	icl_run_kernel(calcL1deTotal, 1, &localSize, &localSize, NULL, NULL, 3,
+	icl_run_kernel(calcL1deTotal, 2, totalSize, localSize, NULL, NULL, 3,
 			(size_t)0, (void *)popD,
 			(size_t)0, (void *)buff,
-			sizeof(UINT), &localSize);
+			sizeof(UINT), &numberOfSlots);
 
 #if TIMING
 	clFinish(dev->queue);
@@ -261,12 +996,12 @@ struct Stats calcStats(icl_buffer* agentAges, icl_buffer* popD, icl_buffer* buff
 	icl_start_timer(genderTimer);
 #endif
 
-	icl_run_kernel(calcFemalesPerGroup, 1, &globalSize, &localSize, NULL, NULL, 3,
+	icl_run_kernel(calcFemalesPerGroup, 2, globalSize, localSize, NULL, NULL, 3,
 			(size_t)0, (void *)agentAges,
 			(size_t)0, (void *)popD,
 			(size_t)0, (void *)buff);
 
-	icl_run_kernel(calcFemalesTotal, 1, &localSize, &localSize, NULL, NULL, 2,
+	icl_run_kernel(calcFemalesTotal, 2, totalSize, localSize, NULL, NULL, 2,
 			(size_t)0, (void *)popD,
 			(size_t)0, (void *)buff);
 
@@ -277,62 +1012,103 @@ struct Stats calcStats(icl_buffer* agentAges, icl_buffer* popD, icl_buffer* buff
 			(size_t)0, (void *)popD,
 			(size_t)0, (void *)buff);*/
 
-	icl_read_buffer(popD, CL_TRUE, sizeof(struct Population), popH, NULL, NULL);
+	size_t singleSize[2] = {1, 1};
+	size_t recordSize[2] = {1, numPopulations};
+	icl_run_kernel(recordStats, 2, recordSize, singleSize, NULL, NULL, 4,
+			(size_t)0, (void *)popD,
+			(size_t)0, (void *)bnc,
+			(size_t)0, (void *)statsRing,
+			sizeof(UINT), &slot);
 
 #if TIMING
 	clFinish(dev->queue);
 	icl_stop_timer(genderTimer);
 #endif
+}
 
-	struct Stats stats;
-	stats.numEggs = calcNum(popH->eggs);
-	stats.numLarvae = calcNum(popH->larvae);
-	stats.numPupae = calcNum(popH->pupae);
-	stats.numImmature = calcNum(popH->immatures);
-	stats.numMating = calcNum(popH->mateSeekings);
-	stats.numBMS = calcNum(popH->bmSeekings);
-	stats.numBMD = calcNum(popH->bmDigestings);
-	stats.numOVI = calcNum(popH->gravids);
+/*
+ * waits until the records of a batch of time steps are read back from the device, then checks and prints them. The capacity is checked only here, thus
+ * up to stepsPerSync time steps after it has been exceeded
+ * @param records the records of the batch in host memory, numPopulations for each time step
+ * @param num the number of time steps in the batch
+ * @param event event of the read of the records, will be released
+ * @param firstStep the time step of the first record
+ * @param phase 0 for the burn-in or a run without scenarios, s + 1 for scenario s
+ */
+void drainStats(struct StatsRecord* records, UINT num, icl_event* event, UINT firstStep, UINT phase) {
+	clWaitForEvents(1, event->event);
+	icl_release_event(event);
+
+	for(UINT i = 0; i < num * numPopulations; ++i) {
+		struct Stats stats = populationStats(&records[i].pop);
+
+		UINT nAgents = numAgents(&stats);
+		assert(nAgents <= replicateCapacity * 0.95 && "not enough capacity");
 
-	stats.numLarvae1DazEquiv = (stats.numLarvae > 0) ? popH->numLarvae1DayEquiv : 0;
-	stats.numBiomass = stats.numLarvae1DazEquiv + stats.numEggs + stats.numPupae;
+		assert(nAgents > 0 && "No more agents left");
+#if DEBUG
+		reportStats(&stats, &records[i].bnc, i % numPopulations, phase, firstStep + i / numPopulations);
+#endif
+	}
+}
 
-	stats.numFemales = adultsRange > 0 ? popH->numFemale : 0;
-	stats.numPotentiallyInfective = adultsRange > 0 ? popH->numPotentiallyInfective : 0;
-	stats.numMales = (stats.numImmature + stats.numMating + stats.numBMS + stats.numBMD + stats.numOVI) - stats.numFemales;
+/*
+ * tabulates the hourly mortality rates of all populations for the current time step, after the larvae 1 day equivalent is calculated by calcStats
+ */
+void calcMortality(icl_buffer* popD, icl_buffer* mortality, icl_kernel* mortalityTable, struct ForcingTable* forcing, UINT row) {
+	size_t localWorkSize[2] = {LOCAL_SIZE, 1};
+	size_t globalWorkSize[2] = {((MORTALITY_TABLE_SIZE + LOCAL_SIZE - 1) / LOCAL_SIZE) * LOCAL_SIZE, numPopulations};
 
-	UINT nAgents = stats.numEggs + stats.numLarvae + stats.numPupae + stats.numImmature + stats.numMating + stats.numBMS + stats.numBMD + stats.numOVI;
-	assert(nAgents <= maxAgents * 0.95 && "not enough capacity");
+	icl_run_kernel(mortalityTable, 2, globalWorkSize, localWorkSize, NULL, NULL, 4,
+			(size_t)0, (void *)popD,
+			(size_t)0, (void *)forcing->environments,
+			sizeof(UINT), &row,
+			(size_t)0, (void *)mortality);
+}
 
-	assert(nAgents > 0 && "No more agents left");
+/*
+ * writes the spans of the agents of all populations, which the kill, update and compaction kernels map their work-items to. Has to run after the
+ * population of the current time step is final
+ */
+void calcSpans(icl_buffer* popD, icl_buffer* spans, icl_kernel* agentSpans) {
+	size_t localWorkSize[2] = {1, 1};
+	size_t globalWorkSize[2] = {1, numPopulations};
 
-	return stats;
+	icl_run_kernel(agentSpans, 2, globalWorkSize, localWorkSize, NULL, NULL, 2,
+			(size_t)0, (void *)popD,
+			(size_t)0, (void *)spans);
 }
 
-void update(icl_buffer* agents, icl_buffer* agentAges, icl_buffer* agentStates, icl_buffer* enbD, icl_buffer* bnc, icl_buffer* popD, icl_buffer* seeds,
-		icl_kernel* killAgents, icl_kernel* updateAgents, UINT worldTime, struct Stats* stats, struct Population* popH, UINT i) {
+void update(icl_buffer* agents, icl_buffer* agentAges, icl_buffer* agentStates, icl_buffer* enbD, icl_buffer* bnc, icl_buffer* popD, icl_buffer* spans,
+		icl_buffer* seeds, icl_buffer* mortality, icl_kernel* killAgents, icl_kernel* updateAgents, struct ForcingTable* forcing, UINT row, UINT worldTime, UINT numAgents) {
 
-	size_t localWorkSize = LOCAL_SIZE;
-	size_t globalWorkSize = ((popH->gravids.end + LOCAL_SIZE - 1) / LOCAL_SIZE) * LOCAL_SIZE;
+	// each work-item processes workSizes.coarsening agents, at least one work-group resets the counters even if there are no agents
+	UINT workItems = max((numAgents + workSizes.coarsening - 1) / workSizes.coarsening, 1u);
+	UINT groupSize = workSizes.updateGroupSize;
+	size_t localWorkSize[2] = {groupSize, 1};
+	size_t globalWorkSize[2] = {((workItems + groupSize - 1) / groupSize) * groupSize, numPopulations};
 
 	// killing some agents
-	icl_run_kernel(killAgents, 1, &globalWorkSize, &localWorkSize, NULL, killEvent, 7,
+	icl_run_kernel(killAgents, 2, globalWorkSize, localWorkSize, NULL, killEvent, 8,
 			(size_t)0, (void *)agentAges,
 			(size_t)0, (void *)agentStates,
 			(size_t)0, (void *)popD,
+			(size_t)0, (void *)spans,
 			(size_t)0, (void *)enbD,
 			(size_t)0, (void *)bnc,
 			(size_t)0, (void *)seeds,
-			sizeof(REAL), &environment[i].carryingCapacity);
+			(size_t)0, (void *)mortality);
 
 	// update the states of all agents
-	icl_run_kernel(updateAgents, 1, &globalWorkSize, &localWorkSize, NULL, updateEvent, 11,
+	icl_run_kernel(updateAgents, 2, globalWorkSize, localWorkSize, NULL, updateEvent, 13,
 			(size_t)0, (void *)agents,
 			(size_t)0, (void *)agentAges,
 			(size_t)0, (void *)agentStates,
 			(size_t)0, (void *)popD,
-			sizeof(struct Environment), &environment[i],
-			sizeof(Temperature), &temperature[i],
+			(size_t)0, (void *)spans,
+			(size_t)0, (void *)forcing->environments,
+			(size_t)0, (void *)forcing->temperatures,
+			sizeof(UINT), &row,
 			(size_t)0, (void *)bnc,
 			(size_t)0, (void *)enbD,
 			(size_t)0, (void *)seeds,
@@ -340,60 +1116,61 @@ void update(icl_buffer* agents, icl_buffer* agentAges, icl_buffer* agentStates,
 			sizeof(UINT), &worldTime);
 }
 
-void sequentialPrefixScan(icl_buffer* agentStates, icl_buffer* pop, icl_buffer* prefixSum,
-		icl_kernel* serialScan, UINT offset, UINT start, UINT end, INT match) {
-	size_t scanLocalWorkSize = 1;
-	size_t scanGlobalWorkSize = 1;
-
-	icl_run_kernel(serialScan, 1, &scanGlobalWorkSize, &scanLocalWorkSize, NULL, NULL, 7,
-				(size_t)0, (void *)agentStates,
-				(size_t)0, (void *)prefixSum,
-				(size_t)0, (void *)pop,
-				sizeof(UINT), &(offset),
-				sizeof(UINT), &(start),
-				sizeof(UINT), &(end),
-				sizeof(enum State), &match);
-}
+/*
+ * same as update, but kills and updates the agents in a single pass. The counters are reset in advance by a single thread
+ */
+void fusedUpdate(icl_buffer* agents, icl_buffer* agentAges, icl_buffer* agentStates, icl_buffer* enbD, icl_buffer* bnc, icl_buffer* popD,
+		icl_buffer* spans, icl_buffer* seeds, icl_buffer* mortality, icl_kernel* resetUpdateCounters, icl_kernel* killUpdateAgents, struct ForcingTable* forcing, UINT row, UINT worldTime,
+		UINT numAgents) {
+
+	size_t singleWorkSize[2] = {1, 1};
+	size_t resetWorkSize[2] = {1, numPopulations};
+	UINT workItems = max((numAgents + workSizes.coarsening - 1) / workSizes.coarsening, 1u);
+	UINT groupSize = workSizes.updateGroupSize;
+	size_t localWorkSize[2] = {groupSize, 1};
+	size_t globalWorkSize[2] = {((workItems + groupSize - 1) / groupSize) * groupSize, numPopulations};
+
+	// in TIMING mode the kill time only covers the reset of the counters, the fused kernel is counted as update time
+	icl_run_kernel(resetUpdateCounters, 2, resetWorkSize, singleWorkSize, NULL, killEvent, 3,
+			(size_t)0, (void *)popD,
+			(size_t)0, (void *)enbD,
+			(size_t)0, (void *)bnc);
 
-void parallelPrefixScan(icl_buffer* agentStates, icl_buffer* pop, icl_buffer* prefixSum, icl_buffer* flags,
-		icl_kernel* preScan, UINT start, UINT break1, UINT break2, UINT end, INT match) {
-	size_t localWorkSize = LOCAL_SIZE;
-	size_t globalWorkSize = ((end + LOCAL_SIZE) / LOCAL_SIZE) * LOCAL_SIZE;
-	icl_run_kernel(preScan, 1, &globalWorkSize, &localWorkSize, NULL, preScanEvent, 9,
+	icl_run_kernel(killUpdateAgents, 2, globalWorkSize, localWorkSize, NULL, updateEvent, 14,
+			(size_t)0, (void *)agents,
+			(size_t)0, (void *)agentAges,
 			(size_t)0, (void *)agentStates,
-			(size_t)0, (void *)pop,
-			(size_t)0, (void *)prefixSum,
-			(size_t)0, (void *)flags,
-			sizeof(UINT), &(start),
-			sizeof(UINT), &(break1),
-			sizeof(UINT), &(break2),
-			sizeof(UINT), &(end),
-			sizeof(INT), &match);
-
-	scan(prefixSum, flags, end+1-start);
-
-#if TIMING
-	clWaitForEvents(1u, preScanEvent->event);
-	preScanTime += icl_profile_event(preScanEvent, MEASURE_START, ICL_FINISHED, ICL_MILLI);
-#endif
+			(size_t)0, (void *)popD,
+			(size_t)0, (void *)spans,
+			(size_t)0, (void *)forcing->environments,
+			(size_t)0, (void *)forcing->temperatures,
+			sizeof(UINT), &row,
+			(size_t)0, (void *)bnc,
+			(size_t)0, (void *)enbD,
+			(size_t)0, (void *)seeds,
+			sizeof(REAL), &hoursInTimeStep,
+			sizeof(UINT), &worldTime,
+			(size_t)0, (void *)mortality);
 }
 
 void createNewAgents(icl_buffer* agents, icl_buffer* agentAges, icl_buffer* agentStates, icl_buffer* newAgents, icl_buffer* newAgentAges,
-		icl_buffer* newAgentStates, icl_buffer* enbD, icl_buffer* popD,
-		icl_buffer* seeds, icl_buffer* prefixSum1, icl_buffer* prefixSum2, icl_buffer* prefixSum3, icl_buffer* buff,
-		icl_kernel* createEggs, icl_kernel* serialScan, icl_kernel* preScan, icl_kernel* oldToNewAgents, struct Population* popH, icl_device* dev, UINT i) {
+		icl_buffer* newAgentStates, icl_buffer* enbD, icl_buffer* popD, icl_buffer* spans,
+		icl_buffer* seeds, icl_buffer* prefixSum1, icl_buffer* prefixSum2, icl_buffer* prefixSum3,
+		icl_kernel* createEggs, icl_kernel* oldToNewAgents, UINT numAgents, icl_device* dev, struct ForcingTable* forcing, UINT row) {
 	// TODO add check for over limit size
 	assert(1);
 
-	size_t localWorkSize = LOCAL_SIZE;
-	size_t globalWorkSize = ((maxAgents + LOCAL_SIZE) / LOCAL_SIZE) * LOCAL_SIZE; // one additional thread to write properties in oldToNew agents
+	size_t localWorkSize[2] = {LOCAL_SIZE, 1};
+	// one additional thread to write properties in oldToNew agents
+	size_t globalWorkSize[2] = {((replicateCapacity + LOCAL_SIZE) / LOCAL_SIZE) * LOCAL_SIZE, numPopulations};
 
-	icl_run_kernel(createEggs, 1, &globalWorkSize, &localWorkSize, NULL, initEvent, 6,
+	icl_run_kernel(createEggs, 2, globalWorkSize, localWorkSize, NULL, initEvent, 7,
 			(size_t)0, (void *)newAgents,
 			(size_t)0, (void *)newAgentAges,
 			(size_t)0, (void *)newAgentStates,
 			(size_t)0, (void *)enbD,
-			sizeof(Temperature), &temperature[i],
+			(size_t)0, (void *)forcing->temperatures,
+			sizeof(UINT), &row,
 			(size_t)0, (void *)seeds);
 
 #if TIMING
@@ -401,53 +1178,30 @@ void createNewAgents(icl_buffer* agents, icl_buffer* agentAges, icl_buffer* agen
 	icl_start_timer(scanTimer);
 #endif
 
-#if DEVICE_TYPE != ICL_CPU
-#define PARALLEL_SCAN
-//	printf("host   b1 %d, b3 %d, end %d\n", popH->eggs.end, popH->immatures.end, popH->bmDigestings.end);
-	parallelPrefixScan(agentStates, popD, prefixSum1, buff, preScan,
-			0, popH->eggs.end, popH->immatures.end, popH->bmDigestings.end, EGG | IMMATURE | BMD);
-
-	parallelPrefixScan(agentStates, popD, prefixSum2, buff, preScan,
-			0, popH->larvae.end, popH->mateSeekings.end, popH->gravids.end, LARVA | MATESEEKING | GRAVID);
-
-	parallelPrefixScan(agentStates, popD, prefixSum3, buff, preScan,
-			popH->larvae.start, popH->pupae.end, popH->gravids.end, popH->gravids.end, PUPA | BMS);
-
-#else
-	sequentialPrefixScan(agentStates, popD, prefixSum1, serialScan,
-			0, popH->eggs.start, popH->eggs.end, EGG);
-
-	sequentialPrefixScan(agentStates, popD, prefixSum2, serialScan,
-			0, popH->eggs.start, popH->larvae.end, LARVA);
-
-	sequentialPrefixScan(agentStates, popD, prefixSum3, serialScan,
-			popH->larvae.start, popH->larvae.start, popH->pupae.end, PUPA);
-
-	sequentialPrefixScan(agentStates, popD, prefixSum1, serialScan,
-			0, popH->pupae.start, popH->immatures.end, IMMATURE);
+	if(!useChunkScan) {
+		// a single scan for the new positions of the agents of all states, which are copied to the new arrays directly. In TIMING mode the scan
+		// time includes the copying
+		compaction(agents, agentAges, agentStates, newAgents, newAgentAges, newAgentStates, popD, spans, enbD, seeds, numAgents, oldToNewEvent);
 
-	sequentialPrefixScan(agentStates, popD, prefixSum2, serialScan,
-			0, popH->immatures.start, popH->mateSeekings.end, MATESEEKING);
-
-	sequentialPrefixScan(agentStates, popD, prefixSum3, serialScan,
-			popH->larvae.start, popH->mateSeekings.start, popH->gravids.end, BMS);
-
-	sequentialPrefixScan(agentStates, popD, prefixSum1, serialScan,
-			0, popH->bmSeekings.start, popH->bmDigestings.end, BMD);
-
-	sequentialPrefixScan(agentStates, popD, prefixSum2, serialScan,
-			0, popH->bmDigestings.start, popH->gravids.end, GRAVID);
+#if TIMING
+		clFinish(dev->queue);
+		icl_stop_timer(scanTimer);
 #endif
+		return;
+	}
+
+	// scan of all states in parallel chunks, one per core
+	chunk_scan(agentStates, popD, spans, prefixSum1, prefixSum2, prefixSum3);
 
 #if TIMING
 	clFinish(dev->queue);
 	icl_stop_timer(scanTimer);
 #endif
 
-	globalWorkSize = ((popH->gravids.end + LOCAL_SIZE) / LOCAL_SIZE) * LOCAL_SIZE; // one additional thread to write properties in oldToNew agents
+	globalWorkSize[0] = ((numAgents + LOCAL_SIZE) / LOCAL_SIZE) * LOCAL_SIZE; // one additional thread to write properties in oldToNew agents
 
 	// sort agents form old array into new array
-	icl_run_kernel(oldToNewAgents, 1, &globalWorkSize, &localWorkSize, NULL, oldToNewEvent, 11,
+	icl_run_kernel(oldToNewAgents, 2, globalWorkSize, localWorkSize, NULL, oldToNewEvent, 12,
 			(size_t)0, (void *)agents,
 			(size_t)0, (void *)agentAges,
 			(size_t)0, (void *)agentStates,
@@ -458,137 +1212,1013 @@ void createNewAgents(icl_buffer* agents, icl_buffer* agentAges, icl_buffer* agen
 			(size_t)0, (void *)prefixSum2,
 			(size_t)0, (void *)prefixSum3,
 			(size_t)0, (void *)popD,
+			(size_t)0, (void *)spans,
 			(size_t)0, (void *)enbD);
 }
 
-void run(icl_buffer* enbD, icl_buffer* bnc, icl_buffer* agents, icl_buffer* agentAges, icl_buffer* agentStates,
-		icl_buffer* seedsD, struct Population* popH, struct Seeds* seedsH, icl_device* dev, icl_kernel* createEggs) {
-	icl_buffer* newAgents = icl_create_buffer(dev, CL_MEM_READ_WRITE, maxAgents * sizeof(struct Agent));
-	icl_buffer* newAgentAges = icl_create_buffer(dev, CL_MEM_READ_WRITE, maxAgents * sizeof(struct AgentAge));
-	icl_buffer* newAgentStates = icl_create_buffer(dev, CL_MEM_READ_WRITE, maxAgents * sizeof(struct AgentState));
-	icl_buffer* popD = icl_create_buffer(dev, CL_MEM_READ_WRITE, sizeof(struct Population) * 2); // using double buffering
-	icl_buffer* buff = icl_create_buffer(dev, CL_MEM_READ_WRITE, buffSize * sizeof(UINT));
+// kernels of a run. They are rebuilt when the capacity of the replicates grows, since it is passed as build option
+struct Kernels {
+	icl_kernel* createEggs;
+	icl_kernel* calcL1dePerGroup;
+	icl_kernel* calcL1deTotal;
+	icl_kernel* calcFemalesPerGroup;
+	icl_kernel* calcFemalesTotal;
+	icl_kernel* recordStats;
+	icl_kernel* advance;
+	icl_kernel* mortalityTable;
+	icl_kernel* agentSpans;
+	icl_kernel* resetUpdateCounters;
+	icl_kernel* killUpdateAgents;
+	icl_kernel* killAgents;
+	icl_kernel* updateAgents;
+	icl_kernel* oldToNewAgents;
+};
 
-	icl_buffer* prefixSum1 = icl_create_buffer(dev, CL_MEM_READ_WRITE, maxAgents * sizeof(INT));
-	icl_buffer* prefixSum2 = icl_create_buffer(dev, CL_MEM_READ_WRITE, maxAgents * sizeof(INT));
-	icl_buffer* prefixSum3 = icl_create_buffer(dev, CL_MEM_READ_WRITE, maxAgents * sizeof(INT));
+/*
+ * creates all kernels of a run and the buffers of the scan, for the capacity set by setCapacity. Kernels which are not used in this build or on this device are NULL
+ */
+void createKernels(struct Kernels* k, icl_device* dev) {
+	memset(k, 0, sizeof(struct Kernels));
+	k->createEggs = icl_create_kernel(dev, "kernel/initAgents.cl", "initAgents", kernelBuildArgs, ICL_SOURCE);
+	k->calcL1dePerGroup = icl_create_kernel(dev, "kernel/calcL1de.cl", "calcL1dePerGroup", kernelBuildArgs, ICL_SOURCE);
+	k->calcL1deTotal = icl_create_kernel(dev, "kernel/calcL1de.cl", "calcL1deTotal", kernelBuildArgs, ICL_SOURCE);
+	k->calcFemalesPerGroup = icl_create_kernel(dev, "kernel/calcGender.cl", "calcFemalesPerGroup", kernelBuildArgs, ICL_SOURCE);
+	k->calcFemalesTotal = icl_create_kernel(dev, "kernel/calcGender.cl", "calcFemalesTotal", kernelBuildArgs, ICL_SOURCE);
+	k->recordStats = icl_create_kernel(dev, "kernel/recordStats.cl", "recordStats", kernelBuildArgs, ICL_SOURCE);
+	k->advance = icl_create_kernel(dev, "kernel/seeds.cl", "advanceSeeds", kernelBuildArgs, ICL_SOURCE);
+	k->mortalityTable = icl_create_kernel(dev, "kernel/mortalityTable.cl", "mortalityTable", kernelBuildArgs, ICL_SOURCE);
+	k->agentSpans = icl_create_kernel(dev, "kernel/agentSpans.cl", "agentSpans", kernelBuildArgs, ICL_SOURCE);
+//	icl_kernel* ageHistogram = icl_create_kernel(dev, "kernel/ageHistogram.cl", "ageHistogram", KERNEL_BUILD_MACRO, ICL_SOURCE);
+#if FUSED_UPDATE
+	k->resetUpdateCounters = icl_create_kernel(dev, "kernel/updateAgents.cl", "resetUpdateCounters", kernelBuildArgs, ICL_SOURCE);
+	k->killUpdateAgents = icl_create_kernel(dev, "kernel/updateAgents.cl", workSizes.coarsening > 1 ? "killUpdateAgentsCoarse" : "killUpdateAgents",
+			kernelBuildArgs, ICL_SOURCE);
+	workSizes.updateGroupSize = fittingGroupSize(k->killUpdateAgents, workSizes.updateGroupSize);
+#else
+	k->killAgents = icl_create_kernel(dev, "kernel/killAgents.cl", workSizes.coarsening > 1 ? "killAgentsCoarse" : "killAgents", kernelBuildArgs,
+			ICL_SOURCE);
+	k->updateAgents = icl_create_kernel(dev, "kernel/updateAgents.cl", workSizes.coarsening > 1 ? "updateAgentsCoarse" : "updateAgents",
+			kernelBuildArgs, ICL_SOURCE);
+	workSizes.updateGroupSize = fittingGroupSize(k->killAgents, fittingGroupSize(k->updateAgents, workSizes.updateGroupSize));
+#endif
 
-	// write initial population to popD[1]. calcStats will read it from there and copy to popD[0]
-	icl_write_buffer_offset(popD, CL_TRUE, sizeof(struct Population), sizeof(struct Population), popH, NULL, NULL);
+	// create temporary buffers for the compaction
+	if(useChunkScan) {
+		k->oldToNewAgents = icl_create_kernel(dev, "kernel/oldToNewAgents.cl", "oldToNewAgents", kernelBuildArgs, ICL_SOURCE);
+		chunk_scan_init(numPopulations, workSizes.chunksPerComputeUnit, dev, kernelBuildArgs, ICL_SOURCE);
+	} else
+		compaction_init(workSizes.compactionGroupSize, replicateCapacity, numPopulations, migrationGraph, dev, kernelBuildArgs, ICL_SOURCE);
+}
 
-	icl_kernel* calcL1dePerGroup = icl_create_kernel(dev, "kernel/calcL1de.cl", "calcL1dePerGroup", kernelBuildArgs, ICL_SOURCE);
-	icl_kernel* calcL1deTotal = icl_create_kernel(dev, "kernel/calcL1de.cl", "calcL1deTotal", kernelBuildArgs, ICL_SOURCE);
-	icl_kernel* calcFemalesPerGroup = icl_create_kernel(dev, "kernel/calcGender.cl", "calcFemalesPerGroup", kernelBuildArgs, ICL_SOURCE);
-	icl_kernel* calcFemalesTotal = icl_create_kernel(dev, "kernel/calcGender.cl", "calcFemalesTotal", kernelBuildArgs, ICL_SOURCE);
+void releaseKernels(struct Kernels* k) {
+	icl_kernel* all[] = {k->createEggs, k->calcL1dePerGroup, k->calcL1deTotal, k->calcFemalesPerGroup, k->calcFemalesTotal, k->recordStats, k->advance,
+			k->mortalityTable, k->agentSpans, k->resetUpdateCounters, k->killUpdateAgents, k->killAgents, k->updateAgents, k->oldToNewAgents};
+	for(UINT i = 0; i < sizeof(all) / sizeof(all[0]); ++i)
+		if(all[i])
+			icl_release_kernel(all[i]);
 
-//	icl_kernel* ageHistogram = icl_create_kernel(dev, "kernel/ageHistogram.cl", "ageHistogram", KERNEL_BUILD_MACRO, ICL_SOURCE);
-	icl_kernel* killAgents = icl_create_kernel(dev, "kernel/killAgents.cl", "killAgents", kernelBuildArgs, ICL_SOURCE);
-	icl_kernel* updateAgents = icl_create_kernel(dev, "kernel/updateAgents.cl", "updateAgents", kernelBuildArgs, ICL_SOURCE);
-	icl_kernel* oldToNewAgents = icl_create_kernel(dev, "kernel/oldToNewAgents.cl", "oldToNewAgents", kernelBuildArgs, ICL_SOURCE);
+	if(useChunkScan)
+		chunk_scan_release();
+	else
+		compaction_release();
+}
+
+/*
+ * sets the capacity of each replicate and the kernel build options of the calling thread, which depend on it
+ */
+void setCapacity(UINT capacity) {
+	replicateCapacity = capacity;
+	sprintf(kernelBuildArgs, "-I%s -DSPECIES=%s -DREPLICATE_CAPACITY=%d -DNUM_PATCHES=%d -DFORCING_TABLE_ROWS=%d", KENRNEL_INCLUDE_PATH, speciesHeader,
+			replicateCapacity, numPatches, FORCING_TABLE_ROWS);
+	if(migrationPath)
+		strcat(kernelBuildArgs, " -DMIGRATION");
+	if(workSizes.coarsening > 1)
+		sprintf(kernelBuildArgs + strlen(kernelBuildArgs), " -DCOARSENING=%u", workSizes.coarsening);
+	sprintf(kernelBuildArgs + strlen(kernelBuildArgs), " -DRANGE_ALIGNMENT=%u", workSizes.rangeAlignment);
+	if(fastMath)
+		strcat(kernelBuildArgs, " -cl-fast-relaxed-math -DFAST_MATH");
+}
 
-	icl_kernel* serialScan = icl_create_kernel(dev, "kernel/serialScan.cl", "serialScan", kernelBuildArgs, ICL_SOURCE);
-	icl_kernel* preScan =  icl_create_kernel(dev, "kernel/preScan.cl", "preScan", kernelBuildArgs, ICL_SOURCE);
+/*
+ * @return the capacity of each replicate at the start of a run, given with -capacity or derived from the initial population
+ */
+UINT initialCapacity() {
+	UINT capacity = initialReplicateCapacity > 0 ? initialReplicateCapacity : INITIAL_CAPACITY_FACTOR * initialAgentCount;
+	return ((capacity + LOCAL_SIZE - 1) / LOCAL_SIZE) * LOCAL_SIZE;
+}
 
-	// create temporary buffers for prefix scan
-#ifdef PARALLEL_SCAN
-#if LOCAL_SIZE == 1
-#define SCAN_SIZE 1
+/*
+ * @return the largest capacity of each replicate up to requested, as a multiple of the work-group size, for which all agent buffers fit into the memory
+ * still available on the device. The agent buffers with the current capacity are released when growing, the current agents only after they have been
+ * copied
+ */
+UINT fittingCapacity(icl_device* dev, UINT requested, UINT current) {
+	size_t agentBytes = sizeof(struct Agent) + sizeof(struct AgentAge) + sizeof(struct AgentState);
+	// the agents are double buffered, the chunked scan needs three prefix sums per agent
+	size_t scratchBytes = agentBytes;
+	if(useChunkScan)
+		scratchBytes += 3 * sizeof(INT);
+	cl_ulong reserve = (cl_ulong)(dev->mem_size * MEMORY_RESERVE);
+	cl_ulong available = dev->mem_available + (cl_ulong)current * numPopulations * (agentBytes + scratchBytes);
+	// while copying, the current agents and the grown ones are allocated at the same time
+	cl_ulong copyAvailable = dev->mem_available + (cl_ulong)current * numPopulations * scratchBytes;
+	if(available < reserve || copyAvailable < reserve)
+		return current;
+
+	cl_ulong capacity = requested;
+	capacity = min(capacity, (available - reserve) / (numPopulations * (agentBytes + scratchBytes)));
+	capacity = min(capacity, (copyAvailable - reserve) / (numPopulations * agentBytes));
+	capacity = min(capacity, dev->max_buffer_size / (numPopulations * max(max(sizeof(struct Agent), sizeof(struct AgentAge)), sizeof(struct AgentState))));
+
+	return (UINT)((capacity / LOCAL_SIZE) * LOCAL_SIZE);
+}
+
+/*
+ * replaces an agent buffer by one with a larger capacity for each replicate, copying the agents of each replicate to the start of its new part
+ */
+void growBuffer(icl_device* dev, icl_buffer** buffer, size_t agentSize, UINT oldCapacity, UINT newCapacity) {
+	icl_buffer* grown = icl_create_buffer(dev, CL_MEM_READ_WRITE, newCapacity * numPopulations * agentSize);
+	for(UINT r = 0; r < numPopulations; ++r)
+		icl_copy_buffer_offset(*buffer, grown, r * oldCapacity * agentSize, r * newCapacity * agentSize, oldCapacity * agentSize, NULL, NULL);
+	icl_release_buffer(*buffer);
+	*buffer = grown;
+}
+
+/*
+ * doubles the capacity of each replicate at a step boundary, or grows it as far as the memory of the device allows. The current agents are copied on
+ * the device, the double buffers and prefix sums are reallocated without copying and all kernels are rebuilt for the new capacity
+ */
+void growCapacity(icl_device* dev, struct Kernels* kernels, icl_buffer** agents, icl_buffer** agentAges, icl_buffer** agentStates,
+		icl_buffer** newAgents, icl_buffer** newAgentAges, icl_buffer** newAgentStates,
+		icl_buffer** prefixSum1, icl_buffer** prefixSum2, icl_buffer** prefixSum3, UINT currentStep) {
+	UINT oldCapacity = replicateCapacity;
+	UINT newCapacity = fittingCapacity(dev, 2 * oldCapacity, oldCapacity);
+	if(newCapacity <= oldCapacity)
+		return; // the device is full, drainStats stops the run if the agents exceed the capacity
+
+	// releasing the buffers which are not copied first leaves more memory for the copy
+	icl_release_buffers(3, *newAgents, *newAgentAges, *newAgentStates);
+	if(useChunkScan)
+		icl_release_buffers(3, *prefixSum1, *prefixSum2, *prefixSum3);
+
+	growBuffer(dev, agents, sizeof(struct Agent), oldCapacity, newCapacity);
+	growBuffer(dev, agentAges, sizeof(struct AgentAge), oldCapacity, newCapacity);
+	growBuffer(dev, agentStates, sizeof(struct AgentState), oldCapacity, newCapacity);
+
+	*newAgents = icl_create_buffer(dev, CL_MEM_READ_WRITE, newCapacity * numPopulations * sizeof(struct Agent));
+	*newAgentAges = icl_create_buffer(dev, CL_MEM_READ_WRITE, newCapacity * numPopulations * sizeof(struct AgentAge));
+	*newAgentStates = icl_create_buffer(dev, CL_MEM_READ_WRITE, newCapacity * numPopulations * sizeof(struct AgentState));
+	if(useChunkScan) {
+		*prefixSum1 = icl_create_buffer(dev, CL_MEM_READ_WRITE, newCapacity * numPopulations * sizeof(INT));
+		*prefixSum2 = icl_create_buffer(dev, CL_MEM_READ_WRITE, newCapacity * numPopulations * sizeof(INT));
+		*prefixSum3 = icl_create_buffer(dev, CL_MEM_READ_WRITE, newCapacity * numPopulations * sizeof(INT));
+	}
+
+	releaseKernels(kernels);
+	setCapacity(newCapacity);
+	createKernels(kernels, dev);
+
+	fprintf(stderr, "Capacity grown from %d to %d agents per replicate at step %d\n", oldCapacity, newCapacity, currentStep);
+}
+
+// a checkpoint which is written as soon as its reads from the device are finished
+struct CheckpointJob {
+	struct Checkpoint* cp;
+	icl_event* event;
+	const char* path;
+};
+
+void* checkpointWriterThread(void* arg) {
+	struct CheckpointJob* job = (struct CheckpointJob*)arg;
+	clWaitForEvents(1, job->event->event);
+	icl_release_event(job->event);
+
+	writeCheckpoint(job->path, job->cp);
+	releaseCheckpoint(job->cp);
+	free(job);
+
+	return NULL;
+}
+
+/*
+ * waits until the checkpoint written last is complete
+ */
+void finishCheckpoint() {
+	if(checkpointPending)
+		pthread_join(checkpointWriter, NULL);
+	checkpointPending = false;
+}
+
+/*
+ * takes a checkpoint of the state at the start of a time step. Only the living ranges of the agents are read, without waiting for the device. The file
+ * is written by a separate thread once the reads are finished
+ * @param popsH the populations of all replicates, as read from popD at the start of the time step
+ * @param step the time step the checkpoint is taken at, a resumed run starts with it
+ * @param path the checkpoint file, it must remain valid until the checkpoint is finished
+ */
+void saveCheckpoint(icl_buffer* agents, icl_buffer* agentAges, icl_buffer* agentStates, icl_buffer* enbD, icl_buffer* bnc,
+		icl_buffer* seedsD, struct Population* popsH, UINT step, icl_device* dev, const char* path) {
+	// only one checkpoint is written at a time
+	finishCheckpoint();
+
+	struct Checkpoint* cp = createCheckpoint(step, numPopulations, nSeeds, currentRunSeed, popsH);
+
+	UINT offset = 0;
+	for(UINT r = 0; r < numPopulations; ++r)
+		for(UINT s = 0; s < NUM_STATES; ++s) {
+			struct AgentRange* range = checkpointRange(&popsH[2 * r], s);
+			UINT num = range->end - range->start;
+			if(num == 0)
+				continue;
+
+			UINT first = r * replicateCapacity + range->start;
+			icl_read_buffer_offset(agents, CL_FALSE, first * sizeof(struct Agent), num * sizeof(struct Agent), &cp->agents[offset], NULL, NULL);
+			icl_read_buffer_offset(agentAges, CL_FALSE, first * sizeof(struct AgentAge), num * sizeof(struct AgentAge), &cp->agentAges[offset],
+					NULL, NULL);
+			icl_read_buffer_offset(agentStates, CL_FALSE, first * sizeof(struct AgentState), num * sizeof(struct AgentState), &cp->agentStates[offset],
+					NULL, NULL);
+			offset += num;
+		}
+
+	struct CheckpointJob* job = (struct CheckpointJob*)malloc(sizeof(struct CheckpointJob));
+	job->cp = cp;
+	job->path = path;
+	job->event = icl_create_event();
+	icl_read_buffer(enbD, CL_FALSE, numPopulations * sizeof(struct EggsNbiomass), cp->enb, NULL, NULL);
+	icl_read_buffer(bnc, CL_FALSE, numPopulations * sizeof(struct BitesNcycles), cp->bnc, NULL, NULL);
+	// the queue is in order, the last read finishes after all others
+	icl_read_buffer(seedsD, CL_FALSE, nSeeds * sizeof(struct Seeds), cp->seeds, NULL, job->event);
+	clFlush(dev->queue);
+
+	pthread_create(&checkpointWriter, NULL, checkpointWriterThread, job);
+	checkpointPending = true;
+}
+
+/*
+ * writes the state of a checkpoint to the device, the agents of each replicate to their ranges within the capacity of the replicate
+ */
+void restoreCheckpoint(struct Checkpoint* cp, icl_buffer* agents, icl_buffer* agentAges, icl_buffer* agentStates, icl_buffer* enbD, icl_buffer* bnc,
+		icl_buffer* seedsD) {
+	UINT offset = 0;
+	for(UINT r = 0; r < numPopulations; ++r)
+		for(UINT s = 0; s < NUM_STATES; ++s) {
+			struct AgentRange* range = checkpointRange(&cp->pops[2 * r], s);
+			UINT num = range->end - range->start;
+			if(num == 0)
+				continue;
+
+			UINT first = r * replicateCapacity + range->start;
+			icl_write_buffer_offset(agents, CL_FALSE, first * sizeof(struct Agent), num * sizeof(struct Agent), &cp->agents[offset], NULL, NULL);
+			icl_write_buffer_offset(agentAges, CL_FALSE, first * sizeof(struct AgentAge), num * sizeof(struct AgentAge), &cp->agentAges[offset],
+					NULL, NULL);
+			icl_write_buffer_offset(agentStates, CL_FALSE, first * sizeof(struct AgentState), num * sizeof(struct AgentState), &cp->agentStates[offset],
+					NULL, NULL);
+			offset += num;
+		}
+
+	icl_write_buffer(enbD, CL_FALSE, numPopulations * sizeof(struct EggsNbiomass), cp->enb, NULL, NULL);
+	icl_write_buffer(bnc, CL_FALSE, numPopulations * sizeof(struct BitesNcycles), cp->bnc, NULL, NULL);
+	// the queue is in order, all writes are finished after the last, blocking one
+	icl_write_buffer(seedsD, CL_TRUE, nSeeds * sizeof(struct Seeds), cp->seeds, NULL, NULL);
+}
+
+void run(icl_buffer* enbD, icl_buffer* bnc, icl_buffer* agents, icl_buffer* agentAges, icl_buffer* agentStates,
+		icl_buffer* seedsD, struct Population* popsH, UINT startStep, icl_device* dev, struct Kernels* kernels, struct ForcingTable* forcing,
+		const char* histogramPath, const char* checkpointFile) {
+	icl_buffer* newAgents = icl_create_buffer(dev, CL_MEM_READ_WRITE, replicateCapacity * numPopulations * sizeof(struct Agent));
+	icl_buffer* newAgentAges = icl_create_buffer(dev, CL_MEM_READ_WRITE, replicateCapacity * numPopulations * sizeof(struct AgentAge));
+	icl_buffer* newAgentStates = icl_create_buffer(dev, CL_MEM_READ_WRITE, replicateCapacity * numPopulations * sizeof(struct AgentState));
+	// the populations of all replicates are passed as constant memory
+	assert(sizeof(struct Population) * 2 * numPopulations <= dev->max_constant_buffer_size && "too many replicates");
+	icl_buffer* popD = icl_create_buffer(dev, CL_MEM_READ_WRITE, sizeof(struct Population) * 2 * numPopulations); // using double buffering
+	// partial sums of the statistics kernels, or the age histogram
+	icl_buffer* buff = icl_create_buffer(dev, CL_MEM_READ_WRITE, max(2 * LOCAL_SIZE * numPopulations, 100u) * sizeof(UINT));
+	// hourly mortality rates of all populations in the current time step
+	icl_buffer* mortality = icl_create_buffer(dev, CL_MEM_READ_WRITE, numPopulations * MORTALITY_TABLE_SIZE * sizeof(REAL));
+	// spans of the agents of all populations in the current time step
+	icl_buffer* spans = icl_create_buffer(dev, CL_MEM_READ_WRITE, numPopulations * sizeof(struct AgentSpans));
+
+	// the prefix sums are only needed by oldToNewAgents
+	icl_buffer* prefixSum1 = NULL;
+	icl_buffer* prefixSum2 = NULL;
+	icl_buffer* prefixSum3 = NULL;
+	if(useChunkScan) {
+		prefixSum1 = icl_create_buffer(dev, CL_MEM_READ_WRITE, replicateCapacity * numPopulations * sizeof(INT));
+		prefixSum2 = icl_create_buffer(dev, CL_MEM_READ_WRITE, replicateCapacity * numPopulations * sizeof(INT));
+		prefixSum3 = icl_create_buffer(dev, CL_MEM_READ_WRITE, replicateCapacity * numPopulations * sizeof(INT));
+	}
+
+	// the population of each replicate is read from popD[1] by calcStats and copied to popD[0]
+	icl_write_buffer(popD, CL_TRUE, sizeof(struct Population) * 2 * numPopulations, popsH, NULL, NULL);
+
+	// ring buffer of the statistics of one batch on the device, and STATS_SLOTS batches of pinned host memory it is read to
+	UINT batchRecords = stepsPerSync * numPopulations;
+	icl_buffer* statsRing = icl_create_buffer(dev, CL_MEM_READ_WRITE, batchRecords * sizeof(struct StatsRecord));
+	icl_buffer* statsPinned = icl_create_buffer(dev, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, STATS_SLOTS * batchRecords * sizeof(struct StatsRecord));
+	struct StatsRecord* records = (struct StatsRecord*)icl_map_buffer(statsPinned, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE,
+			STATS_SLOTS * batchRecords * sizeof(struct StatsRecord), NULL, NULL);
+	icl_event* recordEvents[STATS_SLOTS];
+
+	// copy of the state after the burn-in, only needed if scenarios are forked from it. It is allocated at the fork, with the capacity at that time
+	size_t stateSizes[NUM_STATE_BUFFERS] = {sizeof(struct Agent), sizeof(struct AgentAge), sizeof(struct AgentState),
+			sizeof(struct Population) * 2 * numPopulations, numPopulations * sizeof(struct EggsNbiomass), numPopulations * sizeof(struct BitesNcycles),
+			nSeeds * sizeof(struct Seeds)};
+	icl_buffer* forkState[NUM_STATE_BUFFERS];
+	UINT forkCapacity = 0;
+
+	// without scenarios a single phase covers the whole run, otherwise the burn-in is followed by one phase per scenario
+	UINT numPhases = numScenarios > 0 ? numScenarios + 1 : 1;
+	for(UINT phase = 0; phase < numPhases; ++phase) {
+		UINT firstStep = phase == 0 ? startStep : burnInSteps;
+		UINT lastStep = (phase == 0 && numScenarios > 0) ? burnInSteps : maxSteps;
+		// the environment of firstStep, a scenario file holds the time steps after the burn-in only
+		struct Environment* env = phase == 0 ? &environment[firstStep] : &scenarioEnvironments[(phase - 1) * (maxSteps - burnInSteps)];
+		if(phase > 0) {
+			// all scenarios start from the same state, including the position of the random number generator
+			fprintf(output(), "Scenario %d\n", phase - 1);
+			icl_buffer* state[NUM_STATE_BUFFERS] = {agents, agentAges, agentStates, popD, enbD, bnc, seedsD};
+			copyState(forkState, forkCapacity, state, replicateCapacity, stateSizes);
+		}
+
+		// the first two chunks of the phase's forcing, the kernels of the previous phase are finished before they are overwritten
+		uploadForcingChunk(forcing, env, firstStep, 0, lastStep);
+		uploadForcingChunk(forcing, env, firstStep, 1, lastStep);
+
+		UINT batch = 0;
+		UINT nextCheckpoint = firstStep + checkpointInterval;
+		for(UINT currentStep = firstStep; currentStep < lastStep; ++currentStep) {
+			UINT slot = (currentStep - firstStep) % stepsPerSync;
+			UINT row = (currentStep - firstStep) % FORCING_TABLE_ROWS;
+			// at the start of a chunk the next one is uploaded into the half of the table used by the previous chunk
+			if(currentStep > firstStep && row % FORCING_CHUNK_STEPS == 0)
+				uploadForcingChunk(forcing, env, firstStep, (currentStep - firstStep) / FORCING_CHUNK_STEPS + 1, lastStep);
+			calcStats(agentAges, popD, buff, bnc, statsRing, dev, kernels->calcL1dePerGroup, kernels->calcL1deTotal, kernels->calcFemalesPerGroup,
+					kernels->calcFemalesTotal, kernels->recordStats, slot);
+
+			UINT numAgents;
+			if(slot == 0) {
+				// the only point where the host waits for the device. All replicates are launched with the work size of the one with the most
+				// agents in its ranges, the gaps between the ranges get no work-items
+				icl_read_buffer(popD, CL_TRUE, sizeof(struct Population) * 2 * numPopulations, popsH, NULL, NULL);
+				UINT end = 0;
+				numAgents = 0;
+				for(UINT r = 0; r < numPopulations; ++r) {
+					end = max(end, popsH[2 * r].gravids.end);
+					numAgents = max(numAgents, numRangeAgents(&popsH[2 * r]));
+				}
+
+				// the kernels and buffers of the steps already enqueued are kept by the OpenCL runtime until these steps are finished
+				if(end > replicateCapacity * GROWTH_THRESHOLD)
+					growCapacity(dev, kernels, &agents, &agentAges, &agentStates, &newAgents, &newAgentAges, &newAgentStates,
+							&prefixSum1, &prefixSum2, &prefixSum3, currentStep);
+
+				// migrants to the patches of other ranks leave with the populations as read, the ones received join at the next compaction
+				if(haloSize > 1 && migrationGraph)
+					exchangeMigrants(migrationGraph, agents, agentAges, agentStates, popD, popsH, dev);
+
+				if(checkpointInterval > 0 && currentStep >= nextCheckpoint) {
+					saveCheckpoint(agents, agentAges, agentStates, enbD, bnc, seedsD, popsH, currentStep, dev, checkpointFile);
+					nextCheckpoint = currentStep + checkpointInterval;
+				}
+			} else {
+				// the populations on the device are unknown, but no replicate holds more agents than its capacity. The kernels map the work-items
+				// beyond the agents of their population to none
+				numAgents = replicateCapacity - 1;
+			}
+
+			// next time step of the random number generator
+			advanceSeeds(seedsD, kernels->advance, dev);
+			calcMortality(popD, mortality, kernels->mortalityTable, forcing, row);
+			calcSpans(popD, spans, kernels->agentSpans);
+
+#if FUSED_UPDATE
+			fusedUpdate(agents, agentAges, agentStates, enbD, bnc, popD, spans, seedsD, mortality, kernels->resetUpdateCounters, kernels->killUpdateAgents,
+					forcing, row, (UINT)(currentStep * hoursInTimeStep)%24u, numAgents);
 #else
-#define SCAN_SIZE LOCAL_SIZE*2
+			update(agents, agentAges, agentStates, enbD, bnc, popD, spans, seedsD, mortality, kernels->killAgents, kernels->updateAgents,
+					forcing, row, (UINT)(currentStep * hoursInTimeStep)%24u, numAgents);
 #endif
-	segmented_scan_init(SCAN_SIZE, maxAgents, dev, kernelBuildArgs, ICL_SOURCE);
+			if(tuning) {
+				clFinish(dev->queue);
+				tunedUpdateTime += icl_profile_event(killEvent, MEASURE_START, ICL_FINISHED, ICL_MILLI) +
+						icl_profile_event(updateEvent, MEASURE_START, ICL_FINISHED, ICL_MILLI);
+				icl_start_timer(tunedScanTimer);
+			}
+
+			createNewAgents(agents, agentAges, agentStates, newAgents, newAgentAges, newAgentStates, enbD, popD, spans, seedsD,
+					prefixSum1, prefixSum2, prefixSum3, kernels->createEggs, kernels->oldToNewAgents, numAgents, dev, forcing, row);
+			if(tuning) {
+				clFinish(dev->queue);
+				icl_stop_timer(tunedScanTimer);
+			}
+
+			swap(&agents, &newAgents);
+			swap(&agentAges, &newAgentAges);
+			swap(&agentStates, &newAgentStates);
+#if TIMING
+			clFinish(dev->queue);
+			initTime += icl_profile_event(initEvent, MEASURE_START, ICL_FINISHED, ICL_MILLI);
+			killTime += icl_profile_event(killEvent, MEASURE_START, ICL_FINISHED, ICL_MILLI);
+			updateTime += icl_profile_event(updateEvent, MEASURE_START, ICL_FINISHED, ICL_MILLI);
+			oldToNewTime += icl_profile_event(oldToNewEvent, MEASURE_START, ICL_FINISHED, ICL_MILLI);
 #endif
 
-	for(UINT currentStep = 0; currentStep < maxSteps; ++currentStep) {
-		struct Stats stats = calcStats(agentAges, popD, buff, dev, calcL1dePerGroup, calcL1deTotal, calcFemalesPerGroup, calcFemalesTotal, popH);
-#if DEBUG
-		struct BitesNcycles bncH;
-		icl_read_buffer(bnc, CL_TRUE, sizeof(struct BitesNcycles), &bncH, NULL, NULL);
-		printStats(&stats, &bncH, currentStep);
-#endif
+			if(slot == stepsPerSync - 1 || currentStep == lastStep - 1) {
+				// read the records of this batch without waiting, then check and print the ones of the previous batch while the device is busy
+				UINT half = batch % STATS_SLOTS;
+				recordEvents[half] = icl_create_event();
+				icl_read_buffer(statsRing, CL_FALSE, (slot + 1) * numPopulations * sizeof(struct StatsRecord), &records[half * batchRecords], NULL,
+						recordEvents[half]);
+				clFlush(dev->queue);
+
+				if(batch > 0) {
+					UINT prev = (batch - 1) % STATS_SLOTS;
+					drainStats(&records[prev * batchRecords], stepsPerSync, recordEvents[prev], firstStep + (batch - 1) * stepsPerSync, phase);
+				}
+				++batch;
+			}
+		}
+		if(batch > 0) {
+			UINT last = (batch - 1) % STATS_SLOTS;
+			drainStats(&records[last * batchRecords], lastStep - firstStep - (batch - 1) * stepsPerSync, recordEvents[last],
+					firstStep + (batch - 1) * stepsPerSync, phase);
+		}
 
-		// generate random seedsD and copy them to device
-		generateSeeds(seedsD, seedsH, dev);
+		if(phase == 0 && numScenarios > 0) {
+			forkCapacity = replicateCapacity;
+			for(UINT b = 0; b < NUM_STATE_BUFFERS; ++b)
+				forkState[b] = icl_create_buffer(dev, CL_MEM_READ_WRITE, stateSizes[b] * (b < NUM_AGENT_BUFFERS ? forkCapacity * numPopulations : 1));
+			icl_buffer* state[NUM_STATE_BUFFERS] = {agents, agentAges, agentStates, popD, enbD, bnc, seedsD};
+			copyState(state, replicateCapacity, forkState, forkCapacity, stateSizes);
+			continue;
+		}
+		icl_read_buffer(popD, CL_TRUE, sizeof(struct Population) * 2 * numPopulations, popsH, NULL, NULL);
+		for(UINT r = 0; r < numPopulations; ++r) {
+			if(r % numPatches >= numLocalPatches)
+				continue;
+			if(numReplicates > 1)
+				fprintf(output(), "Replicate %d\n", r / numPatches);
+			if(numGlobalPatches > 1)
+				fprintf(output(), "Patch %d\n", globalPatch[r % numPatches]);
+			printPopulation(&popsH[2 * r + 1]);
+		}
+	}
+	icl_unmap_buffer(statsPinned, records, NULL, NULL);
+	finishCheckpoint();
+	if(numScenarios > 0)
+		for(UINT b = 0; b < NUM_STATE_BUFFERS; ++b)
+			icl_release_buffer(forkState[b]);
 
-		update(agents, agentAges, agentStates, enbD, bnc, popD, seedsD, killAgents, updateAgents,
-				(UINT)(currentStep * hoursInTimeStep)%24u, &stats, popH, currentStep);
+	if(!tuning)
+		storeHistogram(agentAges, popD, buff, dev, histogramPath);
 
-		createNewAgents(agents, agentAges, agentStates, newAgents, newAgentAges, newAgentStates, enbD, popD, seedsD,
-				prefixSum1, prefixSum2, prefixSum3, buff, createEggs, serialScan, preScan, oldToNewAgents, popH, dev, currentStep);
+	icl_release_buffers(4, statsRing, statsPinned, mortality, spans);
+	icl_release_buffers(6, newAgents, newAgentAges, newAgentStates, popD, buff, seedsD);
+	if(useChunkScan)
+		icl_release_buffers(3, prefixSum1, prefixSum2, prefixSum3);
+
+	icl_release_buffers(5, enbD, bnc, agents, agentAges, agentStates);
+}
+
+/*
+ * simulates one run of the ensemble on a device, writing all results to the output of the calling thread
+ * @param dev the device, used by the calling thread only
+ * @param runIndex index of the run in the ensemble, the seed of the run is runSeed + runIndex
+ */
+void simulateOnDevice(icl_device* dev, UINT runIndex) {
+	initEvent = icl_create_event();
+	killEvent = icl_create_event();
+	updateEvent = icl_create_event();
+	oldToNewEvent = icl_create_event();
 
-		swap(&agents, &newAgents);
-		swap(&agentAges, &newAgentAges);
-		swap(&agentStates, &newAgentStates);
 #if TIMING
-		clFinish(dev->queue);
-		initTime += icl_profile_event(initEvent, MEASURE_START, ICL_FINISHED, ICL_MILLI);
-		killTime += icl_profile_event(killEvent, MEASURE_START, ICL_FINISHED, ICL_MILLI);
-		updateTime += icl_profile_event(updateEvent, MEASURE_START, ICL_FINISHED, ICL_MILLI);
-		oldToNewTime += icl_profile_event(oldToNewEvent, MEASURE_START, ICL_FINISHED, ICL_MILLI);
+	initTime = 0.0;
+	l1deTimer = icl_init_timer(ICL_MILLI);
+	genderTimer = icl_init_timer(ICL_MILLI);
+	randTimer = icl_init_timer(ICL_MILLI);
+	killTime = 0.0;
+	updateTime = 0.0;
+	scanTimer = icl_init_timer(ICL_MILLI);
+	oldToNewTime = 0.0;
 #endif
+
+	icl_timer* runTime = icl_init_timer(ICL_MILLI);
+	icl_start_timer(runTime);
+
+	// a resumed run continues from its own checkpoint
+	char checkpointFile[512];
+	struct Checkpoint* cp = NULL;
+	currentRunSeed = runSeed + runIndex;
+	if(resumePath) {
+		if(numRuns > 1)
+			sprintf(checkpointFile, "%s.%d", resumePath, runIndex);
+		else
+			sprintf(checkpointFile, "%s", resumePath);
+		cp = readCheckpoint(checkpointFile);
+		assert(cp && "cannot read the checkpoint");
+		assert(cp->header.numReplicates == numPopulations && cp->header.nSeeds == nSeeds && "checkpoint of a different number of replicates");
+		currentRunSeed = cp->header.runSeed;
+		fprintf(output(), "Resuming at step %d\n", cp->header.step);
+	}
+	if(checkpointPath) {
+		if(numRuns > 1)
+			sprintf(checkpointFile, "%s.%d", checkpointPath, runIndex);
+		else
+			sprintf(checkpointFile, "%s", checkpointPath);
+	}
+
+	// the capacity is limited by the memory of the device, nothing is allocated on it yet. A resumed run needs room for the agents of the checkpoint
+	UINT requestedCapacity = initialCapacity();
+	if(cp) {
+		for(UINT r = 0; r < numPopulations; ++r)
+			requestedCapacity = max(requestedCapacity, (UINT)(cp->pops[2 * r].gravids.end / GROWTH_THRESHOLD) + 1);
+	}
+	setCapacity(fittingCapacity(dev, requestedCapacity, 0));
+	migrationGraph = createMigrationGraph(dev);
+	struct Kernels kernels;
+	createKernels(&kernels, dev);
+
+	// seeds for random number generation
+	icl_buffer* seedsD = icl_create_buffer(dev, CL_MEM_READ_WRITE, nSeeds * sizeof(struct Seeds));
+
+	//create initial population
+	// populations of all replicates, the one of replicate r is read from position 2 * r + 1 at the first time step
+	struct Population* popsH = (struct Population*)malloc(sizeof(struct Population) * 2 * numPopulations);
+	icl_buffer* enbD = icl_create_buffer(dev, CL_MEM_READ_WRITE, numPopulations * sizeof(struct EggsNbiomass));
+	icl_buffer* bnc = icl_create_buffer(dev, CL_MEM_READ_WRITE, numPopulations * sizeof(struct BitesNcycles));
+	icl_buffer* agents = icl_create_buffer(dev, CL_MEM_READ_WRITE, replicateCapacity * numPopulations * sizeof(struct Agent));
+	icl_buffer* agentAges = icl_create_buffer(dev, CL_MEM_READ_WRITE, replicateCapacity * numPopulations * sizeof(struct AgentAge));
+	icl_buffer* agentStates = icl_create_buffer(dev, CL_MEM_READ_WRITE, replicateCapacity * numPopulations * sizeof(struct AgentState));
+
+	struct EggsNbiomass* enbH = (struct EggsNbiomass*)malloc(numPopulations * sizeof(struct EggsNbiomass));
+	struct BitesNcycles* bncH = (struct BitesNcycles*)malloc(numPopulations * sizeof(struct BitesNcycles));
+	for(UINT r = 0; r < numPopulations; ++r) {
+		// number of initial eggs in environment
+		// halo patches start empty, they only collect migrants
+		bool halo = r % numPatches >= numLocalPatches;
+		enbH[r].newEggs = halo ? 0 : initialAgentCount;
+		enbH[r].totalBiomass = halo ? 0 : initialAgentCount;
+
+		bncH[r].numCyclesReported = 0;
+		bncH[r].sumCyclesReported = 0;
+		bncH[r].numBitesReported = 0;
+		bncH[r].numInfectBitesReported = 0;
+	}
+	icl_write_buffer(bnc, CL_TRUE, numPopulations * sizeof(struct BitesNcycles), bncH, NULL, NULL);
+	icl_write_buffer(enbD, CL_TRUE, numPopulations * sizeof(struct EggsNbiomass), enbH, NULL, NULL);
+	free(enbH);
+	free(bncH);
+
+	// forcing table on the device, the initial population needs the temperature of time step 0
+	struct ForcingTable forcing = createForcingTable(dev);
+
+	UINT startStep = 0;
+	if(cp) {
+		for(UINT r = 0; r < numPopulations; ++r)
+			assert(cp->pops[2 * r].gravids.end < replicateCapacity && "not enough capacity for the checkpoint");
+		restoreCheckpoint(cp, agents, agentAges, agentStates, enbD, bnc, seedsD);
+		memcpy(popsH, cp->pops, sizeof(struct Population) * 2 * numPopulations);
+		startStep = cp->header.step;
+		releaseCheckpoint(cp);
+	} else {
+		// every rank has its own stream of random numbers
+		initSeeds(seedsD, runSeed + runIndex + haloRank * numRuns);
+		struct Population population;
+		uploadForcingChunk(&forcing, environment, 0, 0, maxSteps);
+		createInitialPopulation(agents, agentAges, agentStates, &population, enbD, seedsD, kernels.createEggs, &forcing);
+		for(UINT r = 0; r < numPopulations; ++r)
+			if(r % numPatches < numLocalPatches)
+				popsH[2 * r + 1] = population;
+			else
+				emptyPopulation(&popsH[2 * r + 1]);
 	}
-	icl_read_buffer_offset(popD, CL_TRUE, sizeof(struct Population), sizeof(struct Population), popH, NULL, NULL);
-	printPopulation(popH);
 
+	// each run of an ensemble writes its own histogram
+	char histogramPath[64];
+	if(numRuns > 1)
+		sprintf(histogramPath, "histogram%d.txt", runIndex);
+	else
+		sprintf(histogramPath, "histogram.txt");
+	if(haloSize > 1)
+		sprintf(histogramPath + strlen(histogramPath), ".rank%d", haloRank);
+
+	if(statsPath) {
+		char statsFile[512];
+		if(numRuns > 1)
+			sprintf(statsFile, "%s.%d", statsPath, runIndex);
+		else
+			sprintf(statsFile, "%s", statsPath);
+		// each rank writes the statistics of its own patches
+		if(haloSize > 1)
+			sprintf(statsFile + strlen(statsFile), ".rank%d", haloRank);
+		statsWriter = openStatsWriter(statsFile);
+	}
+
+	run(enbD, bnc, agents, agentAges, agentStates, seedsD, popsH, startStep, dev, &kernels, &forcing, histogramPath, checkpointFile);
+
+	if(statsWriter)
+		closeStatsWriter(statsWriter);
+	statsWriter = NULL;
+	free(popsH);
+
+	clFinish(dev->queue);
+	releaseForcingTable(&forcing);
+
+	clFinish(dev->queue);
+	releaseKernels(&kernels);
+	releaseMigrationGraph(migrationGraph);
+	migrationGraph = NULL;
+
+	icl_stop_timer(runTime);
+	icl_release_events(4, initEvent, killEvent, updateEvent, oldToNewEvent);
 #if TIMING
-	printf(" preScan\t\t%f\n", preScanTime);
+	fprintf(output(), "init\t\t%lf\nl1de\t\t%lf\ngender\t\t%lf\nrand\t\t%lf\nkill\t\t%lf\nupdate\t\t%lf\nscan\t\t%lf\noldToNew\t%lf\n",
+			initTime, l1deTimer->current_time, genderTimer->current_time, randTimer->current_time,
+			killTime, updateTime, scanTimer->current_time, oldToNewTime);
+
+	icl_release_timer(l1deTimer);
+	icl_release_timer(genderTimer);
+	icl_release_timer(randTimer);
+	icl_release_timer(scanTimer);
 #endif
+	if(numRuns > 1)
+		fprintf(output(), "Run time: %f ms\n", runTime->current_time);
+	icl_release_timer(runTime);
+}
 
-#ifdef PARALLEL_SCAN
-	segmented_scan_release();
-#endif
+/*
+ * sets the work sizes of the calling thread to the ones of dev, read from its profile if it has one. -coarsening and -alignment override the profile
+ * @param verbose print the work sizes and where they are from
+ */
+void selectWorkSizes(icl_device* dev, bool verbose) {
+	useChunkScan = (dev->type & CL_DEVICE_TYPE_CPU) != 0;
+	workSizes = defaultWorkSizes(dev);
+	bool profiled = loadWorkSizes(dev, &workSizes) == 0;
+	if(coarsening > 0)
+		workSizes.coarsening = coarsening;
+	if(rangeAlignment > 0)
+		workSizes.rangeAlignment = rangeAlignment;
+	workSizes.rangeAlignment = max(workSizes.rangeAlignment, 1u);
+	if(!verbose)
+		return;
+
+	char scanSizes[64];
+	if(useChunkScan)
+		sprintf(scanSizes, "%u chunks per compute unit", workSizes.chunksPerComputeUnit);
+	else
+		sprintf(scanSizes, "compaction work-groups of %u", workSizes.compactionGroupSize);
+	printf("%s: update work-groups of %u, %u agents per work-item, %s, ranges aligned to %u agents (%s)\n", dev->name, workSizes.updateGroupSize,
+			workSizes.coarsening, scanSizes, workSizes.rangeAlignment, profiled ? "profile" : "defaults");
+}
 
-	storeHistogram(agentAges, popD, buff, dev);
+/*
+ * simulates the first time steps with each candidate of a work size and keeps the fastest one
+ * @param size the work size in workSizes, set to the fastest candidate
+ * @param scanStage measure the creation of the new agents' arrays instead of the update kernels
+ */
+void tuneWorkSize(icl_device* dev, UINT* size, const UINT* candidates, UINT numCandidates, const char* name, bool scanStage) {
+	UINT best = *size;
+	double bestTime = -1.0;
+	for(UINT c = 0; c < numCandidates; ++c) {
+		*size = candidates[c];
+		double time = -1.0;
+		for(UINT r = 0; r < AUTOTUNE_REPEATS; ++r) {
+			tunedUpdateTime = 0.0;
+			tunedScanTimer = icl_init_timer(ICL_MILLI);
+			simulateOnDevice(dev, 0);
+			double stageTime = scanStage ? tunedScanTimer->current_time : tunedUpdateTime;
+			icl_release_timer(tunedScanTimer);
+			if(time < 0.0 || stageTime < time)
+				time = stageTime;
+		}
+		printf("\t%-22s %6u %12.3f ms\n", name, candidates[c], time);
+		if(bestTime < 0.0 || time < bestTime) {
+			bestTime = time;
+			best = candidates[c];
+		}
+	}
+	*size = best;
+}
 
-	icl_release_kernel(calcL1dePerGroup);
-	icl_release_kernel(calcL1deTotal);
-	icl_release_kernel(calcFemalesPerGroup);
-	icl_release_kernel(calcFemalesTotal);
-	icl_release_kernel(killAgents);
-	icl_release_kernel(updateAgents);
-	icl_release_kernel(createEggs);
-	icl_release_kernel(oldToNewAgents);
-	icl_release_buffers(5, newAgents, newAgentAges, newAgentStates, popD, buff, seedsD);
-	icl_release_buffers(3, prefixSum1, prefixSum2, prefixSum3);
+/*
+ * benchmarks the candidate work sizes on dev and stores the fastest ones in its profile. The work sizes are tuned one after another, starting
+ * from its current profile or the defaults, each candidate simulating the first AUTOTUNE_STEPS time steps of a run
+ */
+void tuneDevice(icl_device* dev) {
+	// candidates of each work size, the ones the device does not support are skipped
+	static const UINT groupSizes[] = {16, 32, 64, 128, 256, 512};
+	static const UINT coarsenings[] = {1, 2, 4, 8, 16, 32};
+	static const UINT chunks[] = {1, 2, 4, 8, 16};
+	UINT numGroupSizes = 0;
+	while(numGroupSizes < sizeof(groupSizes) / sizeof(groupSizes[0]) && groupSizes[numGroupSizes] <= dev->max_work_group_size)
+		++numGroupSizes;
+
+	// the tuning runs write neither statistics, checkpoints nor a histogram, do not fork scenarios and their output is discarded
+	long long runSteps = maxSteps;
+	UINT runScenarios = numScenarios;
+	UINT runCheckpointInterval = checkpointInterval;
+	const char* runResumePath = resumePath;
+	const char* runStatsPath = statsPath;
+	maxSteps = min(maxSteps, (long long)AUTOTUNE_STEPS);
+	numScenarios = 0;
+	checkpointInterval = 0;
+	resumePath = NULL;
+	statsPath = NULL;
+	runOutput = tmpfile();
+	assert(runOutput && "cannot create a temporary file for the output of the tuning runs");
+
+	// the profile holds the tuned work sizes, not the ones given on the command line
+	UINT runCoarsening = coarsening;
+	UINT runRangeAlignment = rangeAlignment;
+	coarsening = 0;
+	rangeAlignment = 0;
+	selectWorkSizes(dev, false);
+	tuning = true;
+	printf("Tuning %s, %d time steps per candidate\n", dev->name, (int)maxSteps);
+
+	if(numGroupSizes > 0)
+		tuneWorkSize(dev, &workSizes.updateGroupSize, groupSizes, numGroupSizes, "update work-group", false);
+	tuneWorkSize(dev, &workSizes.coarsening, coarsenings, sizeof(coarsenings) / sizeof(coarsenings[0]), "agents per work-item", false);
+	if(useChunkScan)
+		tuneWorkSize(dev, &workSizes.chunksPerComputeUnit, chunks, sizeof(chunks) / sizeof(chunks[0]), "chunks per compute unit", true);
+	else if(numGroupSizes > 0)
+		tuneWorkSize(dev, &workSizes.compactionGroupSize, groupSizes, numGroupSizes, "compaction work-group", true);
+
+	tuning = false;
+	fclose(runOutput);
+	runOutput = NULL;
+	maxSteps = runSteps;
+	numScenarios = runScenarios;
+	checkpointInterval = runCheckpointInterval;
+	resumePath = runResumePath;
+	statsPath = runStatsPath;
+	coarsening = runCoarsening;
+	rangeAlignment = runRangeAlignment;
+
+	char profile[512];
+	workSizesProfile(dev, profile, sizeof(profile));
+	if(storeWorkSizes(dev, &workSizes) == 0)
+		printf("Work sizes of %s stored in %s\n", dev->name, profile);
+	else
+		printf("Cannot write the profile %s\n", profile);
+}
 
-	icl_release_buffers(5, enbD, bnc, agents, agentAges, agentStates);
+/*
+ * stores the output of a finished run and copies the outputs of all runs, which are complete and not preceded by an incomplete run, to stdout
+ */
+void finishRun(UINT runIndex) {
+	pthread_mutex_lock(&schedulerMutex);
+	runFiles[runIndex] = runOutput;
+	while(nextOutput < numRuns && runFiles[nextOutput]) {
+		FILE* file = runFiles[nextOutput++];
+		rewind(file);
+		char buffer[4096];
+		size_t size;
+		while((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			fwrite(buffer, 1, size, stdout);
+		fclose(file);
+	}
+	fflush(stdout);
+	pthread_mutex_unlock(&schedulerMutex);
+}
+
+/*
+ * host thread driving a single device. Takes the next run of the ensemble until all runs are taken
+ * @param arg the device
+ */
+void* deviceWorker(void* arg) {
+	icl_device* dev = (icl_device*)arg;
+	selectWorkSizes(dev, true);
+
+	for(;;) {
+		pthread_mutex_lock(&schedulerMutex);
+		UINT runIndex = nextRun++;
+		pthread_mutex_unlock(&schedulerMutex);
+		if(runIndex >= numRuns)
+			break;
+
+		if(numRuns == 1) { // a single run is written directly
+			runOutput = stdout;
+			simulateOnDevice(dev, runIndex);
+			continue;
+		}
+
+		// several runs are written to temporary files first, such that the output is ordered by run independently of the devices' speed
+		runOutput = tmpfile();
+		assert(runOutput && "cannot create a temporary file for the output of a run");
+		fprintf(runOutput, "Run %d\tSeed %llu\tDevice %s\n", runIndex, runSeed + runIndex, dev->name);
+		simulateOnDevice(dev, runIndex);
+		finishRun(runIndex);
+	}
+	runOutput = NULL;
+
+	return NULL;
 }
 
 int readArguments(int argc, char **argv, char* temperaturePath, char* environmentPath) {
-	if(argc > 1) {
-		if(strcmp(argv[1], "-h") == 0) {
-			printf("Usage: bin\\abms temperatueFileName environmentFileName speciesHeaderFileName\n");
+	// options can be placed anywhere, all other arguments are file names
+	char* files[3] = {NULL, NULL, NULL};
+	UINT numFiles = 0;
+	for(int i = 1; i < argc; ++i) {
+		if(strcmp(argv[i], "-h") == 0) {
+			printf("Usage: bin\\abms [-host] [-threads numThreads] [-seed seed] [-sync steps] [-replicates num] [-capacity agents] [-runs num] [-burnin steps -scenario environmentFileName ...] [-checkpoint steps fileName] [-resume fileName] [-stats fileName] [-fastmath] [-coarsening agents] [-alignment agents] [-device type] [-autotune] [-patches patchFileName [-migration migrationFileName]] temperatueFileName environmentFileName speciesHeaderFileName\n");
+			printf("\tThe temperature and environment files are text files or binary forcing files written by bin\\convertForcing\n");
+			printf("\t-host\t\tsimulate on the host engine instead of an OpenCL device\n");
+			printf("\t-threads\tnumber of threads of the host engine, default is one per core\n");
+			printf("\t-replicates\tnumber of independent replicates simulated together on the device, sharing its capacity. Default is 1\n");
+			printf("\t-capacity\tinitial number of agents per replicate, grown during the run if needed. Default is %d times the initial population\n",
+					INITIAL_CAPACITY_FACTOR);
+			printf("\t-runs\t\tnumber of independent runs with consecutive seeds, scheduled on all OpenCL devices. Default is 1\n");
+			printf("\t-burnin\t\tnumber of time steps simulated once with the environment file before the scenarios are forked, default is 0\n");
+			printf("\t-scenario\tenvironment file of a scenario holding the time steps after the burn-in, can be given several times. Each scenario continues\n"
+					"\t\t\tfrom a copy of the state after the burn-in\n");
+			printf("\t-checkpoint\twrite the state to the file every given number of time steps, while the simulation continues. With several runs\n"
+					"\t\t\tthe index of the run is appended to the file name\n");
+			printf("\t-resume\t\tcontinue a run from a checkpoint file, producing the same output as the run it was taken from\n");
+			printf("\t-patches\tfile listing a temperature and an environment file per line, one line for each patch. All patches are simulated\n"
+					"\t\t\ttogether, each with its own population and forcing. Replaces the temperature and environment file\n");
+			printf("\t-migration\tfile listing the migration between the patches, a source patch, a target patch and the fraction of the adults of\n"
+					"\t\t\tthe source moving to the target in each time step per line. Not supported on CPU devices. Built with MPI=1 the patches\n"
+					"\t\t\tare split over the ranks started by mpirun, which exchange the migrants at every time step\n");
+			printf("\t-stats\t\twrite the statistics of each time step to a binary file instead of printing them, bin\\statsToCsv converts it. With\n"
+					"\t\t\tseveral runs the index of the run is appended to the file name\n");
+			printf("\t-fastmath\tbuild the kernels with native math functions and relaxed floating point. Faster, but the results differ from\n"
+					"\t\t\tthe default build, compare the statistics of both with bin\\compareStats\n");
+			printf("\t-coarsening\tnumber of consecutive agents updated by each work-item, 1 launches a work-item per agent. Default is the one\n"
+					"\t\t\tof the device's profile, or 16 on CPU devices and 1 on all others\n");
+			printf("\t-alignment\tthe state ranges start at multiples of this number of agents. Default is the one of the device's profile, or 16\n"
+					"\t\t\ton CPU devices and %d on all others\n", RANGE_ALIGNMENT);
+			printf("\t-device\t\ttype of the OpenCL devices simulated on, cpu, gpu, acl or all. Default is %s\n",
+					DEVICE_TYPE == ICL_CPU ? "cpu" : DEVICE_TYPE == ICL_GPU ? "gpu" : "all");
+			printf("\t-autotune\tbenchmark the work-group sizes, the agents per work-item and the scan of each device before the runs and store the\n"
+					"\t\t\tfastest ones in a profile of the device, which is used by all later runs on it\n");
+			printf("\t-sync\t\tnumber of time steps run on the device between two synchronizations with the host, default is 1\n");
+			printf("\t-seed\t\tseed of the random number generator, the same seed reproduces the same run. Default is the current time\n");
 			return -1;
+		} else if(strcmp(argv[i], "-host") == 0) {
+			useHostEngine = true;
+		} else if(strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+			numHostThreads = atoi(argv[++i]);
+		} else if(strcmp(argv[i], "-replicates") == 0 && i + 1 < argc) {
+			numReplicates = max(atoi(argv[++i]), 1);
+		} else if(strcmp(argv[i], "-capacity") == 0 && i + 1 < argc) {
+			initialReplicateCapacity = atoi(argv[++i]);
+		} else if(strcmp(argv[i], "-runs") == 0 && i + 1 < argc) {
+			numRuns = max(atoi(argv[++i]), 1);
+		} else if(strcmp(argv[i], "-burnin") == 0 && i + 1 < argc) {
+			burnInSteps = atoi(argv[++i]);
+		} else if(strcmp(argv[i], "-scenario") == 0 && i + 1 < argc) {
+			if(numScenarios == MAX_SCENARIOS) {
+				printf("At most %d scenarios are supported\n", MAX_SCENARIOS);
+				return -1;
+			}
+			scenarioPaths[numScenarios++] = argv[++i];
+		} else if(strcmp(argv[i], "-checkpoint") == 0 && i + 2 < argc) {
+			checkpointInterval = atoi(argv[++i]);
+			checkpointPath = argv[++i];
+		} else if((strcmp(argv[i], "-resume") == 0 || strcmp(argv[i], "--resume") == 0) && i + 1 < argc) {
+			resumePath = argv[++i];
+		} else if(strcmp(argv[i], "-patches") == 0 && i + 1 < argc) {
+			patchPath = argv[++i];
+		} else if(strcmp(argv[i], "-migration") == 0 && i + 1 < argc) {
+			migrationPath = argv[++i];
+		} else if(strcmp(argv[i], "-stats") == 0 && i + 1 < argc) {
+			statsPath = argv[++i];
+		} else if(strcmp(argv[i], "-coarsening") == 0 && i + 1 < argc) {
+			coarsening = max(atoi(argv[++i]), 1);
+		} else if(strcmp(argv[i], "-alignment") == 0 && i + 1 < argc) {
+			rangeAlignment = max(atoi(argv[++i]), 1);
+		} else if(strcmp(argv[i], "-device") == 0 && i + 1 < argc) {
+			const char* type = argv[++i];
+			if(strcmp(type, "cpu") == 0)
+				deviceType = ICL_CPU;
+			else if(strcmp(type, "gpu") == 0)
+				deviceType = ICL_GPU;
+			else if(strcmp(type, "acl") == 0)
+				deviceType = ICL_ACL;
+			else if(strcmp(type, "all") == 0)
+				deviceType = ICL_ALL;
+			else {
+				printf("Unknown device type %s, use cpu, gpu, acl or all\n", type);
+				return -1;
+			}
+		} else if(strcmp(argv[i], "-autotune") == 0) {
+			autotune = true;
+		} else if(strcmp(argv[i], "-fastmath") == 0) {
+			fastMath = true;
+		} else if(strcmp(argv[i], "-sync") == 0 && i + 1 < argc) {
+			stepsPerSync = max(atoi(argv[++i]), 1);
+		} else if(strcmp(argv[i], "-seed") == 0 && i + 1 < argc) {
+			runSeed = strtoull(argv[++i], NULL, 10);
+			fixedSeed = true;
+		} else if(numFiles < 3) {
+			files[numFiles++] = argv[i];
 		}
 	}
 
-	if(argc > 3)
-		sprintf(kernelBuildArgs, "-I%s -DSPECIES=%s", KENRNEL_INCLUDE_PATH, argv[3]);
-	else
-		sprintf(kernelBuildArgs, "-I%s -DSPECIES=%s", KENRNEL_INCLUDE_PATH, "properties.h");
+	if(numScenarios > 0 && patchPath) {
+		printf("Scenarios are not supported together with patches\n");
+		return -1;
+	}
 
-	if(argc > 2)
-		sprintf(environmentPath, "%s",  argv[2]);
+	if(migrationPath && !patchPath) {
+		printf("Migration needs a patch file\n");
+		return -1;
+	}
+
+	// the chunked scan of CPU devices keeps each population in its own part of the agent arrays
+	if(migrationPath && !useHostEngine && deviceType == ICL_CPU) {
+		printf("Migration is not supported on CPU devices\n");
+		return -1;
+	}
+
+	if(fastMath && useHostEngine)
+		printf("The host engine always uses the precise math functions, ignoring -fastmath\n");
+
+	if(haloSize > 1 && (checkpointInterval > 0 || resumePath)) {
+		printf("Checkpoints are not supported with several ranks\n");
+		return -1;
+	}
+	if(haloSize > 1 && autotune) {
+		printf("Tune the devices with a single rank first, the ranks load their profiles\n");
+		return -1;
+	}
+	if(haloSize > 1 && stepsPerSync > 1) {
+		printf("The ranks exchange migrants at every time step, synchronizing with the device at every time step\n");
+		stepsPerSync = 1;
+	}
+
+	if(numScenarios > 0 && (checkpointInterval > 0 || resumePath)) {
+		printf("Checkpoints are not supported together with scenarios\n");
+		return -1;
+	}
+
+	if(files[2])
+		speciesHeader = files[2];
+
+	if(files[1])
+		sprintf(environmentPath, "%s",  files[1]);
 	else
 		sprintf(environmentPath, "%s", "environment.txt");
 
-	if(argc > 1)
-		sprintf(temperaturePath, "%s", argv[1]);
+	if(files[0])
+		sprintf(temperaturePath, "%s", files[0]);
 	else
 		sprintf(temperaturePath, "%s", "temp.txt");
 
-	printf("Temperature:\t%s\nEnvironment:\t%s\nSpecies:\t%s\n", temperaturePath, environmentPath, argc > 3 ? argv[3] : "properties.h");
+	printf("Temperature:\t%s\nEnvironment:\t%s\nSpecies:\t%s\n", temperaturePath, environmentPath, speciesHeader);
 
 	return 0;
 }
 
+void runOnHost() {
+	UINT numThreads = numHostThreads > 0 ? numHostThreads : hostDefaultThreads();
+	printf("Host engine with %d threads and %s kernels, species header selected at build time\n", numThreads, hostInstructionSet());
+	if(numScenarios > 0)
+		printf("The host engine does not fork scenarios, simulating the environment file only\n");
+	if(numRuns > 1)
+		printf("The host engine simulates a single run\n");
+	if(checkpointInterval > 0 || resumePath)
+		printf("The host engine does not support checkpoints, simulating from the start\n");
+	if(numPatches > 1)
+		printf("The host engine simulates the first patch only, without migration\n");
+
+	icl_timer* totalTime = icl_init_timer(ICL_MILLI);
+	icl_start_timer(totalTime);
+
+	if(statsPath)
+		statsWriter = openStatsWriter(statsPath);
+
+	struct Population population;
+#if DEBUG
+	unsigned long long updates = hostRun(numThreads, initialCapacity(), initialAgentCount, environment, patches[0].temperature, maxSteps, hoursInTimeStep, nSeeds, runSeed,
+			reportHostStats, &population);
+#else
+	unsigned long long updates = hostRun(numThreads, initialCapacity(), initialAgentCount, environment, patches[0].temperature, maxSteps, hoursInTimeStep, nSeeds, runSeed,
+			NULL, &population);
+#endif
+	if(statsWriter)
+		closeStatsWriter(statsWriter);
+	statsWriter = NULL;
+	printPopulation(&population);
+
+	icl_stop_timer(totalTime);
+	printf("Execution time: %f ms\n", totalTime->current_time);
+	printf("Agent updates: %llu, %f M/s, %f M/s per thread\n", updates, updates / (totalTime->current_time * 1000.0),
+			updates / (totalTime->current_time * 1000.0 * numThreads));
+	icl_release_timer(totalTime);
+}
+
 
 int main (int argc, char **argv)
 {
 	char temperaturePath[512],  environmentPath[512];
 
-	if(readArguments(argc, argv, temperaturePath, environmentPath))
+	haloInit(&argc, &argv);
+	if(readArguments(argc, argv, temperaturePath, environmentPath)) {
+		haloFinalize();
 		return 0;
+	}
 	// setup input
 /*
 //	environmentH.immValue = 0.0f;
@@ -603,104 +2233,80 @@ int main (int argc, char **argv)
 	environment[0].larvacideValue = 0.0f;
 */
 
-	struct EggsNbiomass enbH;
-	// number of initial eggs in environment
-	enbH.newEggs = initialAgentCount;
-	enbH.totalBiomass = initialAgentCount;
 
-	srand(time(NULL));
+	if(!fixedSeed)
+		runSeed = time(NULL);
+	// all ranks simulate the same runs
+	haloBroadcast(&runSeed, sizeof(runSeed));
+	printf("Seed:\t\t%llu\n", runSeed);
+
+	if(readForcing(temperaturePath, environmentPath) < 0 || readScenarios() < 0 || readMigration() < 0 || decomposePatches() < 0) {
+		haloFinalize();
+		return -1;
+	}
 
 	// init ocl
-	icl_init_devices(DEVICE_TYPE);
+	if(!useHostEngine)
+		icl_init_devices(deviceType);
+
+	if(haloSize > 1 && icl_get_num_devices() == 0) {
+		printf("Rank %d cannot find any OpenCL device, the host engine does not support several ranks\n", haloRank);
+		haloFinalize();
+		return -1;
+	}
 
 	if (icl_get_num_devices() != 0)
 	{
-		icl_device* dev = icl_get_device(0);
-
-		icl_print_device_short_info(dev);
-
-		initEvent = icl_create_event();
-		killEvent = icl_create_event();
-		updateEvent = icl_create_event();
-		oldToNewEvent = icl_create_event();
-#ifdef PARALLEL_SCAN
-		preScanEvent = icl_create_event();
-#endif
-
-#if TIMING
-		initTime = 0.0;
-		l1deTimer = icl_init_timer(ICL_MILLI);
-		genderTimer = icl_init_timer(ICL_MILLI);
-		randTimer = icl_init_timer(ICL_MILLI);
-		killTime = 0.0;
-		updateTime = 0.0;
-		scanTimer = icl_init_timer(ICL_MILLI);
-		oldToNewTime = 0.0;
-#endif
+		// one host thread per device, but no more devices than runs. Each rank drives a single device, the ranks exchange migrants at every time
+		// step and simulate the runs one after another
+		UINT numDevices = haloSize > 1 ? 1 : min(icl_get_num_devices(), numRuns);
+		UINT firstDevice = haloRank % icl_get_num_devices();
+		for(UINT d = 0; d < numDevices; ++d)
+			icl_print_device_short_info(icl_get_device(firstDevice + d));
+
+		// with -device all, CPU devices are only known now
+		for(UINT d = 0; d < numDevices; ++d)
+			if(migrationPath && (icl_get_device(firstDevice + d)->type & CL_DEVICE_TYPE_CPU)) {
+				printf("Migration is not supported on CPU devices, select the other devices with -device\n");
+				icl_release_devices();
+				haloFinalize();
+				return -1;
+			}
+
+		if(autotune)
+			for(UINT d = 0; d < numDevices; ++d)
+				tuneDevice(icl_get_device(firstDevice + d));
 
 		icl_timer* totalTime = icl_init_timer(ICL_MILLI);
 		icl_start_timer(totalTime);
 
-		// seeds for random number generation
-		icl_buffer* seedsD = icl_create_buffer(dev, CL_MEM_READ_ONLY, nSeeds * sizeof(struct Seeds));
-		struct Seeds* seedsH = (struct Seeds*)malloc(nSeeds * sizeof(struct Seeds));
-
-		//create initial population
-		struct Population population;
-		icl_buffer* enbD = icl_create_buffer(dev, CL_MEM_READ_WRITE, sizeof(struct EggsNbiomass));
-		icl_buffer* bnc = icl_create_buffer(dev, CL_MEM_READ_WRITE, sizeof(struct BitesNcycles));
-		icl_buffer* agents = icl_create_buffer(dev, CL_MEM_READ_WRITE, maxAgents * sizeof(struct Agent));
-		icl_buffer* agentAges = icl_create_buffer(dev, CL_MEM_READ_WRITE, maxAgents * sizeof(struct AgentAge));
-		icl_buffer* agentStates = icl_create_buffer(dev, CL_MEM_READ_WRITE, maxAgents * sizeof(struct AgentState));
-
-		icl_write_buffer(enbD, CL_TRUE, sizeof(struct EggsNbiomass), &enbH, NULL, NULL);
-
-		struct BitesNcycles bncH;
-		bncH.numCyclesReported = 0;
-		bncH.sumCyclesReported = 0;
-		bncH.numBitesReported = 0;
-		bncH.numInfectBitesReported = 0;
-		icl_write_buffer(bnc, CL_TRUE, sizeof(struct BitesNcycles), &bncH, NULL, NULL);
-		icl_write_buffer(enbD, CL_TRUE, sizeof(struct EggsNbiomass), &enbH, NULL, NULL);
-
-		if(readSingleValFile(temperaturePath, &temperature) < 0)
-			return -1;
-		if(readEnvironment(environmentPath) < 0)
-			return -1;
-
-		generateSeeds(seedsD, seedsH, dev);
-		icl_kernel* createEggs = createInitialPopulation(agents, agentAges, agentStates, &population, enbD, seedsD, dev);
-
-		run(enbD, bnc, agents, agentAges, agentStates, seedsD, &population, seedsH, dev, createEggs);
-
-		clFinish(dev->queue);
-		free(seedsH);
+		runFiles = (FILE**)calloc(numRuns, sizeof(FILE*));
+		pthread_t* threads = (pthread_t*)malloc(numDevices * sizeof(pthread_t));
+		for(UINT d = 0; d < numDevices; ++d)
+			pthread_create(&threads[d], NULL, deviceWorker, (void*)icl_get_device(firstDevice + d));
+		for(UINT d = 0; d < numDevices; ++d)
+			pthread_join(threads[d], NULL);
+		free(threads);
+		free(runFiles);
 
 		icl_stop_timer(totalTime);
-		icl_release_events(4, initEvent, killEvent, updateEvent, oldToNewEvent);
-#ifdef PARALLEL_SCAN
-		icl_release_event(preScanEvent);
-#endif
-#if TIMING
-		printf("init\t\t%lf\nl1de\t\t%lf\ngender\t\t%lf\nrand\t\t%lf\nkill\t\t%lf\nupdate\t\t%lf\nscan\t\t%lf\noldToNew\t%lf\n",
-				initTime, l1deTimer->current_time, genderTimer->current_time, randTimer->current_time,
-				killTime, updateTime, scanTimer->current_time, oldToNewTime);
-
-		icl_release_timer(l1deTimer);
-		icl_release_timer(genderTimer);
-		icl_release_timer(randTimer);
-		icl_release_timer(scanTimer);
-#endif
 		icl_release_devices();
-		free(temperature);
-		free(environment);
 
 		printf("Execution time: %f ms\n", totalTime->current_time);
 		icl_release_timer(totalTime);
 	} else {
-		printf("Cannot find any OpenCL device of %s\n", DEVICE_TYPE == ICL_CPU ? "type CPU" : DEVICE_TYPE == ICL_GPU ? "type GPU" : "requested type");
+		if(!useHostEngine)
+			printf("Cannot find any OpenCL device of %s, using the host engine\n",
+					deviceType == ICL_CPU ? "type CPU" : deviceType == ICL_GPU ? "type GPU" : "requested type");
+		runOnHost();
 	}
 
+	for(UINT p = 0; p < numPatches; ++p)
+		releasePatchForcing(&patches[p]);
+	free(patches);
+	free(scenarioEnvironments);
+
+	haloFinalize();
 	return 0;
 }
 
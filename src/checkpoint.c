@@ -0,0 +1,147 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "device_types.h"
+#include "checkpoint.h"
+
+#define NUM_STATES 8
+
+static const char checkpointMagic[8] = {'S', 'A', 'M', 'P', 'O', 'C', 'P', '1'};
+
+struct AgentRange* checkpointRange(struct Population* pop, UINT s) {
+	// the ranges of the eight states are consecutive in struct Population
+	return &pop->eggs + s;
+}
+
+struct Checkpoint* createCheckpoint(UINT step, UINT numReplicates, UINT nSeeds, unsigned long long runSeed, struct Population* pops) {
+	struct Checkpoint* cp = (struct Checkpoint*)malloc(sizeof(struct Checkpoint));
+	memcpy(cp->header.magic, checkpointMagic, sizeof(checkpointMagic));
+	cp->header.step = step;
+	cp->header.numReplicates = numReplicates;
+	cp->header.nSeeds = nSeeds;
+	cp->header.agentSizes[0] = sizeof(struct Agent);
+	cp->header.agentSizes[1] = sizeof(struct AgentAge);
+	cp->header.agentSizes[2] = sizeof(struct AgentState);
+	cp->header.runSeed = runSeed;
+
+	cp->pops = (struct Population*)malloc(2 * numReplicates * sizeof(struct Population));
+	memcpy(cp->pops, pops, 2 * numReplicates * sizeof(struct Population));
+
+	cp->header.numAgents = 0;
+	for(UINT r = 0; r < numReplicates; ++r)
+		for(UINT s = 0; s < NUM_STATES; ++s) {
+			struct AgentRange* range = checkpointRange(&pops[2 * r], s);
+			cp->header.numAgents += range->end - range->start;
+		}
+
+	cp->enb = (struct EggsNbiomass*)malloc(numReplicates * sizeof(struct EggsNbiomass));
+	cp->bnc = (struct BitesNcycles*)malloc(numReplicates * sizeof(struct BitesNcycles));
+	cp->seeds = (struct Seeds*)malloc(nSeeds * sizeof(struct Seeds));
+	cp->agents = (struct Agent*)malloc(cp->header.numAgents * sizeof(struct Agent));
+	cp->agentAges = (struct AgentAge*)malloc(cp->header.numAgents * sizeof(struct AgentAge));
+	cp->agentStates = (struct AgentState*)malloc(cp->header.numAgents * sizeof(struct AgentState));
+
+	return cp;
+}
+
+/*
+ * writes or reads all arrays of a checkpoint, except the header
+ */
+static int transferCheckpoint(FILE* file, struct Checkpoint* cp, bool write) {
+	UINT numReplicates = cp->header.numReplicates;
+	UINT numAgents = cp->header.numAgents;
+	void* arrays[7] = {cp->pops, cp->enb, cp->bnc, cp->seeds, cp->agents, cp->agentAges, cp->agentStates};
+	size_t sizes[7] = {2 * numReplicates * sizeof(struct Population), numReplicates * sizeof(struct EggsNbiomass),
+			numReplicates * sizeof(struct BitesNcycles), cp->header.nSeeds * sizeof(struct Seeds), numAgents * sizeof(struct Agent),
+			numAgents * sizeof(struct AgentAge), numAgents * sizeof(struct AgentState)};
+
+	for(UINT i = 0; i < 7; ++i) {
+		size_t done = write ? fwrite(arrays[i], 1, sizes[i], file) : fread(arrays[i], 1, sizes[i], file);
+		if(done != sizes[i])
+			return -1;
+	}
+	return 0;
+}
+
+int writeCheckpoint(const char* path, struct Checkpoint* cp) {
+	char* tmpPath = (char*)malloc(strlen(path) + 32);
+	sprintf(tmpPath, "%s.%d.tmp", path, (int)getpid());
+
+	FILE* file = fopen(tmpPath, "wb");
+	if(!file) {
+		printf("Cannot write checkpoint %s\n", tmpPath);
+		free(tmpPath);
+		return -1;
+	}
+
+	int err = fwrite(&cp->header, sizeof(struct CheckpointHeader), 1, file) == 1 ? transferCheckpoint(file, cp, true) : -1;
+	if(fclose(file) != 0)
+		err = -1;
+
+	if(err == 0)
+		err = rename(tmpPath, path);
+	if(err != 0) {
+		printf("Cannot write checkpoint %s\n", path);
+		remove(tmpPath);
+	}
+
+	free(tmpPath);
+	return err;
+}
+
+struct Checkpoint* readCheckpoint(const char* path) {
+	FILE* file = fopen(path, "rb");
+	if(!file) {
+		printf("Cannot open checkpoint %s\n", path);
+		return NULL;
+	}
+
+	struct CheckpointHeader header;
+	if(fread(&header, sizeof(struct CheckpointHeader), 1, file) != 1 || memcmp(header.magic, checkpointMagic, sizeof(checkpointMagic)) != 0 ||
+			header.agentSizes[0] != sizeof(struct Agent) || header.agentSizes[1] != sizeof(struct AgentAge) ||
+			header.agentSizes[2] != sizeof(struct AgentState)) {
+		printf("%s is not a checkpoint of this build\n", path);
+		fclose(file);
+		return NULL;
+	}
+
+	// the populations are needed to allocate the agents
+	struct Population* pops = (struct Population*)malloc(2 * header.numReplicates * sizeof(struct Population));
+	if(fread(pops, sizeof(struct Population), 2 * header.numReplicates, file) != 2 * header.numReplicates) {
+		printf("Checkpoint %s is truncated\n", path);
+		free(pops);
+		fclose(file);
+		return NULL;
+	}
+	struct Checkpoint* cp = createCheckpoint(header.step, header.numReplicates, header.nSeeds, header.runSeed, pops);
+	free(pops);
+
+	fseek(file, sizeof(struct CheckpointHeader), SEEK_SET);
+	int err = cp->header.numAgents == header.numAgents ? transferCheckpoint(file, cp, false) : -1;
+	fclose(file);
+
+	if(err != 0) {
+		printf("Checkpoint %s is truncated\n", path);
+		releaseCheckpoint(cp);
+		return NULL;
+	}
+	return cp;
+}
+
+void releaseCheckpoint(struct Checkpoint* cp) {
+	free(cp->pops);
+	free(cp->enb);
+	free(cp->bnc);
+	free(cp->seeds);
+	free(cp->agents);
+	free(cp->agentAges);
+	free(cp->agentStates);
+	free(cp);
+}
@@ -0,0 +1,67 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ */
+
+#include <stdio.h>
+#include "host_types.h"
+
+#include "lib_icl.h"
+#include "scan.h"
+
+#define NUM_STATES 8
+
+// thread local, every device is driven by its own host thread
+static __thread icl_buffer* chunkCounts;
+
+static __thread icl_kernel* chunkCount;
+static __thread icl_kernel* chunkOffsets;
+static __thread icl_kernel* chunkScan;
+
+static __thread UINT numChunks;
+static __thread size_t replicates;
+
+void chunk_scan(icl_buffer* agentStates, icl_buffer* pop, icl_buffer* spans, icl_buffer* prefixSum1, icl_buffer* prefixSum2, icl_buffer* prefixSum3) {
+	// the kernels split the agents of each replicate into the chunks themselves
+	size_t localWorkSize[2] = {1, 1};
+	size_t globalWorkSize[2] = {numChunks, replicates};
+	size_t singleWorkSize[2] = {1, replicates};
+
+	icl_run_kernel(chunkCount, 2, globalWorkSize, localWorkSize, NULL, NULL, 4,
+			(size_t)0, (void *)agentStates,
+			(size_t)0, (void *)pop,
+			(size_t)0, (void *)spans,
+			(size_t)0, (void *)chunkCounts);
+
+	icl_run_kernel(chunkOffsets, 2, singleWorkSize, localWorkSize, NULL, NULL, 2,
+			(size_t)0, (void *)chunkCounts,
+			sizeof(UINT), &numChunks);
+
+	icl_run_kernel(chunkScan, 2, globalWorkSize, localWorkSize, NULL, NULL, 7,
+			(size_t)0, (void *)agentStates,
+			(size_t)0, (void *)pop,
+			(size_t)0, (void *)spans,
+			(size_t)0, (void *)prefixSum1,
+			(size_t)0, (void *)prefixSum2,
+			(size_t)0, (void *)prefixSum3,
+			(size_t)0, (void *)chunkCounts);
+}
+
+void chunk_scan_init(UINT numReplicates, UINT chunksPerComputeUnit, icl_device* dev, const char* build_options, icl_create_kernel_flag flag) {
+	numChunks = dev->max_compute_units * chunksPerComputeUnit;
+	replicates = numReplicates;
+
+	chunkCounts = icl_create_buffer(dev, CL_MEM_READ_WRITE, numReplicates * numChunks * NUM_STATES * sizeof(UINT));
+
+	chunkCount = icl_create_kernel(dev, "kernel/chunkScan.cl", "chunkCount", build_options, flag);
+	chunkOffsets = icl_create_kernel(dev, "kernel/chunkScan.cl", "chunkOffsets", build_options, flag);
+	chunkScan = icl_create_kernel(dev, "kernel/chunkScan.cl", "chunkScan", build_options, flag);
+}
+
+void chunk_scan_release() {
+	icl_release_kernel(chunkCount);
+	icl_release_kernel(chunkOffsets);
+	icl_release_kernel(chunkScan);
+
+	icl_release_buffer(chunkCounts);
+}
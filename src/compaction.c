@@ -0,0 +1,147 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ */
+
+#include <stdio.h>
+#include "host_types.h"
+
+#include "lib_icl.h"
+#include "scan.h"
+#include "migration.h"
+#include "tuning.h"
+
+#define NUM_STATES 8
+
+// thread local, every device is driven by its own host thread
+static __thread icl_buffer* groupCounts;
+// passed for all buffers of the migration if it is disabled
+static __thread icl_buffer* noMigration;
+static __thread struct MigrationGraph* graph;
+
+static __thread icl_kernel* compactCount;
+static __thread icl_kernel* compactOffsets;
+static __thread icl_kernel* compactAgents;
+static __thread icl_kernel* migrationDraw;
+static __thread icl_kernel* migrationRanges;
+static __thread icl_kernel* importAgents;
+
+static __thread size_t workGroupSize;
+static __thread size_t replicates;
+
+void compaction(icl_buffer* agents, icl_buffer* agentAges, icl_buffer* agentStates, icl_buffer* newAgents, icl_buffer* newAgentAges,
+		icl_buffer* newAgentStates, icl_buffer* pop, icl_buffer* spans, icl_buffer* enb, icl_buffer* seeds, UINT numAgents, icl_event* event) {
+	// at least one work-group to write the new population even if there are no agents
+	UINT numGroups = (numAgents + workGroupSize - 1) / workGroupSize;
+	numGroups = numGroups > 0 ? numGroups : 1;
+	size_t globalWorkSize[2] = {numGroups * workGroupSize, replicates};
+	size_t localWorkSize[2] = {workGroupSize, 1};
+	size_t offsetsWorkSize[2] = {workGroupSize, replicates};
+	size_t singleWorkSize[2] = {1, replicates};
+	size_t singleLocalSize[2] = {1, 1};
+
+	icl_run_kernel(compactCount, 2, globalWorkSize, localWorkSize, NULL, NULL, 5,
+			(size_t)0, (void *)agentStates,
+			(size_t)0, (void *)pop,
+			(size_t)0, (void *)spans,
+			(size_t)0, (void *)groupCounts,
+			sizeof(cl_ulong2) * workGroupSize, NULL);
+
+	icl_run_kernel(compactOffsets, 2, offsetsWorkSize, localWorkSize, NULL, NULL, 5,
+			(size_t)0, (void *)groupCounts,
+			sizeof(UINT), &numGroups,
+			(size_t)0, (void *)pop,
+			(size_t)0, (void *)enb,
+			sizeof(UINT) * NUM_STATES * (workGroupSize + 1), NULL);
+
+	// draws the migrants and moves the ranges written by compactOffsets to make room for them
+	if(graph) {
+		icl_run_kernel(migrationDraw, 2, singleWorkSize, singleLocalSize, NULL, NULL, 7,
+				(size_t)0, (void *)pop,
+				(size_t)0, (void *)graph->edges,
+				(size_t)0, (void *)graph->outStart,
+				(size_t)0, (void *)graph->popMigration,
+				(size_t)0, (void *)graph->edgeMigration,
+				(size_t)0, (void *)seeds,
+				sizeof(UINT), &graph->numEdges);
+
+		icl_run_kernel(migrationRanges, 2, singleWorkSize, singleLocalSize, NULL, NULL, 7,
+				(size_t)0, (void *)pop,
+				(size_t)0, (void *)graph->inEdges,
+				(size_t)0, (void *)graph->inStart,
+				(size_t)0, (void *)graph->popMigration,
+				(size_t)0, (void *)graph->edgeMigration,
+				(size_t)0, (void *)graph->imports,
+				sizeof(UINT), &graph->numEdges);
+	}
+
+	UINT numEdges = graph ? graph->numEdges : 0;
+	icl_run_kernel(compactAgents, 2, globalWorkSize, localWorkSize, NULL, event, 16,
+			(size_t)0, (void *)agents,
+			(size_t)0, (void *)agentAges,
+			(size_t)0, (void *)agentStates,
+			(size_t)0, (void *)newAgents,
+			(size_t)0, (void *)newAgentAges,
+			(size_t)0, (void *)newAgentStates,
+			(size_t)0, (void *)groupCounts,
+			(size_t)0, (void *)pop,
+			(size_t)0, (void *)spans,
+			(size_t)0, (void *)enb,
+			sizeof(cl_ulong2) * workGroupSize, NULL,
+			(size_t)0, (void *)(graph ? graph->edges : noMigration),
+			(size_t)0, (void *)(graph ? graph->outStart : noMigration),
+			(size_t)0, (void *)(graph ? graph->popMigration : noMigration),
+			(size_t)0, (void *)(graph ? graph->edgeMigration : noMigration),
+			sizeof(UINT), &numEdges);
+
+	if(graph && graph->maxImports > 0) {
+		size_t importWorkSize[2] = {((graph->maxImports + workGroupSize - 1) / workGroupSize) * workGroupSize, replicates};
+		icl_run_kernel(importAgents, 2, importWorkSize, localWorkSize, NULL, NULL, 9,
+				(size_t)0, (void *)newAgents,
+				(size_t)0, (void *)newAgentAges,
+				(size_t)0, (void *)newAgentStates,
+				(size_t)0, (void *)graph->inboxAgents,
+				(size_t)0, (void *)graph->inboxAges,
+				(size_t)0, (void *)graph->inboxStates,
+				(size_t)0, (void *)pop,
+				(size_t)0, (void *)graph->imports,
+				(size_t)0, (void *)graph->popMigration);
+	}
+}
+
+void compaction_init(size_t wx, UINT maxN, UINT numReplicates, struct MigrationGraph* migration, icl_device* dev, const char* build_options,
+		icl_create_kernel_flag flag) {
+	replicates = numReplicates;
+	graph = migration;
+
+	compactCount = icl_create_kernel(dev, "kernel/compaction.cl", "compactCount", build_options, flag);
+	compactOffsets = icl_create_kernel(dev, "kernel/compaction.cl", "compactOffsets", build_options, flag);
+	compactAgents = icl_create_kernel(dev, "kernel/compaction.cl", "compactAgents", build_options, flag);
+	workGroupSize = fittingGroupSize(compactCount, fittingGroupSize(compactOffsets, fittingGroupSize(compactAgents, wx)));
+
+	if(graph) {
+		migrationDraw = icl_create_kernel(dev, "kernel/migration.cl", "migrationDraw", build_options, flag);
+		migrationRanges = icl_create_kernel(dev, "kernel/migration.cl", "migrationRanges", build_options, flag);
+		importAgents = icl_create_kernel(dev, "kernel/migration.cl", "importAgents", build_options, flag);
+		workGroupSize = fittingGroupSize(importAgents, workGroupSize);
+	} else
+		noMigration = icl_create_buffer(dev, CL_MEM_READ_ONLY, sizeof(UINT));
+
+	// overapproximation for allocation, using maximum allowed size for n
+	UINT numGroups = (maxN + workGroupSize - 1) / workGroupSize;
+	groupCounts = icl_create_buffer(dev, CL_MEM_READ_WRITE, numReplicates * numGroups * NUM_STATES * sizeof(UINT));
+}
+
+void compaction_release() {
+	icl_release_kernel(compactCount);
+	icl_release_kernel(compactOffsets);
+	icl_release_kernel(compactAgents);
+	if(graph) {
+		icl_release_kernel(migrationDraw);
+		icl_release_kernel(migrationRanges);
+		icl_release_kernel(importAgents);
+	} else
+		icl_release_buffer(noMigration);
+
+	icl_release_buffer(groupCounts);
+}
@@ -0,0 +1,198 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ *
+ * compares two binary statistics files written with -stats, usually of a run with -fastmath against the same run without it. Prints the mean of
+ * each statistic in both files and the mean and maximal absolute difference between the rows of the same time step, replicate and patch
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "device_types.h"
+#include "statsWriter.h"
+
+// columns identifying a row, they have to be equal in both files
+static const char* keyColumns[] = {"step", "replicate", "patch", "phase", "hours", "temperature"};
+#define NUM_KEY_COLUMNS (sizeof(keyColumns) / sizeof(keyColumns[0]))
+
+struct StatsReader {
+	const char* path;
+	FILE* file;
+	struct StatsFileHeader header;
+	struct StatsColumn* columns;
+	UINT* block;
+	UINT capacity;
+	UINT numRows;
+	UINT row; // next row of the current block
+};
+
+int openStats(struct StatsReader* reader, const char* path) {
+	memset(reader, 0, sizeof(struct StatsReader));
+	reader->path = path;
+	reader->file = fopen(path, "rb");
+	if(!reader->file) {
+		printf("Cannot open %s\n", path);
+		return -1;
+	}
+
+	if(fread(&reader->header, sizeof(struct StatsFileHeader), 1, reader->file) != 1 || memcmp(reader->header.magic, "SAMPOST1", 8) != 0) {
+		printf("%s is not a statistics file\n", path);
+		return -1;
+	}
+
+	reader->columns = (struct StatsColumn*)malloc(reader->header.numColumns * sizeof(struct StatsColumn));
+	if(fread(reader->columns, sizeof(struct StatsColumn), reader->header.numColumns, reader->file) != reader->header.numColumns) {
+		printf("%s is truncated\n", path);
+		return -1;
+	}
+	return 0;
+}
+
+void closeStats(struct StatsReader* reader) {
+	free(reader->block);
+	free(reader->columns);
+	if(reader->file)
+		fclose(reader->file);
+}
+
+/*
+ * reads the next row into row, one value per column as double
+ * @return 1 if a row was read, 0 at the end of the file and -1 if the file is truncated
+ */
+int readRow(struct StatsReader* reader, double* row) {
+	UINT numColumns = reader->header.numColumns;
+	while(reader->row == reader->numRows) {
+		if(fread(&reader->numRows, sizeof(UINT), 1, reader->file) != 1)
+			return 0;
+		if(reader->numRows > reader->capacity) {
+			reader->capacity = reader->numRows;
+			reader->block = (UINT*)realloc(reader->block, numColumns * reader->capacity * sizeof(UINT));
+		}
+		if(fread(reader->block, sizeof(UINT), numColumns * reader->numRows, reader->file) != numColumns * reader->numRows) {
+			printf("%s is truncated\n", reader->path);
+			return -1;
+		}
+		reader->row = 0;
+	}
+
+	for(UINT c = 0; c < numColumns; ++c) {
+		UINT* value = &reader->block[c * reader->numRows + reader->row];
+		if(reader->columns[c].type == STATS_COLUMN_REAL) {
+			REAL real;
+			memcpy(&real, value, sizeof(REAL));
+			row[c] = real;
+		} else
+			row[c] = *value;
+	}
+	++reader->row;
+	return 1;
+}
+
+int isKeyColumn(const char* name) {
+	for(UINT k = 0; k < NUM_KEY_COLUMNS; ++k)
+		if(strcmp(name, keyColumns[k]) == 0)
+			return 1;
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	if(argc < 3) {
+		printf("Usage: bin\\compareStats preciseStatsFileName fastStatsFileName\n");
+		printf("\tcompares the statistics of two runs with the same seed and arguments, usually without and with -fastmath\n");
+		return -1;
+	}
+
+	struct StatsReader precise, fast;
+	int err = openStats(&precise, argv[1]);
+	if(!err)
+		err = openStats(&fast, argv[2]);
+	else
+		memset(&fast, 0, sizeof(struct StatsReader));
+
+	UINT numColumns = precise.header.numColumns;
+	if(!err && (fast.header.numColumns != numColumns || memcmp(precise.columns, fast.columns, numColumns * sizeof(struct StatsColumn)) != 0)) {
+		printf("%s and %s have different columns\n", argv[1], argv[2]);
+		err = -1;
+	}
+	if(err) {
+		closeStats(&precise);
+		closeStats(&fast);
+		return err;
+	}
+
+	double* preciseRow = (double*)malloc(numColumns * sizeof(double));
+	double* fastRow = (double*)malloc(numColumns * sizeof(double));
+	double* preciseSum = (double*)calloc(numColumns, sizeof(double));
+	double* fastSum = (double*)calloc(numColumns, sizeof(double));
+	double* diffSum = (double*)calloc(numColumns, sizeof(double));
+	double* diffMax = (double*)calloc(numColumns, sizeof(double));
+	UINT numRows = 0;
+
+	for(;;) {
+		int preciseRead = readRow(&precise, preciseRow);
+		int fastRead = readRow(&fast, fastRow);
+		if(preciseRead < 0 || fastRead < 0) {
+			err = -1;
+			break;
+		}
+		if(preciseRead != fastRead) {
+			printf("%s has more rows than %s\n", preciseRead ? argv[1] : argv[2], preciseRead ? argv[2] : argv[1]);
+			err = -1;
+			break;
+		}
+		if(!preciseRead)
+			break;
+
+		for(UINT c = 0; c < numColumns; ++c) {
+			if(isKeyColumn(precise.columns[c].name)) {
+				if(preciseRow[c] != fastRow[c]) {
+					printf("Row %u differs in column %s, both files have to be written by runs with the same arguments\n", numRows,
+							precise.columns[c].name);
+					err = -1;
+				}
+				continue;
+			}
+
+			double diff = fabs(fastRow[c] - preciseRow[c]);
+			preciseSum[c] += preciseRow[c];
+			fastSum[c] += fastRow[c];
+			diffSum[c] += diff;
+			if(diff > diffMax[c])
+				diffMax[c] = diff;
+		}
+		if(err)
+			break;
+		++numRows;
+	}
+
+	if(!err && numRows > 0) {
+		// the relative shift is the mean absolute difference relative to the mean of the precise run
+		printf("%u rows\n", numRows);
+		printf("%-24s %14s %14s %14s %14s %10s\n", "column", "precise mean", "fast mean", "mean |diff|", "max |diff|", "shift");
+		for(UINT c = 0; c < numColumns; ++c) {
+			if(isKeyColumn(precise.columns[c].name))
+				continue;
+
+			double preciseMean = preciseSum[c] / numRows;
+			double diffMean = diffSum[c] / numRows;
+			printf("%-24s %14.2f %14.2f %14.2f %14.2f", precise.columns[c].name, preciseMean, fastSum[c] / numRows, diffMean, diffMax[c]);
+			if(preciseMean != 0.0)
+				printf(" %9.3f%%\n", 100.0 * diffMean / fabs(preciseMean));
+			else
+				printf(" %10s\n", "-");
+		}
+	}
+
+	free(preciseRow);
+	free(fastRow);
+	free(preciseSum);
+	free(fastSum);
+	free(diffSum);
+	free(diffMax);
+	closeStats(&precise);
+	closeStats(&fast);
+	return err;
+}
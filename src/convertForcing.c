@@ -0,0 +1,68 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ *
+ * converts temperature and environment text files to binary forcing files, which are mapped by the simulation instead of parsed
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "device_types.h"
+#include "forcing.h"
+
+// carrying capacity of the simulation's text input, 500 * FACTOR
+#define DEFAULT_CARRYING_CAPACITY (500.0f * 320.0f)
+
+int main(int argc, char **argv) {
+	REAL hoursInTimeStep = 1.0f;
+	REAL carryingCapacity = DEFAULT_CARRYING_CAPACITY;
+	int kind = -1;
+	char* files[2] = {NULL, NULL};
+	UINT numFiles = 0;
+
+	for(int i = 1; i < argc; ++i) {
+		if(strcmp(argv[i], "-temperature") == 0) {
+			kind = FORCING_TEMPERATURE;
+		} else if(strcmp(argv[i], "-environment") == 0) {
+			kind = FORCING_ENVIRONMENT;
+		} else if(strcmp(argv[i], "-hours") == 0 && i + 1 < argc) {
+			hoursInTimeStep = atof(argv[++i]);
+		} else if(strcmp(argv[i], "-carryingCapacity") == 0 && i + 1 < argc) {
+			carryingCapacity = atof(argv[++i]);
+		} else if(numFiles < 2) {
+			files[numFiles++] = argv[i];
+		}
+	}
+
+	if(kind < 0 || numFiles < 2) {
+		printf("Usage: bin\\convertForcing -temperature|-environment [-hours hoursInTimeStep] [-carryingCapacity capacity] textFileName binaryFileName\n");
+		printf("\t-temperature\tconvert a temperature file, one value per time step\n");
+		printf("\t-environment\tconvert an environment file, one line of interventions per time step\n");
+		printf("\t-hours\t\tlength of a time step in hours, default is 1\n");
+		printf("\t-carryingCapacity\tcarrying capacity stored with each time step of an environment file, default is %0.1f\n",
+				DEFAULT_CARRYING_CAPACITY);
+		return -1;
+	}
+
+	void* records;
+	UINT recordSize;
+	long long steps;
+	if(kind == FORCING_TEMPERATURE) {
+		steps = readTemperatureText(files[0], (Temperature**)&records, 0);
+		recordSize = sizeof(Temperature);
+	} else {
+		steps = readEnvironmentText(files[0], (struct Environment**)&records, 0, carryingCapacity);
+		recordSize = sizeof(struct Environment);
+	}
+	if(steps < 0)
+		return -1;
+
+	int err = writeForcing(files[1], kind, recordSize, (UINT)steps, hoursInTimeStep, records);
+	if(err == 0)
+		printf("%s: %lld time steps of %0.2f hours\n", files[1], steps, hoursInTimeStep);
+	free(records);
+
+	return err;
+}
@@ -0,0 +1,160 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "device_types.h"
+#include "forcing.h"
+
+// number of records allocated first when a text file is read completely
+#define INITIAL_TEXT_STEPS 8760
+
+static const char forcingMagic[8] = {'S', 'A', 'M', 'P', 'O', 'F', 'C', '1'};
+
+bool isForcingFile(const char* path) {
+	FILE* file = fopen(path, "rb");
+	if(!file)
+		return false;
+
+	char magic[8];
+	bool binary = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, forcingMagic, sizeof(magic)) == 0;
+	fclose(file);
+	return binary;
+}
+
+int writeForcing(const char* path, UINT kind, UINT recordSize, UINT numSteps, REAL hoursInTimeStep, const void* records) {
+	FILE* file = fopen(path, "wb");
+	if(!file) {
+		printf("Cannot write %s\n", path);
+		return -1;
+	}
+
+	struct ForcingHeader header;
+	memset(&header, 0, sizeof(struct ForcingHeader));
+	memcpy(header.magic, forcingMagic, sizeof(forcingMagic));
+	header.kind = kind;
+	header.recordSize = recordSize;
+	header.numSteps = numSteps;
+	header.hoursInTimeStep = hoursInTimeStep;
+
+	int err = (fwrite(&header, sizeof(struct ForcingHeader), 1, file) == 1 && fwrite(records, recordSize, numSteps, file) == numSteps) ? 0 : -1;
+	if(fclose(file) != 0)
+		err = -1;
+	if(err)
+		printf("Cannot write %s\n", path);
+	return err;
+}
+
+void* mapForcing(const char* path, UINT kind, UINT recordSize, struct ForcingHeader* header) {
+	int fd = open(path, O_RDONLY);
+	if(fd < 0) {
+		printf("Cannot open %s\n", path);
+		return NULL;
+	}
+
+	struct stat st;
+	if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct ForcingHeader)) {
+		printf("%s is not a forcing file\n", path);
+		close(fd);
+		return NULL;
+	}
+
+	char* base = (char*)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping stays valid after the file is closed
+	close(fd);
+	if(base == MAP_FAILED) {
+		printf("Cannot map %s\n", path);
+		return NULL;
+	}
+
+	memcpy(header, base, sizeof(struct ForcingHeader));
+	if(memcmp(header->magic, forcingMagic, sizeof(forcingMagic)) != 0 || header->kind != kind || header->recordSize != recordSize ||
+			(size_t)st.st_size < sizeof(struct ForcingHeader) + (size_t)header->numSteps * recordSize) {
+		printf("%s is not a %s forcing file of this build or is truncated\n", path, kind == FORCING_TEMPERATURE ? "temperature" : "environment");
+		munmap(base, st.st_size);
+		return NULL;
+	}
+
+	return base + sizeof(struct ForcingHeader);
+}
+
+void unmapForcing(void* records) {
+	if(!records)
+		return;
+
+	struct ForcingHeader* header = (struct ForcingHeader*)((char*)records - sizeof(struct ForcingHeader));
+	munmap(header, sizeof(struct ForcingHeader) + (size_t)header->numSteps * header->recordSize);
+}
+
+/*
+ * grows an array of records read from a text file if it is full
+ * @return the new capacity
+ */
+static UINT growRecords(void** records, UINT capacity, UINT used, UINT recordSize) {
+	if(used < capacity)
+		return capacity;
+
+	capacity *= 2;
+	*records = realloc(*records, (size_t)capacity * recordSize);
+	return capacity;
+}
+
+long long readTemperatureText(const char* path, Temperature** temperature, UINT numSteps) {
+	FILE* temp = fopen(path, "r");
+	if(!temp) {
+		printf("Cannot open %s. Check temperature file path\n", path);
+		return -1;
+	}
+
+	UINT capacity = numSteps > 0 ? numSteps : INITIAL_TEXT_STEPS;
+	*temperature = (Temperature*)malloc(sizeof(Temperature) * capacity);
+
+	UINT i = 0u;
+	for(; numSteps == 0 || i < numSteps; ++i) {
+		capacity = growRecords((void**)temperature, capacity, i, sizeof(Temperature));
+		if(fscanf(temp, "%f", &(*temperature)[i]) != 1)
+			break;
+	}
+
+	fclose(temp);
+	return i;
+}
+
+long long readEnvironmentText(const char* path, struct Environment** env, UINT numSteps, REAL carryingCapacity) {
+	FILE* interventions = fopen(path, "r");
+	if(!interventions) {
+		printf("Cannot open %s. Check environment file path\n", path);
+		return -1;
+	}
+
+	UINT capacity = numSteps > 0 ? numSteps : INITIAL_TEXT_STEPS;
+	*env = (struct Environment*)malloc(sizeof(struct Environment) * capacity);
+
+	REAL coverage[4], effectiveness[4];
+
+	// TODO check how arguments should be used
+	UINT i = 0u;
+	for(; numSteps == 0 || i < numSteps; ++i) {
+		capacity = growRecords((void**)env, capacity, i, sizeof(struct Environment));
+		struct Environment* e = &(*env)[i];
+		if(fscanf(interventions, "%f, %f, %f, %f, %f, %f, %f, %f, %f", &coverage[0], &effectiveness[0], &coverage[1], &effectiveness[1],
+				&coverage[2], &effectiveness[2], &coverage[3], &effectiveness[3], &e->bloodmealSuccess) != 9)
+			break;
+		e->IRSValue = coverage[0] * effectiveness[0];
+		e->ITNValue = coverage[1] * effectiveness[1];
+		e->larvacideValue = coverage[2] * effectiveness[2];
+		e->oviTrapValue = coverage[3] * effectiveness[3];
+		e->carryingCapacity = carryingCapacity; // TODO change this to reading from file, once an appropriate file is available
+	}
+	fclose(interventions);
+
+	return i;
+}
@@ -0,0 +1,106 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if USE_MPI
+#include <mpi.h>
+#endif
+
+#include "device_types.h"
+#include "halo.h"
+
+UINT haloRank = 0;
+UINT haloSize = 1;
+
+void haloInit(int* argc, char*** argv) {
+#if USE_MPI
+	int rank, size;
+	MPI_Init(argc, argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+	haloRank = rank;
+	haloSize = size;
+#endif
+}
+
+void haloFinalize() {
+#if USE_MPI
+	MPI_Finalize();
+#endif
+}
+
+void haloBroadcast(void* data, UINT size) {
+#if USE_MPI
+	MPI_Bcast(data, size, MPI_BYTE, 0, MPI_COMM_WORLD);
+#endif
+}
+
+void partitionPatches(const REAL* weights, UINT numPatches, UINT numRanks, UINT* owner) {
+	REAL* load = (REAL*)calloc(numRanks, sizeof(REAL));
+	bool* assigned = (bool*)calloc(numPatches, sizeof(bool));
+
+	for(UINT i = 0; i < numPatches; ++i) {
+		// the heaviest patch left, the first one on ties
+		UINT patch = numPatches;
+		for(UINT p = 0; p < numPatches; ++p)
+			if(!assigned[p] && (patch == numPatches || weights[p] > weights[patch]))
+				patch = p;
+
+		UINT rank = 0;
+		for(UINT r = 1; r < numRanks; ++r)
+			if(load[r] < load[rank])
+				rank = r;
+
+		owner[patch] = rank;
+		load[rank] += weights[patch];
+		assigned[patch] = true;
+	}
+
+	free(load);
+	free(assigned);
+}
+
+char* haloExchange(char** sendBuffers, UINT* sendSizes, UINT* recvSizes) {
+#if USE_MPI
+	int* sendCounts = (int*)malloc(4 * haloSize * sizeof(int));
+	int* sendOffsets = sendCounts + haloSize;
+	int* recvCounts = sendCounts + 2 * haloSize;
+	int* recvOffsets = sendCounts + 3 * haloSize;
+
+	// the sizes first, then the buffers packed one after another
+	UINT sendTotal = 0;
+	for(UINT r = 0; r < haloSize; ++r) {
+		sendCounts[r] = sendSizes[r];
+		sendOffsets[r] = sendTotal;
+		sendTotal += sendSizes[r];
+	}
+	MPI_Alltoall(sendCounts, 1, MPI_INT, recvCounts, 1, MPI_INT, MPI_COMM_WORLD);
+
+	UINT recvTotal = 0;
+	for(UINT r = 0; r < haloSize; ++r) {
+		recvSizes[r] = recvCounts[r];
+		recvOffsets[r] = recvTotal;
+		recvTotal += recvCounts[r];
+	}
+
+	char* send = (char*)malloc(sendTotal > 0 ? sendTotal : 1);
+	for(UINT r = 0; r < haloSize; ++r)
+		memcpy(send + sendOffsets[r], sendBuffers[r], sendSizes[r]);
+	char* recv = (char*)malloc(recvTotal > 0 ? recvTotal : 1);
+	MPI_Alltoallv(send, sendCounts, sendOffsets, MPI_BYTE, recv, recvCounts, recvOffsets, MPI_BYTE, MPI_COMM_WORLD);
+
+	free(send);
+	free(sendCounts);
+	return recv;
+#else
+	// a single rank only sends to itself
+	recvSizes[0] = sendSizes[0];
+	char* recv = (char*)malloc(sendSizes[0] > 0 ? sendSizes[0] : 1);
+	memcpy(recv, sendBuffers[0], sendSizes[0]);
+	return recv;
+#endif
+}
@@ -0,0 +1,982 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stddef.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+// AVX2 and AVX-512 versions of the per-agent loops, see selectHostKernels
+#define HOST_SIMD
+#endif
+
+#include "device_types.h"
+#include "agent.h"
+
+// OpenCL built-ins used by the model functions. The model functions get the index of the agent as argument, the global id is only used for the
+// replicate and the host engine simulates a single replicate
+UINT hostGlobalSize;
+#define get_global_id(dim) 0u
+#define get_global_size(dim) ((dim) == 0 ? hostGlobalSize : 1u)
+#define atomic_add(ptr, val) __sync_fetch_and_add(ptr, val)
+#define atomic_inc(ptr) __sync_fetch_and_add(ptr, 1u)
+#define mul_hi(a, b) ((UINT)(((unsigned long long)(a) * (b)) >> 32))
+#define M_PI_F 3.14159265358979f
+// fraction of the capacity the agents may occupy before it is doubled
+#define GROWTH_THRESHOLD 0.75
+#define min(a, b) ((a < b) ? a : b)
+#define max(a, b) ((a > b) ? a : b)
+
+// including species header, for the host engine it is selected at build time
+#ifndef SPECIES
+#define SPECIES properties.h
+#endif
+#define STR_VALUE(arg) #arg
+#define INC(name) STR_VALUE(name)
+#define SPECIES_INC INC(SPECIES)
+#include SPECIES_INC
+#include "gpuRand.h"
+
+#include "stats.h"
+#include "hostEngine.h"
+
+#define NUM_STATES 8
+
+///////////////////////////////////////////////////////////////////////// THREAD POOL /////////////////////////////////////////////////////////////////////////
+
+/*
+ * job executed by every thread of the pool on its chunk [begin, end) of the index range
+ */
+typedef void (*HostJob)(UINT tid, UINT begin, UINT end, void* arg);
+
+struct HostThreadPool {
+	pthread_t* threads;
+	UINT numThreads;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t startCond;
+	pthread_cond_t doneCond;
+	UINT generation; // incremented for each job
+	UINT running;	 // number of worker threads still busy with the current job
+	bool quit;
+
+	HostJob job;
+	void* arg;
+	UINT n;
+};
+
+struct HostThreadPool pool;
+
+void runChunk(UINT tid) {
+	UINT begin = (UINT)(((unsigned long long)pool.n * tid) / pool.numThreads);
+	UINT end = (UINT)(((unsigned long long)pool.n * (tid + 1)) / pool.numThreads);
+	pool.job(tid, begin, end, pool.arg);
+}
+
+void* poolWorker(void* arg) {
+	UINT tid = (UINT)(size_t)arg;
+	UINT generation = 0;
+
+	pthread_mutex_lock(&pool.mutex);
+	for(;;) {
+		while(pool.generation == generation && !pool.quit)
+			pthread_cond_wait(&pool.startCond, &pool.mutex);
+		if(pool.quit)
+			break;
+		generation = pool.generation;
+		pthread_mutex_unlock(&pool.mutex);
+
+		runChunk(tid);
+
+		pthread_mutex_lock(&pool.mutex);
+		if(--pool.running == 0)
+			pthread_cond_signal(&pool.doneCond);
+	}
+	pthread_mutex_unlock(&pool.mutex);
+
+	return NULL;
+}
+
+void poolInit(UINT numThreads) {
+	pool.numThreads = numThreads;
+	pool.generation = 0;
+	pool.running = 0;
+	pool.quit = false;
+	pthread_mutex_init(&pool.mutex, NULL);
+	pthread_cond_init(&pool.startCond, NULL);
+	pthread_cond_init(&pool.doneCond, NULL);
+
+	// the calling thread works as thread 0
+	pool.threads = (pthread_t*)malloc(numThreads * sizeof(pthread_t));
+	for(UINT i = 1; i < numThreads; ++i)
+		pthread_create(&pool.threads[i], NULL, poolWorker, (void*)(size_t)i);
+}
+
+void poolRelease() {
+	pthread_mutex_lock(&pool.mutex);
+	pool.quit = true;
+	pthread_cond_broadcast(&pool.startCond);
+	pthread_mutex_unlock(&pool.mutex);
+
+	for(UINT i = 1; i < pool.numThreads; ++i)
+		pthread_join(pool.threads[i], NULL);
+
+	pthread_cond_destroy(&pool.doneCond);
+	pthread_cond_destroy(&pool.startCond);
+	pthread_mutex_destroy(&pool.mutex);
+	free(pool.threads);
+}
+
+/*
+ * splits [0, n) into one contiguous chunk per thread and runs job on all of them. Returns after all threads are done
+ */
+void parallelFor(HostJob job, UINT n, void* arg) {
+	pthread_mutex_lock(&pool.mutex);
+	pool.job = job;
+	pool.arg = arg;
+	pool.n = n;
+	pool.running = pool.numThreads - 1;
+	++pool.generation;
+	pthread_cond_broadcast(&pool.startCond);
+	pthread_mutex_unlock(&pool.mutex);
+
+	runChunk(0);
+
+	pthread_mutex_lock(&pool.mutex);
+	while(pool.running > 0)
+		pthread_cond_wait(&pool.doneCond, &pool.mutex);
+	pthread_mutex_unlock(&pool.mutex);
+}
+
+UINT hostDefaultThreads() {
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	return cores > 0 ? (UINT)cores : 1u;
+}
+
+//////////////////////////////////////////////////////////////////////////// ENGINE ///////////////////////////////////////////////////////////////////////////
+
+// results of a single thread, aligned to avoid false sharing
+struct HostPartial {
+	UINT counts[NUM_STATES];
+	UINT offsets[NUM_STATES];
+	UINT numLarvae1DayEquiv;
+	UINT numFemale;
+	UINT numPotentiallyInfective;
+	UINT newEggs;
+	struct BitesNcycles bnc;
+} __attribute__((aligned(64)));
+
+struct HostState {
+	struct Agent* agents;
+	struct AgentAge* agentAges;
+	struct AgentState* agentStates;
+	struct Agent* newAgents;
+	struct AgentAge* newAgentAges;
+	struct AgentState* newAgentStates;
+
+	struct Population pop;
+	struct AgentRange ranges[NUM_STATES]; // ranges of pop, in the order of the states
+	struct AgentRange newRanges[NUM_STATES];
+
+	struct Environment environment;
+	Temperature temperature;
+	REAL elapsedTimeInHours;
+	UINT worldTime;
+	struct Seeds* seeds;
+	struct EggsNbiomass enb;
+	REAL mortality[MORTALITY_TABLE_SIZE]; // hourly mortality rates of the current time step
+
+	struct HostPartial* partial;
+};
+
+void getRanges(struct Population* pop, struct AgentRange* ranges) {
+	ranges[0] = pop->eggs;
+	ranges[1] = pop->larvae;
+	ranges[2] = pop->pupae;
+	ranges[3] = pop->immatures;
+	ranges[4] = pop->mateSeekings;
+	ranges[5] = pop->bmSeekings;
+	ranges[6] = pop->bmDigestings;
+	ranges[7] = pop->gravids;
+}
+
+void setRanges(struct Population* pop, struct AgentRange* ranges) {
+	pop->eggs = ranges[0];
+	pop->larvae = ranges[1];
+	pop->pupae = ranges[2];
+	pop->immatures = ranges[3];
+	pop->mateSeekings = ranges[4];
+	pop->bmSeekings = ranges[5];
+	pop->bmDigestings = ranges[6];
+	pop->gravids = ranges[7];
+}
+
+/*
+ * same as the initAgents kernel
+ */
+void initAgent(struct HostState* hs, UINT id) {
+	struct AgentState as;
+	as.dead = false;
+	as.state = EGG;
+	hs->newAgentStates[id] = as;
+
+	struct AgentAge agentAge;
+	agentAge.ageInHours = 0.0f;
+	agentAge.hoursInState = 0.0f;
+	agentAge.isFemale = randUniformN(&hs->seeds[3], id, 1) <= 0.5;
+	agentAge.cumulativeSporogonicDevelopment = 0.0f;
+	hs->newAgentAges[id] = agentAge;
+
+	struct Agent agent;
+	agent.humanBloodmealCount = 0u;
+	agent.availableEggs = 0u;
+	agent.cycleLength = 0u;
+	agent.cumulativeLarvalDelay = 0.0f;
+	agent.delay = eggsIncubation(hs->temperature) + eggsHatching(randUniformN(&hs->seeds[2], id, 1));
+	agent.numEggBatches = 0u;
+	hs->newAgents[id] = agent;
+}
+
+/*
+ * tabulates the hourly mortality rates of the current time step, like the mortalityTable kernel
+ */
+void tabulateHostMortality(struct HostState* hs) {
+	for(UINT entry = 0; entry < MORTALITY_TABLE_SIZE; ++entry) {
+		REAL DMR;	// DMR = Daily Mortality Rate
+
+		if(entry < MORTALITY_LARVA) { // adults
+			UINT ageInDays = entry - MORTALITY_ADULT;
+			REAL a = 0.1f;
+			REAL B = 25.0f;
+			REAL s = 0.1f;
+			DMR = (a * expf(ageInDays/B)) / (1.0f + (a * B * s * (expf(ageInDays/B) - 1.0f)) );
+		} else if(entry < MORTALITY_EGG) { // larvae
+			UINT ageInDays = entry - MORTALITY_LARVA;
+			REAL rainfallCoefficient = 1.0f;
+			REAL a = 0.1f;
+			DMR = a * expf( (REAL)hs->pop.numLarvae1DayEquiv / (ageInDays * hs->environment.carryingCapacity * rainfallCoefficient) );
+			DMR = min(DMR, 0.8f);
+		} else { // eggs and pupae
+			DMR = 0.1f;
+		}
+
+		REAL DSR = 1.0f - DMR;	// DSR = Daily Survival Rate
+		REAL HSR = powf(DSR, 1.0f/24.0f);	// HSR = Hourly Survival Rate
+		hs->mortality[entry] = 1.0f - HSR;	// HMR = Hourly Mortality Rate
+	}
+}
+
+/////////////////////////////////////////////////////////////////////// AGENT KERNELS ///////////////////////////////////////////////////////////////////////
+
+// the loops touching every agent in every time step, with one implementation per instruction set. Each works on the agents [begin, end) of a single
+// state range, the whole set is chosen once with CPUID
+struct HostKernels {
+	const char* name;
+	// marks the agents dying in this time step as dead, like agentDies. seeds is seeds[0] of the random number generator
+	void (*kill)(const struct AgentAge* agentAges, struct AgentState* agentStates, UINT begin, UINT end, UINT state, const REAL* mortality,
+			struct Seeds* seeds);
+	// adds the length of the time step to ageInHours and hoursInState
+	void (*age)(struct AgentAge* agentAges, UINT begin, UINT end, REAL elapsedTimeInHours);
+	// adds the development of the time step to cumulativeLarvalDelay, the agents have to be larvae
+	void (*developLarvae)(struct Agent* agents, UINT begin, UINT end, REAL development);
+};
+
+struct HostKernels hostKernels;
+
+/*
+ * index of an agent's hourly mortality rate in the table of tabulateHostMortality
+ * @param state the index of the state range the agent is located in
+ */
+UINT mortalityEntry(UINT state, REAL ageInHours) {
+	UINT ageInDays = (UINT)min(ageInHours / 24.0f, 99.0f);
+	return state >= 3 ? MORTALITY_ADULT + ageInDays : state == 1 ? MORTALITY_LARVA + ageInDays : state == 0 ? MORTALITY_EGG : MORTALITY_PUPA;
+}
+
+void killScalar(const struct AgentAge* agentAges, struct AgentState* agentStates, UINT begin, UINT end, UINT state, const REAL* mortality,
+		struct Seeds* seeds) {
+	for(UINT gid = begin; gid < end; ++gid)
+		if(randUniform(seeds, gid) <= mortality[mortalityEntry(state, agentAges[gid].ageInHours)])	// Kill this agent
+			agentStates[gid].dead = true;
+}
+
+void ageScalar(struct AgentAge* agentAges, UINT begin, UINT end, REAL elapsedTimeInHours) {
+	for(UINT gid = begin; gid < end; ++gid) {
+		agentAges[gid].ageInHours += elapsedTimeInHours;
+		agentAges[gid].hoursInState += elapsedTimeInHours;
+	}
+}
+
+void developLarvaeScalar(struct Agent* agents, UINT begin, UINT end, REAL development) {
+	for(UINT gid = begin; gid < end; ++gid)
+		agents[gid].cumulativeLarvalDelay += development;
+}
+
+#ifdef HOST_SIMD
+// the vector kernels draw the same random numbers and perform the same floating point operations as the scalar ones, producing the same results.
+// Agents left over at the end of a range are processed by the scalar kernels
+
+/*
+ * multiplies the 32 bit lanes of a by m, giving the upper and the lower halves of the products like mul_hi and *
+ */
+__attribute__((target("avx2"))) void mulAvx2(__m256i a, __m256i m, __m256i* hi, __m256i* lo) {
+	__m256i even = _mm256_mul_epu32(a, m);
+	__m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(m, 32));
+	*hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+	*lo = _mm256_mullo_epi32(a, m);
+}
+
+/*
+ * same as randUniform for the agents gid to gid + 7
+ */
+__attribute__((target("avx2"))) __m256 randUniformAvx2(struct Seeds* seeds, UINT gid) {
+	__m256i ctr0 = _mm256_add_epi32(_mm256_set1_epi32(gid), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+	__m256i ctr1 = _mm256_set1_epi32(seeds->z3);
+	__m256i ctr2 = _mm256_set1_epi32(seeds->z4); // the host engine simulates replicate 0
+	__m256i ctr3 = _mm256_setzero_si256();
+	UINT key0 = seeds->z1, key1 = seeds->z2;
+
+	for(UINT round = 0; round < 10; ++round) {
+		__m256i hi0, lo0, hi1, lo1;
+		mulAvx2(ctr0, _mm256_set1_epi32(PHILOX_M0), &hi0, &lo0);
+		mulAvx2(ctr2, _mm256_set1_epi32(PHILOX_M1), &hi1, &lo1);
+
+		ctr0 = _mm256_xor_si256(_mm256_xor_si256(hi1, ctr1), _mm256_set1_epi32(key0));
+		ctr1 = lo1;
+		ctr2 = _mm256_xor_si256(_mm256_xor_si256(hi0, ctr3), _mm256_set1_epi32(key1));
+		ctr3 = lo0;
+
+		key0 += PHILOX_W0;
+		key1 += PHILOX_W1;
+	}
+
+	__m256i bits = _mm256_add_epi32(_mm256_srli_epi32(ctr0, 8), _mm256_set1_epi32(1));
+	return _mm256_mul_ps(_mm256_cvtepi32_ps(bits), _mm256_set1_ps(PHILOX_TO_REAL));
+}
+
+__attribute__((target("avx2"))) void killAvx2(const struct AgentAge* agentAges, struct AgentState* agentStates, UINT begin, UINT end, UINT state,
+		const REAL* mortality, struct Seeds* seeds) {
+	__m256i ageIndex = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(sizeof(struct AgentAge) / sizeof(REAL)));
+	__m256i firstEntry = _mm256_set1_epi32(mortalityEntry(state, 0.0f));
+	bool byAge = state == 1 || state >= 3;
+
+	UINT gid = begin;
+	for(; gid + 8 <= end; gid += 8) {
+		__m256 probability = randUniformAvx2(seeds, gid);
+		__m256i entry = firstEntry;
+		if(byAge) {
+			__m256 ageInHours = _mm256_i32gather_ps(&agentAges[gid].ageInHours, ageIndex, 4);
+			__m256 ageInDays = _mm256_min_ps(_mm256_div_ps(ageInHours, _mm256_set1_ps(24.0f)), _mm256_set1_ps(99.0f));
+			entry = _mm256_add_epi32(entry, _mm256_cvttps_epi32(ageInDays));
+		}
+
+		int dies = _mm256_movemask_ps(_mm256_cmp_ps(probability, _mm256_i32gather_ps(mortality, entry, 4), _CMP_LE_OQ));
+		for(; dies; dies &= dies - 1)
+			agentStates[gid + __builtin_ctz(dies)].dead = true;
+	}
+
+	killScalar(agentAges, agentStates, gid, end, state, mortality, seeds);
+}
+
+__attribute__((target("avx2"))) void ageAvx2(struct AgentAge* agentAges, UINT begin, UINT end, REAL elapsedTimeInHours) {
+	// two agents per vector, only the lanes of ageInHours and hoursInState are updated
+	__m256 step = _mm256_set1_ps(elapsedTimeInHours);
+
+	UINT gid = begin;
+	for(; gid + 2 <= end; gid += 2) {
+		__m256 ages = _mm256_loadu_ps(&agentAges[gid].ageInHours);
+		_mm256_storeu_ps(&agentAges[gid].ageInHours, _mm256_blend_ps(ages, _mm256_add_ps(ages, step), 0x33));
+	}
+
+	ageScalar(agentAges, gid, end, elapsedTimeInHours);
+}
+
+__attribute__((target("avx512f"))) void mulAvx512(__m512i a, __m512i m, __m512i* hi, __m512i* lo) {
+	__m512i even = _mm512_mul_epu32(a, m);
+	__m512i odd = _mm512_mul_epu32(_mm512_srli_epi64(a, 32), _mm512_srli_epi64(m, 32));
+	*hi = _mm512_mask_blend_epi32(0xAAAA, _mm512_srli_epi64(even, 32), odd);
+	*lo = _mm512_mullo_epi32(a, m);
+}
+
+/*
+ * same as randUniform for the agents gid to gid + 15
+ */
+__attribute__((target("avx512f"))) __m512 randUniformAvx512(struct Seeds* seeds, UINT gid) {
+	__m512i ctr0 = _mm512_add_epi32(_mm512_set1_epi32(gid), _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+	__m512i ctr1 = _mm512_set1_epi32(seeds->z3);
+	__m512i ctr2 = _mm512_set1_epi32(seeds->z4); // the host engine simulates replicate 0
+	__m512i ctr3 = _mm512_setzero_si512();
+	UINT key0 = seeds->z1, key1 = seeds->z2;
+
+	for(UINT round = 0; round < 10; ++round) {
+		__m512i hi0, lo0, hi1, lo1;
+		mulAvx512(ctr0, _mm512_set1_epi32(PHILOX_M0), &hi0, &lo0);
+		mulAvx512(ctr2, _mm512_set1_epi32(PHILOX_M1), &hi1, &lo1);
+
+		ctr0 = _mm512_xor_si512(_mm512_xor_si512(hi1, ctr1), _mm512_set1_epi32(key0));
+		ctr1 = lo1;
+		ctr2 = _mm512_xor_si512(_mm512_xor_si512(hi0, ctr3), _mm512_set1_epi32(key1));
+		ctr3 = lo0;
+
+		key0 += PHILOX_W0;
+		key1 += PHILOX_W1;
+	}
+
+	__m512i bits = _mm512_add_epi32(_mm512_srli_epi32(ctr0, 8), _mm512_set1_epi32(1));
+	return _mm512_mul_ps(_mm512_cvtepi32_ps(bits), _mm512_set1_ps(PHILOX_TO_REAL));
+}
+
+__attribute__((target("avx512f"))) void killAvx512(const struct AgentAge* agentAges, struct AgentState* agentStates, UINT begin, UINT end, UINT state,
+		const REAL* mortality, struct Seeds* seeds) {
+	__m512i ageIndex = _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+			_mm512_set1_epi32(sizeof(struct AgentAge) / sizeof(REAL)));
+	__m512i firstEntry = _mm512_set1_epi32(mortalityEntry(state, 0.0f));
+	bool byAge = state == 1 || state >= 3;
+
+	UINT gid = begin;
+	for(; gid + 16 <= end; gid += 16) {
+		__m512 probability = randUniformAvx512(seeds, gid);
+		__m512i entry = firstEntry;
+		if(byAge) {
+			__m512 ageInHours = _mm512_i32gather_ps(ageIndex, &agentAges[gid].ageInHours, 4);
+			__m512 ageInDays = _mm512_min_ps(_mm512_div_ps(ageInHours, _mm512_set1_ps(24.0f)), _mm512_set1_ps(99.0f));
+			entry = _mm512_add_epi32(entry, _mm512_cvttps_epi32(ageInDays));
+		}
+
+		UINT dies = _mm512_cmp_ps_mask(probability, _mm512_i32gather_ps(entry, mortality, 4), _CMP_LE_OQ);
+		for(; dies; dies &= dies - 1)
+			agentStates[gid + __builtin_ctz(dies)].dead = true;
+	}
+
+	killScalar(agentAges, agentStates, gid, end, state, mortality, seeds);
+}
+
+__attribute__((target("avx512f"))) void ageAvx512(struct AgentAge* agentAges, UINT begin, UINT end, REAL elapsedTimeInHours) {
+	// four agents per vector, only the lanes of ageInHours and hoursInState are updated
+	__m512 step = _mm512_set1_ps(elapsedTimeInHours);
+
+	UINT gid = begin;
+	for(; gid + 4 <= end; gid += 4) {
+		__m512 ages = _mm512_loadu_ps(&agentAges[gid].ageInHours);
+		_mm512_storeu_ps(&agentAges[gid].ageInHours, _mm512_mask_add_ps(ages, 0x3333, ages, step));
+	}
+
+	ageScalar(agentAges, gid, end, elapsedTimeInHours);
+}
+
+__attribute__((target("avx512f"))) void developLarvaeAvx512(struct Agent* agents, UINT begin, UINT end, REAL development) {
+	// the development is scattered back, AVX2 has no scatter and uses the scalar kernel
+	__m512i index = _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+			_mm512_set1_epi32(sizeof(struct Agent) / sizeof(REAL)));
+	__m512 step = _mm512_set1_ps(development);
+
+	UINT gid = begin;
+	for(; gid + 16 <= end; gid += 16) {
+		REAL* delays = &agents[gid].cumulativeLarvalDelay;
+		_mm512_i32scatter_ps(delays, index, _mm512_add_ps(_mm512_i32gather_ps(index, delays, 4), step), 4);
+	}
+
+	developLarvaeScalar(agents, gid, end, development);
+}
+#endif
+
+/*
+ * selects the kernels of the widest instruction set the CPU supports, AVX-512, AVX2 or the scalar ones
+ */
+struct HostKernels selectHostKernels() {
+	struct HostKernels kernels = {"scalar", killScalar, ageScalar, developLarvaeScalar};
+#ifdef HOST_SIMD
+	// the vector kernels load ageInHours and hoursInState of several agents at once
+	assert(sizeof(struct AgentAge) == 4 * sizeof(REAL) && offsetof(struct AgentAge, hoursInState) == sizeof(REAL));
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f")) {
+		struct HostKernels avx512 = {"AVX-512", killAvx512, ageAvx512, developLarvaeAvx512};
+		kernels = avx512;
+	} else if(__builtin_cpu_supports("avx2")) {
+		struct HostKernels avx2 = {"AVX2", killAvx2, ageAvx2, developLarvaeScalar};
+		kernels = avx2;
+	}
+#endif
+	return kernels;
+}
+
+const char* hostInstructionSet() {
+	return selectHostKernels().name;
+}
+
+/*
+ * same as the updateAgents kernel, except that bites, cycles and eggs are counted in the partial results of the calling thread. The agent is already
+ * aged and, for larvae, developed by the kernels of killUpdateJob
+ * @param state the index of the state range the agent is located in
+ */
+void updateAgent(struct HostState* hs, UINT gid, UINT state, struct HostPartial* partial, struct EggsNbiomass* enb) {
+	struct Environment* environment = &hs->environment;
+	Temperature temperature = hs->temperature;
+	REAL elapsedTimeInHours = hs->elapsedTimeInHours;
+	UINT worldTime = hs->worldTime;
+	struct Seeds* seeds = hs->seeds;
+
+	struct AgentState agentState = hs->agentStates[gid];
+	if(agentState.dead) return;
+
+	struct Agent agent = hs->agents[gid];
+	struct AgentAge agentAge = hs->agentAges[gid];
+
+	agentAge.cumulativeSporogonicDevelopment += (temperature > 16.0f && agent.humanBloodmealCount > 0u) *
+			(1.0f/((111.0f/(temperature-16.0f))*14.0));
+
+	switch(state) {
+	case 0: // egg
+		if(agentAge.hoursInState >= agent.delay && eggsTransitionTime(worldTime)) {
+			agentAge.ageInHours = 24.0f;
+			agentAge.hoursInState = 0.0f;
+			agent.delay = larvaDelay(seeds+1, gid);
+			agentState.state = LARVA;
+		}
+		break;
+	case 1: // larva
+		if (environment->larvacideValue > 0.0f && agentAge.hoursInState == elapsedTimeInHours) {
+			REAL larvacide = randUniform(&seeds[2], gid);
+			if (larvacide <= environment->larvacideValue) {
+				hs->agentStates[gid].dead = true;
+				return;
+			}
+		}
+
+		if(agent.cumulativeLarvalDelay >= agent.delay && larvaeTransitionTime(worldTime)) {
+			agentAge.hoursInState = 0.0f;
+			agent.delay = pupaDelay(temperature);
+			agentState.state = PUPA;
+		}
+		break;
+	case 2: // pupa
+		if((agentAge.hoursInState >= agent.delay) && pupaeTransitionTime(worldTime)) {
+			agentAge.ageInHours = 0.0f;
+			agentAge.hoursInState = 0.0f;
+			agent.delay = immatureDelay(temperature);
+			agentState.state = IMMATURE;
+		}
+		break;
+	case 3: // immature
+		if(agentAge.hoursInState >= agent.delay && immaturesTransitionTime(worldTime)) {
+			agent.delay = mateSeekingDelay(temperature);
+			agentAge.hoursInState = 0.0f;
+			agentState.state = MATESEEKING;
+		}
+		break;
+	case 4: // mate seeking
+		if((agentAge.hoursInState >= agent.delay) && agentAge.isFemale && mateSeekingsTransitionTime(worldTime)) {
+			agentAge.hoursInState = 0.0f;
+			agent.delay = bloodMealSeekingDelay(temperature);
+			agentState.state = BMS;
+		}
+		break;
+	case 5: // blood meal seeking
+		++agent.cycleLength;
+
+		if((agentAge.hoursInState >= agent.delay) && bloodMealSeekingsTransitionTime(worldTime)) {
+			REAL bloodmealSuccessProbability = randUniform(&seeds[1], gid);
+			if(bloodmealSuccessProbability <= environment->bloodmealSuccess) {
+
+				if(environment->ITNValue * BITE_HUMAN_PROBABILITY * BITE_INDOOR_PROBABILITY > 0.0f) {
+					REAL ITN = randUniform(&seeds[2], gid);
+					if(ITN <= environment->ITNValue * BITE_HUMAN_PROBABILITY * BITE_INDOOR_PROBABILITY) {
+						hs->agentStates[gid].dead = true;
+						return;
+					}
+				}
+
+				int bitesAhuman = BITE_HUMAN_PROBABILITY < 1.0f ? (randUniform(&seeds[3], gid) <= BITE_HUMAN_PROBABILITY) : 1;
+
+				agent.humanBloodmealCount += 1u * bitesAhuman;
+
+				++partial->bnc.numBitesReported;
+
+				agentAge.hoursInState = 0.0f;
+				agent.delay = bloodMealDigestingDelay(temperature);
+				agentState.state = BMD;
+
+				if((agentAge.cumulativeSporogonicDevelopment >= 1.0f) && bitesAhuman)
+					++partial->bnc.numInfectBitesReported;
+			}
+		}
+		break;
+	case 6: // blood meal digesting
+		if(environment->IRSValue * REST_INDOOR_PROBABILITY > 0.0f) {
+			REAL ITN = randUniform(&seeds[2], gid);
+			if(ITN <= environment->IRSValue * REST_INDOOR_PROBABILITY) {
+				hs->agentStates[gid].dead = true;
+				return;
+			}
+		}
+
+		++agent.cycleLength;
+
+		if(agentAge.hoursInState >= agent.delay && bloodMealDigestingsTransitionTime(worldTime)) {
+			if(agent.availableEggs <= 0 && agentAge.isFemale) {
+				agent.availableEggs = generateEggs(seeds+1, gid, &agent.numEggBatches);
+			}
+
+			agentAge.hoursInState = 0.0f;
+			agent.ovipositionAttemps = 0u;
+			agentState.state = GRAVID;
+		}
+		break;
+	default: // gravid
+		++agent.cycleLength;
+		if(gravidsEggLayTime(worldTime)) {
+			bool shouldLayEggs = randUniform(&seeds[1], gid) < 0.25f;
+
+			if(shouldLayEggs) {
+				if(environment->oviTrapValue > 0.0f) {
+					REAL OVITrap = randUniform(&seeds[2], gid);
+					if(OVITrap <= environment->oviTrapValue) {
+						agentState.dead = true;
+						agent.availableEggs = 0;
+					}
+				}
+
+				if(!agentState.dead) {
+					// enb is private to the calling thread, the eggs are summed up after all agents are updated
+					agent.availableEggs = layEggs(&agent, &agentState, enb, seeds, environment->carryingCapacity);
+				}
+
+				++agent.ovipositionAttemps;
+
+				if(agent.availableEggs == 0) {
+					++partial->bnc.numCyclesReported;
+					partial->bnc.sumCyclesReported += agent.cycleLength;
+
+					agent.cycleLength = 0;
+
+					agentAge.hoursInState = 0.0f;
+					agent.delay = bloodMealSeekingDelay(temperature);
+					agentState.state = BMS;
+				}
+			}
+		}
+		break;
+	}
+
+	hs->agents[gid] = agent;
+	hs->agentAges[gid] = agentAge;
+	hs->agentStates[gid] = agentState;
+}
+
+/*
+ * calculates the larvae one day equivalents, females and potentially infective females, like the calcL1de and calcGender kernels
+ */
+void statsJob(UINT tid, UINT begin, UINT end, void* arg) {
+	struct HostState* hs = (struct HostState*)arg;
+	struct HostPartial* partial = &hs->partial[tid];
+	partial->numLarvae1DayEquiv = 0;
+	partial->numFemale = 0;
+	partial->numPotentiallyInfective = 0;
+
+	for(UINT s = 1; s < NUM_STATES; ++s) {
+		if(s == 2) continue; // pupae
+		UINT lo = max(hs->ranges[s].start, begin);
+		UINT hi = min(hs->ranges[s].end, end);
+		for(UINT i = lo; i < hi; ++i) {
+			struct AgentAge agentAge = hs->agentAges[i];
+			if(s == 1) {
+				partial->numLarvae1DayEquiv += (UINT)(agentAge.ageInHours/24.0f);
+			} else if(agentAge.isFemale) {
+				++partial->numFemale;
+				partial->numPotentiallyInfective += agentAge.cumulativeSporogonicDevelopment >= 1.0f;
+			}
+		}
+	}
+}
+
+/*
+ * applies mortality and updates the state of all agents, like the killAgents and updateAgents kernels
+ */
+void killUpdateJob(UINT tid, UINT begin, UINT end, void* arg) {
+	struct HostState* hs = (struct HostState*)arg;
+	struct HostPartial* partial = &hs->partial[tid];
+	struct EggsNbiomass enb = hs->enb;
+	memset(&partial->bnc, 0, sizeof(struct BitesNcycles));
+
+	for(UINT s = 0; s < NUM_STATES; ++s) {
+		UINT lo = max(hs->ranges[s].start, begin);
+		UINT hi = min(hs->ranges[s].end, end);
+		if(lo >= hi) continue;
+
+		// the parts of the update done for every agent run as separate passes over the range. The agents killed in the first pass are aged as well,
+		// which does not matter since they are dropped by the compaction
+		hostKernels.kill(hs->agentAges, hs->agentStates, lo, hi, s, hs->mortality, &hs->seeds[0]);
+		hostKernels.age(hs->agentAges, lo, hi, hs->elapsedTimeInHours);
+		if(s == 1)
+			hostKernels.developLarvae(hs->agents, lo, hi, larvaDevelopment(hs->temperature));
+
+		for(UINT i = lo; i < hi; ++i)
+			updateAgent(hs, i, s, partial, &enb);
+	}
+
+	partial->newEggs = enb.newEggs;
+}
+
+void createEggsJob(UINT tid, UINT begin, UINT end, void* arg) {
+	struct HostState* hs = (struct HostState*)arg;
+	for(UINT i = begin; i < end; ++i)
+		initAgent(hs, i);
+}
+
+/*
+ * counts the living agents of each state in the chunk of the calling thread
+ */
+void countJob(UINT tid, UINT begin, UINT end, void* arg) {
+	struct HostState* hs = (struct HostState*)arg;
+	UINT* counts = hs->partial[tid].counts;
+	memset(counts, 0, NUM_STATES * sizeof(UINT));
+
+	for(UINT s = 0; s < NUM_STATES; ++s) {
+		UINT lo = max(hs->ranges[s].start, begin);
+		UINT hi = min(hs->ranges[s].end, end);
+		for(UINT i = lo; i < hi; ++i) {
+			struct AgentState agentState = hs->agentStates[i];
+			if(!agentState.dead)
+				++counts[__builtin_ctz(agentState.state)];
+		}
+	}
+}
+
+/*
+ * copies the living agents to the new arrays, using the offsets calculated from the counts of all threads. Keeps the order of the agents like the
+ * prefix sums of the oldToNewAgents kernel
+ */
+void scatterJob(UINT tid, UINT begin, UINT end, void* arg) {
+	struct HostState* hs = (struct HostState*)arg;
+	UINT* offsets = hs->partial[tid].offsets;
+
+	for(UINT s = 0; s < NUM_STATES; ++s) {
+		UINT lo = max(hs->ranges[s].start, begin);
+		UINT hi = min(hs->ranges[s].end, end);
+		for(UINT i = lo; i < hi; ++i) {
+			struct AgentState agentState = hs->agentStates[i];
+			if(agentState.dead) continue;
+
+			UINT newIdx = offsets[__builtin_ctz(agentState.state)]++;
+			hs->newAgents[newIdx] = hs->agents[i];
+			hs->newAgentAges[newIdx] = hs->agentAges[i];
+			hs->newAgentStates[newIdx] = agentState;
+		}
+	}
+}
+
+/*
+ * touches the agent arrays from the threads that will work on them, in order to place the memory pages close to them
+ */
+void firstTouchJob(UINT tid, UINT begin, UINT end, void* arg) {
+	struct HostState* hs = (struct HostState*)arg;
+	memset(hs->agents + begin, 0, (end - begin) * sizeof(struct Agent));
+	memset(hs->agentAges + begin, 0, (end - begin) * sizeof(struct AgentAge));
+	memset(hs->agentStates + begin, 0, (end - begin) * sizeof(struct AgentState));
+	memset(hs->newAgents + begin, 0, (end - begin) * sizeof(struct Agent));
+	memset(hs->newAgentAges + begin, 0, (end - begin) * sizeof(struct AgentAge));
+	memset(hs->newAgentStates + begin, 0, (end - begin) * sizeof(struct AgentState));
+}
+
+/*
+ * calculates the ranges of the next iteration's population in the same way as the oldToNewAgents kernel and the offset of each thread in them
+ */
+void calcNewRanges(struct HostState* hs, UINT numThreads, UINT capacity) {
+	UINT start = 0;
+	UINT firstIdx = hs->enb.newEggs; // new eggs are already at the beginning of the new arrays
+	for(UINT s = 0; s < NUM_STATES; ++s) {
+		UINT total = 0;
+		for(UINT t = 0; t < numThreads; ++t) {
+			hs->partial[t].offsets[s] = start + firstIdx + total;
+			total += hs->partial[t].counts[s];
+		}
+		hs->newRanges[s].start = start;
+		hs->newRanges[s].end = start + firstIdx + total;
+		assert(hs->newRanges[s].end <= capacity && "not enough capacity");
+
+		// assure a space between states of at least one
+		start = ALIGN_RANGE(hs->newRanges[s].end);
+		firstIdx = 0;
+	}
+}
+
+/*
+ * sets the key of the random number generator to the run seed, like initSeeds on the device. The time step counter z3 starts at 0 for the initial
+ * population and is advanced once per time step
+ */
+void initHostSeeds(struct Seeds* seeds, UINT nSeeds, unsigned long long runSeed) {
+	for(UINT i = 0; i < nSeeds; ++i) {
+		seeds[i].z1 = (UINT)runSeed;
+		seeds[i].z2 = (UINT)(runSeed >> 32);
+		seeds[i].z3 = 0;
+		seeds[i].z4 = i;
+	}
+}
+
+void advanceHostSeeds(struct Seeds* seeds, UINT nSeeds) {
+	for(UINT i = 0; i < nSeeds; ++i)
+		++seeds[i].z3;
+}
+
+void swapArrays(void** a, void** b) {
+	void* tmp = *a;
+	*a = *b;
+	*b = tmp;
+}
+
+void hostStoreHistogram(struct HostState* hs) {
+	UINT histogram[100];
+	memset(histogram, 0, sizeof(histogram));
+
+	for(UINT s = 3; s < NUM_STATES; ++s)
+		for(UINT i = hs->ranges[s].start; i < hs->ranges[s].end; ++i)
+			++histogram[min((UINT)(hs->agentAges[i].ageInHours/24.0f), 99u)];
+
+	FILE* hFile = fopen("histogram.txt", "w");
+	for(UINT i = 0u; i < 100u; ++i)
+		fprintf(hFile, "%d, ", histogram[i]);
+
+	fclose(hFile);
+}
+
+/*
+ * doubles the capacity of the agent arrays. The current agents are kept, the arrays of the next population are reallocated without copying
+ */
+void hostGrow(struct HostState* hs, UINT capacity) {
+	hs->agents = (struct Agent*)realloc(hs->agents, capacity * sizeof(struct Agent));
+	hs->agentAges = (struct AgentAge*)realloc(hs->agentAges, capacity * sizeof(struct AgentAge));
+	hs->agentStates = (struct AgentState*)realloc(hs->agentStates, capacity * sizeof(struct AgentState));
+	free(hs->newAgents);
+	free(hs->newAgentAges);
+	free(hs->newAgentStates);
+	hs->newAgents = (struct Agent*)malloc(capacity * sizeof(struct Agent));
+	hs->newAgentAges = (struct AgentAge*)malloc(capacity * sizeof(struct AgentAge));
+	hs->newAgentStates = (struct AgentState*)malloc(capacity * sizeof(struct AgentState));
+	assert(hs->agents && hs->agentAges && hs->agentStates && hs->newAgents && hs->newAgentAges && hs->newAgentStates && "out of memory");
+	hostGlobalSize = capacity;
+}
+
+unsigned long long hostRun(UINT numThreads, UINT capacity, UINT initialAgentCount, struct Environment* environment, Temperature* temperature,
+		UINT numSteps, REAL hoursInTimeStep, UINT nSeeds, unsigned long long runSeed, HostStatsCallback report, struct Population* pop) {
+	if(numThreads == 0)
+		numThreads = hostDefaultThreads();
+	poolInit(numThreads);
+	hostKernels = selectHostKernels();
+
+	struct HostState hs;
+	hs.agents = (struct Agent*)malloc(capacity * sizeof(struct Agent));
+	hs.agentAges = (struct AgentAge*)malloc(capacity * sizeof(struct AgentAge));
+	hs.agentStates = (struct AgentState*)malloc(capacity * sizeof(struct AgentState));
+	hs.newAgents = (struct Agent*)malloc(capacity * sizeof(struct Agent));
+	hs.newAgentAges = (struct AgentAge*)malloc(capacity * sizeof(struct AgentAge));
+	hs.newAgentStates = (struct AgentState*)malloc(capacity * sizeof(struct AgentState));
+	hs.seeds = (struct Seeds*)malloc(max(nSeeds, 4u) * sizeof(struct Seeds));
+	hs.partial = (struct HostPartial*)calloc(numThreads, sizeof(struct HostPartial));
+	assert(hs.agents && hs.agentAges && hs.agentStates && hs.newAgents && hs.newAgentAges && hs.newAgentStates && "out of memory");
+	parallelFor(firstTouchJob, capacity, &hs);
+
+	hs.elapsedTimeInHours = hoursInTimeStep;
+	hostGlobalSize = capacity;
+
+	// create initial population in the new arrays, like createInitialPopulation
+	assert(initialAgentCount + 1 <= capacity && "not enough capacity");
+	initHostSeeds(hs.seeds, max(nSeeds, 4u), runSeed);
+	hs.temperature = temperature[0];
+	parallelFor(createEggsJob, initialAgentCount, &hs);
+	swapArrays((void**)&hs.agents, (void**)&hs.newAgents);
+	swapArrays((void**)&hs.agentAges, (void**)&hs.newAgentAges);
+	swapArrays((void**)&hs.agentStates, (void**)&hs.newAgentStates);
+
+	UINT initVal = initialAgentCount + 1;
+	for(UINT s = 0; s < NUM_STATES; ++s) {
+		hs.ranges[s].start = s == 0 ? 0u : initVal;
+		hs.ranges[s].end = s == 0 ? initialAgentCount : initVal;
+	}
+	setRanges(&hs.pop, hs.ranges);
+
+	struct BitesNcycles bnc;
+	memset(&bnc, 0, sizeof(bnc));
+	unsigned long long updates = 0;
+	for(UINT currentStep = 0; currentStep < numSteps; ++currentStep) {
+		// like on the device, the capacity is doubled once the agents occupy GROWTH_THRESHOLD of it
+		if(hs.ranges[NUM_STATES-1].end > capacity * GROWTH_THRESHOLD) {
+			capacity *= 2;
+			hostGrow(&hs, capacity);
+		}
+
+		// statistics
+		parallelFor(statsJob, hs.ranges[NUM_STATES-1].end, &hs);
+		hs.pop.numLarvae1DayEquiv = 0;
+		hs.pop.numFemale = 0;
+		hs.pop.numPotentiallyInfective = 0;
+		for(UINT t = 0; t < numThreads; ++t) {
+			hs.pop.numLarvae1DayEquiv += hs.partial[t].numLarvae1DayEquiv;
+			hs.pop.numFemale += hs.partial[t].numFemale;
+			hs.pop.numPotentiallyInfective += hs.partial[t].numPotentiallyInfective;
+		}
+
+		struct Stats stats = populationStats(&hs.pop);
+		UINT nAgents = numAgents(&stats);
+		assert(nAgents <= capacity * 0.95 && "not enough capacity");
+		assert(nAgents > 0 && "No more agents left");
+		updates += nAgents;
+
+		// like the OpenCL version, the statistics of a step report the bites and cycles of the previous one
+		if(report)
+			report(&stats, &bnc, currentStep);
+
+		// update
+		advanceHostSeeds(hs.seeds, max(nSeeds, 4u));
+		hs.environment = environment[currentStep];
+		hs.temperature = temperature[currentStep];
+		hs.worldTime = (UINT)(currentStep * hoursInTimeStep)%24u;
+		hs.enb.newEggs = 0;
+		hs.enb.totalBiomass = hs.pop.numLarvae1DayEquiv + (hs.pop.eggs.end) + (hs.pop.pupae.end - hs.pop.pupae.start);
+		tabulateHostMortality(&hs);
+
+		parallelFor(killUpdateJob, hs.ranges[NUM_STATES-1].end, &hs);
+		memset(&bnc, 0, sizeof(bnc));
+		for(UINT t = 0; t < numThreads; ++t) {
+			hs.enb.newEggs += hs.partial[t].newEggs;
+			bnc.numBitesReported += hs.partial[t].bnc.numBitesReported;
+			bnc.numInfectBitesReported += hs.partial[t].bnc.numInfectBitesReported;
+			bnc.numCyclesReported += hs.partial[t].bnc.numCyclesReported;
+			bnc.sumCyclesReported += hs.partial[t].bnc.sumCyclesReported;
+		}
+
+		// create new agents
+		assert(hs.enb.newEggs <= capacity && "not enough capacity");
+		parallelFor(createEggsJob, hs.enb.newEggs, &hs);
+
+		parallelFor(countJob, hs.ranges[NUM_STATES-1].end, &hs);
+		calcNewRanges(&hs, numThreads, capacity);
+		parallelFor(scatterJob, hs.ranges[NUM_STATES-1].end, &hs);
+
+		swapArrays((void**)&hs.agents, (void**)&hs.newAgents);
+		swapArrays((void**)&hs.agentAges, (void**)&hs.newAgentAges);
+		swapArrays((void**)&hs.agentStates, (void**)&hs.newAgentStates);
+		memcpy(hs.ranges, hs.newRanges, sizeof(hs.ranges));
+		setRanges(&hs.pop, hs.ranges);
+	}
+
+	*pop = hs.pop;
+	hostStoreHistogram(&hs);
+
+	poolRelease();
+	free(hs.agents);
+	free(hs.agentAges);
+	free(hs.agentStates);
+	free(hs.newAgents);
+	free(hs.newAgentAges);
+	free(hs.newAgentStates);
+	free(hs.seeds);
+	free(hs.partial);
+
+	return updates;
+}
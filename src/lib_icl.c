@@ -17,8 +17,25 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+	#include <dirent.h>
+	#include <unistd.h>
+#else
+	#include <process.h>
+	#define getpid _getpid
+#endif
 #include "lib_icl.h"
 
+#ifndef S_ISREG
+	#define S_ISREG(mode) (((mode) & S_IFMT) == S_IFREG)
+#endif
+
+#define ICL_BINARY_MAGIC "ICLB1"
+#define ICL_HASH_INIT 14695981039346656037ull
+#define ICL_MAX_INCLUDE_DIRS 16
+#define ICL_MAX_INCLUDE_FILES 256
+
 /*
  * =====================================================================================
  *  OpenCL Static Internal Functions Declarations
@@ -66,7 +83,11 @@ static cl_device_local_mem_type _icl_get_local_mem_type(cl_device_id* device);
 static cl_ulong _icl_get_local_mem_size(cl_device_id* device);
 
 static char* _icl_load_program_source (const char* filename, size_t* filesize);
-static void _icl_save_program_binary (cl_program program, const char* binary_filename);
+static bool _icl_is_regular_file (const char* filename);
+static cl_ulong _icl_hash_bytes (cl_ulong hash, const void* data, size_t size);
+static cl_ulong _icl_get_program_key (icl_device* dev, const char* filename, const char* source, const char* build_options);
+static cl_program _icl_load_program_binary (icl_device* dev, const char* binary_filename, cl_ulong key, const char* build_options);
+static void _icl_save_program_binary (cl_program program, const char* binary_filename, cl_ulong key);
 static const char* _icl_error_string (cl_int err_code);
 static inline cl_profiling_info _icl_flag_to_profile(icl_event_flag event_flag);
 
@@ -318,6 +339,16 @@ inline void icl_copy_buffer(icl_buffer* src_buf, icl_buffer* dest_buf, size_t si
 	ICL_ASSERT(err_code == CL_SUCCESS, "Error copying buffer: \"%s\"",  _icl_error_string(err_code));
 }
 
+inline void icl_copy_buffer_offset(icl_buffer* src_buf, icl_buffer* dest_buf, size_t src_offset, size_t dest_offset, size_t size, icl_event* wait_event,
+		icl_event* event) {
+	cl_event* ev = NULL; cl_event* wait_ev = NULL; cl_uint num = 0;
+	_icl_set_event(wait_event, event, &wait_ev, &ev, &num);
+
+	ICL_ASSERT(src_buf->dev->queue  == dest_buf->dev->queue, "Error: source and destination buffer have a different queue");
+	cl_int err_code = clEnqueueCopyBuffer(src_buf->dev->queue, src_buf->mem, dest_buf->mem, src_offset, dest_offset, size, num, wait_ev, ev);
+	ICL_ASSERT(err_code == CL_SUCCESS, "Error copying buffer: \"%s\"",  _icl_error_string(err_code));
+}
+
 /*
  * =====================================================================================
  *  OpenCL Print & Profile Functions
@@ -558,18 +589,15 @@ void icl_release_timer(icl_timer* timer){
 icl_kernel*  icl_create_kernel(icl_device* dev, const char* file_name, const char* kernel_name, const char* build_options, icl_create_kernel_flag flag) {
 	cl_program program = NULL;
 	char* binary_name = NULL;
+	char* program_source = NULL;
+	cl_ulong binary_key = 0;
 	size_t filesize = 0;
 	cl_int err_code;
-	if (flag != ICL_STRING) {
+	if (build_options == NULL)
+		build_options = "";
+	if ((flag == ICL_SOURCE) || (flag == ICL_BINARY)) {
 		// create the binary name
-		size_t len, binary_name_size, cl_param_size;
-		char* device_name;
-		err_code = clGetDeviceInfo(dev->device, CL_DEVICE_NAME, 0, NULL, &cl_param_size);
-		ICL_ASSERT(err_code == CL_SUCCESS, "Error getting device name: \"%s\"", _icl_error_string(err_code));
-		device_name = (char*)alloca(cl_param_size);
-		err_code = clGetDeviceInfo(dev->device, CL_DEVICE_NAME, cl_param_size, device_name, NULL);
-		ICL_ASSERT(err_code  == CL_SUCCESS, "Error getting device name: \"%s\"", _icl_error_string(err_code));
-
+		size_t len, binary_name_size;
 		const char* file_ptr = strrchr(file_name, '/'); // remove the path from the file_name
 		if (file_ptr)
 			file_ptr++; // remove the last '/'
@@ -588,32 +616,42 @@ icl_kernel*  icl_create_kernel(icl_device* dev, const char* file_name, const cha
 		}
 		binary_name_size = len;
 
-		len = strlen(device_name);
+		len = strlen(dev->name);
 		char* converted_device_name = (char*)alloca(len + 1); // +1 for the \0 in the end
-		strcpy (converted_device_name, device_name);
+		strcpy (converted_device_name, dev->name);
 		for (size_t i = 0; i < len; ++i) {
 			if (!isalnum ((int)converted_device_name[i])) {
 				converted_device_name[i] = '_';
 			}
 		}
 		binary_name_size += len;
-		binary_name_size += 6; // file_name.device_name.bin\0
+		binary_name_size += strlen(ICL_BINARY_CACHE_PATH);
+		binary_name_size += 16; // path/file_name.device_name.options.bin\0
 
 		binary_name = (char*)alloca(binary_name_size);
 
-		sprintf (binary_name, "%s.%s.bin", converted_file_name, converted_device_name);
+		// one cache slot per kernel file, device and set of build options. A slot holding a binary for an outdated source or driver is replaced
+		sprintf (binary_name, "%s%s.%s.%08x.bin", ICL_BINARY_CACHE_PATH, converted_file_name, converted_device_name,
+				(cl_uint)_icl_hash_bytes(ICL_HASH_INIT, build_options, strlen(build_options)));
 		//printf("%s\n", binary_name);
+
+		program_source = _icl_load_program_source(file_name, &filesize);
+		ICL_ASSERT(program_source != NULL, "Error loading kernel program source");
+		binary_key = _icl_get_program_key(dev, file_name, program_source, build_options);
+
+		program = _icl_load_program_binary(dev, binary_name, binary_key, build_options);
+		ICL_ASSERT(program != NULL || flag != ICL_BINARY, "Error loading program binary %s", binary_name);
 	}
-	if ((flag == ICL_SOURCE) || (flag == ICL_STRING)) {
-		if (flag == ICL_SOURCE) {
-			char* program_source = _icl_load_program_source(file_name, &filesize);
+	if (program == NULL) { // cache miss, stale cache entry or uncached build
+		if (flag == ICL_STRING) { // case of ICL_STRING we use the file_name to pass the string
+			program = clCreateProgramWithSource (dev->context, 1, (const char **) &file_name, NULL, &err_code);
+			ICL_ASSERT(err_code == CL_SUCCESS && program != NULL, "Error creating compute program: \"%s\"", _icl_error_string(err_code));
+		} else {
+			if (program_source == NULL)
+				program_source = _icl_load_program_source(file_name, &filesize);
 			ICL_ASSERT(program_source != NULL, "Error loading kernel program source");
 			program = clCreateProgramWithSource (dev->context, 1, (const char **) &program_source, NULL, &err_code);
 			ICL_ASSERT(err_code == CL_SUCCESS && program != NULL, "Error creating compute program: \"%s\"", _icl_error_string(err_code));
-			free(program_source);
-		} else { // case of ICL_STRING we use the file_name to pass the string
-			program = clCreateProgramWithSource (dev->context, 1, (const char **) &file_name, NULL, &err_code);
-			ICL_ASSERT(err_code == CL_SUCCESS && program != NULL, "Error creating compute program: \"%s\"", _icl_error_string(err_code));
 		}
 
 		err_code = clBuildProgram(program, 1, &(dev->device), build_options, NULL, NULL);
@@ -633,19 +671,10 @@ icl_kernel*  icl_create_kernel(icl_device* dev, const char* file_name, const cha
 			free(buildLog);
 		}
 		ICL_ASSERT(err_code == CL_SUCCESS, "Error building compute program: \"%s\"", _icl_error_string(err_code));
-	}
-
-	if (flag == ICL_SOURCE) _icl_save_program_binary(program, binary_name); // We don't save in case of ICL_STRING
 
-	if (flag == ICL_BINARY) {
-		cl_int binary_status;
-		unsigned char* program_s = (unsigned char*) _icl_load_program_source(binary_name, &filesize);
-		program = clCreateProgramWithBinary (dev->context, 1, &(dev->device), &filesize, (const unsigned char **) &program_s, &binary_status, &err_code);
-		free(program_s);
-		ICL_ASSERT(err_code == CL_SUCCESS && binary_status == CL_SUCCESS && program != NULL, "Error creating compute program: \"%s\"", _icl_error_string(err_code));
-		err_code = clBuildProgram(program, 1, &(dev->device), build_options, NULL, NULL);
-		ICL_ASSERT(err_code == CL_SUCCESS, "Error building compute program: \"%s\"", _icl_error_string(err_code));
+		if (flag == ICL_SOURCE) _icl_save_program_binary(program, binary_name, binary_key); // We don't save in case of ICL_STRING and ICL_NO_CACHE
 	}
+	free(program_source);
 
 	icl_kernel* kernel = NULL;
 	if ((kernel_name != NULL) && (*kernel_name != 0)) {
@@ -765,7 +794,208 @@ static char* _icl_load_program_source (const char* filename, size_t* filesize) {
 	return source;
 }
 
-static void _icl_save_program_binary (cl_program program, const char* binary_filename) {
+static bool _icl_is_regular_file (const char* filename) {
+	struct stat file_stat;
+	return stat(filename, &file_stat) == 0 && S_ISREG(file_stat.st_mode);
+}
+
+/*
+ * FNV-1a hash, used to identify cached program binaries
+ */
+static cl_ulong _icl_hash_bytes (cl_ulong hash, const void* data, size_t size) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+typedef struct _icl_source_tree {
+	const char* include_dirs[ICL_MAX_INCLUDE_DIRS];
+	cl_uint num_include_dirs;
+	char* visited[ICL_MAX_INCLUDE_FILES];
+	cl_uint num_visited;
+	bool computed_include;
+} _icl_source_tree;
+
+static void _icl_hash_source_file (_icl_source_tree* tree, const char* filename, const char* source, cl_ulong* hash);
+
+/*
+ * looks up an included file in the directory of the including file and in all -I directories. Every file is hashed only once
+ */
+static void _icl_hash_include (_icl_source_tree* tree, const char* parent, const char* name, size_t name_len, cl_ulong* hash) {
+	char path[1024];
+	const char* parent_end = strrchr(parent, '/');
+	for (int i = -1; i < (int)tree->num_include_dirs; ++i) {
+		if (i < 0)
+			snprintf(path, sizeof(path), "%.*s%.*s", parent_end ? (int)(parent_end - parent + 1) : 0, parent, (int)name_len, name);
+		else
+			snprintf(path, sizeof(path), "%s/%.*s", tree->include_dirs[i], (int)name_len, name);
+
+		if (!_icl_is_regular_file(path))
+			continue;
+
+		for (cl_uint j = 0; j < tree->num_visited; ++j)
+			if (strcmp(tree->visited[j], path) == 0)
+				return;
+		ICL_ASSERT(tree->num_visited < ICL_MAX_INCLUDE_FILES, "Error hashing kernel program: too many included files");
+		tree->visited[tree->num_visited] = (char*)malloc(strlen(path) + 1);
+		strcpy(tree->visited[tree->num_visited++], path);
+
+		size_t filesize;
+		char* source = _icl_load_program_source(path, &filesize);
+		_icl_hash_source_file(tree, path, source, hash);
+		free(source);
+		return;
+	}
+	// not found on the host, e.g. a header provided by the OpenCL implementation. Its name is still part of the key
+	*hash = _icl_hash_bytes(*hash, name, name_len);
+}
+
+static void _icl_hash_source_file (_icl_source_tree* tree, const char* filename, const char* source, cl_ulong* hash) {
+	*hash = _icl_hash_bytes(*hash, source, strlen(source) + 1);
+
+	for (const char* line = source; line != NULL && *line != '\0'; line = strchr(line, '\n'), line = line ? line + 1 : NULL) {
+		const char* c = line;
+		while (*c == ' ' || *c == '\t') ++c;
+		if (*c++ != '#') continue;
+		while (*c == ' ' || *c == '\t') ++c;
+		if (strncmp(c, "include", 7) != 0) continue;
+		c += 7;
+		while (*c == ' ' || *c == '\t') ++c;
+
+		if (*c == '"' || *c == '<') {
+			const char* end = strchr(c + 1, *c == '"' ? '"' : '>');
+			if (end != NULL)
+				_icl_hash_include(tree, filename, c + 1, end - c - 1, hash);
+		} else {
+			// file name is given by a macro, e.g. set via -D. It is unknown which headers will be included
+			tree->computed_include = true;
+		}
+	}
+}
+
+/*
+ * hashes all regular files in dir, independent of the order in which the directory is listed
+ */
+static cl_ulong _icl_hash_directory (const char* dir) {
+	cl_ulong sum = 0;
+	char path[1024];
+	size_t filesize;
+#ifndef _WIN32
+	DIR* dp = opendir(dir);
+	if (dp == NULL)
+		return sum;
+	struct dirent* entry;
+	while ((entry = readdir(dp)) != NULL) {
+		const char* entry_name = entry->d_name;
+#else
+	WIN32_FIND_DATAA entry;
+	snprintf(path, sizeof(path), "%s/*", dir);
+	HANDLE dp = FindFirstFileA(path, &entry);
+	if (dp == INVALID_HANDLE_VALUE)
+		return sum;
+	do {
+		const char* entry_name = entry.cFileName;
+#endif
+		if (entry_name[0] == '.') continue;
+		snprintf(path, sizeof(path), "%s/%s", dir, entry_name);
+		if (!_icl_is_regular_file(path)) continue;
+
+		char* source = _icl_load_program_source(path, &filesize);
+		cl_ulong file_hash = _icl_hash_bytes(ICL_HASH_INIT, entry_name, strlen(entry_name) + 1);
+		sum += _icl_hash_bytes(file_hash, source, filesize);
+		free(source);
+#ifndef _WIN32
+	}
+	closedir(dp);
+#else
+	} while (FindNextFileA(dp, &entry));
+	FindClose(dp);
+#endif
+	return sum;
+}
+
+/*
+ * calculates the key identifying a program binary: the kernel source including all headers it includes, the build options, the device name and the
+ * driver version
+ */
+static cl_ulong _icl_get_program_key (icl_device* dev, const char* filename, const char* source, const char* build_options) {
+	_icl_source_tree tree;
+	tree.num_include_dirs = 0;
+	tree.num_visited = 0;
+	tree.computed_include = false;
+
+	// collect the -I directories of the build options
+	size_t options_len = strlen(build_options);
+	char* options = (char*)alloca(options_len + 1);
+	strcpy(options, build_options);
+	for (char* token = strtok(options, " \t"); token != NULL; token = strtok(NULL, " \t")) {
+		if (strncmp(token, "-I", 2) != 0) continue;
+		const char* dir = token[2] != '\0' ? token + 2 : strtok(NULL, " \t");
+		if (dir != NULL && tree.num_include_dirs < ICL_MAX_INCLUDE_DIRS)
+			tree.include_dirs[tree.num_include_dirs++] = dir;
+	}
+
+	cl_ulong hash = ICL_HASH_INIT;
+	_icl_hash_source_file(&tree, filename, source, &hash);
+	if (tree.computed_include)
+		for (cl_uint i = 0; i < tree.num_include_dirs; ++i)
+			hash ^= _icl_hash_directory(tree.include_dirs[i]);
+
+	hash = _icl_hash_bytes(hash, build_options, options_len + 1);
+	hash = _icl_hash_bytes(hash, dev->name, strlen(dev->name) + 1);
+	hash = _icl_hash_bytes(hash, dev->driver_version, strlen(dev->driver_version) + 1);
+
+	for (cl_uint i = 0; i < tree.num_visited; ++i)
+		free(tree.visited[i]);
+	return hash;
+}
+
+/*
+ * loads and builds a program binary stored by _icl_save_program_binary. Returns NULL if the file does not exist, was created with a different key or is
+ * rejected by the OpenCL implementation
+ */
+static cl_program _icl_load_program_binary (icl_device* dev, const char* binary_filename, cl_ulong key, const char* build_options) {
+	FILE* fp = fopen(binary_filename, "rb");
+	if (fp == NULL)
+		return NULL;
+
+	char magic[sizeof(ICL_BINARY_MAGIC)];
+	cl_ulong stored_key;
+	unsigned char* binary = NULL;
+	size_t binary_size = 0;
+	bool valid = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) && memcmp(magic, ICL_BINARY_MAGIC, sizeof(magic)) == 0 &&
+			fread(&stored_key, sizeof(stored_key), 1, fp) == 1 && stored_key == key;
+	if (valid) {
+		long start = ftell(fp);
+		valid = fseek(fp, 0, SEEK_END) == 0;
+		binary_size = ftell(fp) - start;
+		valid = valid && binary_size > 0 && fseek(fp, start, SEEK_SET) == 0;
+	}
+	if (valid) {
+		binary = (unsigned char*)malloc(binary_size);
+		valid = fread(binary, 1, binary_size, fp) == binary_size;
+	}
+	fclose(fp);
+
+	cl_program program = NULL;
+	if (valid) {
+		cl_int binary_status, err_code;
+		program = clCreateProgramWithBinary (dev->context, 1, &(dev->device), &binary_size, (const unsigned char **) &binary, &binary_status, &err_code);
+		if (err_code != CL_SUCCESS || binary_status != CL_SUCCESS || program == NULL ||
+				clBuildProgram(program, 1, &(dev->device), build_options, NULL, NULL) != CL_SUCCESS) {
+			if (program != NULL)
+				clReleaseProgram(program);
+			program = NULL;
+		}
+	}
+	free(binary);
+	return program;
+}
+
+static void _icl_save_program_binary (cl_program program, const char* binary_filename, cl_ulong key) {
 	ICL_ASSERT(binary_filename != NULL && program != NULL, "Error input parameters");
 	size_t size_ret;
 	cl_int err_code;
@@ -775,17 +1005,34 @@ static void _icl_save_program_binary (cl_program program, const char* binary_fil
 	ICL_ASSERT(binary_size != NULL, "Error allocating binary_size");
 	err_code = clGetProgramInfo (program, CL_PROGRAM_BINARY_SIZES, size_ret, binary_size, NULL);
 	ICL_ASSERT(err_code == CL_SUCCESS,  "Error getting program info: \"%s\"", _icl_error_string(err_code));
-    	unsigned char* binary = (unsigned char *) alloca (sizeof (unsigned char) * (*binary_size));
+	unsigned char* binary = (unsigned char *) malloc (sizeof (unsigned char) * (*binary_size));
 	ICL_ASSERT(binary != NULL, "Error allocating binary");
 
 	// get the binary
 	err_code = clGetProgramInfo (program, CL_PROGRAM_BINARIES, sizeof (unsigned char *), &binary, NULL);
 	ICL_ASSERT(err_code == CL_SUCCESS,  "Error getting program info: \"%s\"", _icl_error_string(err_code));
 
-	FILE *fp = fopen (binary_filename, "w");
-	ICL_ASSERT(fp != NULL, "Error opening binary file");
+	// write to a temporary file first, several processes and several threads of one process may share the cache
+	static unsigned int tmp_count = 0;
+	char* tmp_filename = (char*)alloca(strlen(binary_filename) + 48);
+	sprintf(tmp_filename, "%s.%d.%u.tmp", binary_filename, (int)getpid(), __sync_fetch_and_add(&tmp_count, 1u));
+	FILE *fp = fopen (tmp_filename, "wb");
+	if (fp == NULL) { // the cache is optional, e.g. the cache directory may be read only
+		free(binary);
+		return;
+	}
+	ICL_ASSERT(fwrite (ICL_BINARY_MAGIC, 1, sizeof(ICL_BINARY_MAGIC), fp) == sizeof(ICL_BINARY_MAGIC), "Error writing file");
+	ICL_ASSERT(fwrite (&key, sizeof(key), 1, fp) == 1, "Error writing file");
 	ICL_ASSERT(fwrite (binary, 1, *binary_size, fp) ==  (size_t) *binary_size, "Error writing file");
 	ICL_ASSERT(fclose (fp) == 0, "Error closing the file");
+	free(binary);
+
+	// replaces stale binaries
+#ifdef _WIN32
+	remove(binary_filename);
+#endif
+	if (rename(tmp_filename, binary_filename) != 0)
+		remove(tmp_filename);
 }
 
 static const char* _icl_error_string (cl_int errcode) {
@@ -0,0 +1,41 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ */
+
+#include "device_types.h"
+#include "stats.h"
+
+#define max(a, b) ((a > b) ? a : b)
+
+UINT calcNum(struct AgentRange range) {
+	return range.end - range.start;
+}
+
+struct Stats populationStats(struct Population* pop) {
+	UINT upperBound = max(pop->immatures.end, max(pop->bmSeekings.end, max(pop->bmDigestings.end, pop->gravids.end)));
+	UINT adultsRange = upperBound - pop->immatures.start;
+
+	struct Stats stats;
+	stats.numEggs = calcNum(pop->eggs);
+	stats.numLarvae = calcNum(pop->larvae);
+	stats.numPupae = calcNum(pop->pupae);
+	stats.numImmature = calcNum(pop->immatures);
+	stats.numMating = calcNum(pop->mateSeekings);
+	stats.numBMS = calcNum(pop->bmSeekings);
+	stats.numBMD = calcNum(pop->bmDigestings);
+	stats.numOVI = calcNum(pop->gravids);
+
+	stats.numLarvae1DazEquiv = (stats.numLarvae > 0) ? pop->numLarvae1DayEquiv : 0;
+	stats.numBiomass = stats.numLarvae1DazEquiv + stats.numEggs + stats.numPupae;
+
+	stats.numFemales = adultsRange > 0 ? pop->numFemale : 0;
+	stats.numPotentiallyInfective = adultsRange > 0 ? pop->numPotentiallyInfective : 0;
+	stats.numMales = (stats.numImmature + stats.numMating + stats.numBMS + stats.numBMD + stats.numOVI) - stats.numFemales;
+
+	return stats;
+}
+
+UINT numAgents(struct Stats* stats) {
+	return stats->numEggs + stats->numLarvae + stats->numPupae + stats->numImmature + stats->numMating + stats->numBMS + stats->numBMD + stats->numOVI;
+}
@@ -0,0 +1,89 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ *
+ * converts a binary statistics file written with -stats to CSV, one line per row with the column names in the first line
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "device_types.h"
+#include "statsWriter.h"
+
+int main(int argc, char **argv) {
+	if(argc < 2) {
+		printf("Usage: bin\\statsToCsv statsFileName [csvFileName]\n");
+		printf("\twrites the CSV to stdout if no CSV file is given\n");
+		return -1;
+	}
+
+	FILE* file = fopen(argv[1], "rb");
+	if(!file) {
+		printf("Cannot open %s\n", argv[1]);
+		return -1;
+	}
+	FILE* csv = argc > 2 ? fopen(argv[2], "w") : stdout;
+	if(!csv) {
+		printf("Cannot create %s\n", argv[2]);
+		fclose(file);
+		return -1;
+	}
+
+	struct StatsFileHeader header;
+	if(fread(&header, sizeof(struct StatsFileHeader), 1, file) != 1 || memcmp(header.magic, "SAMPOST1", 8) != 0) {
+		printf("%s is not a statistics file\n", argv[1]);
+		fclose(file);
+		return -1;
+	}
+
+	struct StatsColumn* columns = (struct StatsColumn*)malloc(header.numColumns * sizeof(struct StatsColumn));
+	if(fread(columns, sizeof(struct StatsColumn), header.numColumns, file) != header.numColumns) {
+		printf("%s is truncated\n", argv[1]);
+		free(columns);
+		fclose(file);
+		return -1;
+	}
+	for(UINT c = 0; c < header.numColumns; ++c)
+		fprintf(csv, c == 0 ? "%s" : ", %s", columns[c].name);
+	fprintf(csv, "\n");
+
+	UINT capacity = 0;
+	UINT* block = NULL;
+	UINT numRows;
+	int err = 0;
+	while(fread(&numRows, sizeof(UINT), 1, file) == 1) {
+		if(numRows > capacity) {
+			capacity = numRows;
+			block = (UINT*)realloc(block, header.numColumns * capacity * sizeof(UINT));
+		}
+		if(fread(block, sizeof(UINT), header.numColumns * numRows, file) != header.numColumns * numRows) {
+			printf("%s is truncated\n", argv[1]);
+			err = -1;
+			break;
+		}
+
+		for(UINT r = 0; r < numRows; ++r) {
+			for(UINT c = 0; c < header.numColumns; ++c) {
+				UINT* value = &block[c * numRows + r];
+				if(c > 0)
+					fprintf(csv, ", ");
+				if(columns[c].type == STATS_COLUMN_REAL) {
+					REAL real;
+					memcpy(&real, value, sizeof(REAL));
+					fprintf(csv, "%0.1f", real);
+				} else
+					fprintf(csv, "%u", *value);
+			}
+			fprintf(csv, "\n");
+		}
+	}
+
+	free(block);
+	free(columns);
+	fclose(file);
+	if(csv != stdout)
+		fclose(csv);
+	return err;
+}
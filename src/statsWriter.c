@@ -0,0 +1,174 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "device_types.h"
+#include "statsWriter.h"
+
+// number of rows in the queue between the simulation and the writer thread, a power of two
+#define STATS_QUEUE_ROWS 8192
+// number of rows written to the file at once
+#define STATS_BLOCK_ROWS 4096
+// time the writer thread sleeps when the queue is empty, and the simulation thread when it is full
+#define STATS_WAIT_NS 1000000
+
+#define NUM_STATS_COLUMNS 23
+
+static const char statsMagic[8] = {'S', 'A', 'M', 'P', 'O', 'S', 'T', '1'};
+
+// name, type and position in struct StatsRow of each column
+static const struct {
+	const char* name;
+	UINT type;
+	size_t offset;
+} statsColumns[NUM_STATS_COLUMNS] = {
+	{"step", STATS_COLUMN_UINT, offsetof(struct StatsRow, step)},
+	{"replicate", STATS_COLUMN_UINT, offsetof(struct StatsRow, replicate)},
+	{"patch", STATS_COLUMN_UINT, offsetof(struct StatsRow, patch)},
+	{"phase", STATS_COLUMN_UINT, offsetof(struct StatsRow, phase)},
+	{"hours", STATS_COLUMN_REAL, offsetof(struct StatsRow, hours)},
+	{"temperature", STATS_COLUMN_REAL, offsetof(struct StatsRow, temperature)},
+	{"eggs", STATS_COLUMN_UINT, offsetof(struct StatsRow, stats.numEggs)},
+	{"larvae", STATS_COLUMN_UINT, offsetof(struct StatsRow, stats.numLarvae)},
+	{"pupae", STATS_COLUMN_UINT, offsetof(struct StatsRow, stats.numPupae)},
+	{"larvae1DayEquiv", STATS_COLUMN_UINT, offsetof(struct StatsRow, stats.numLarvae1DazEquiv)},
+	{"biomass", STATS_COLUMN_UINT, offsetof(struct StatsRow, stats.numBiomass)},
+	{"immatures", STATS_COLUMN_UINT, offsetof(struct StatsRow, stats.numImmature)},
+	{"mateSeekings", STATS_COLUMN_UINT, offsetof(struct StatsRow, stats.numMating)},
+	{"bmSeekings", STATS_COLUMN_UINT, offsetof(struct StatsRow, stats.numBMS)},
+	{"bmDigestings", STATS_COLUMN_UINT, offsetof(struct StatsRow, stats.numBMD)},
+	{"gravids", STATS_COLUMN_UINT, offsetof(struct StatsRow, stats.numOVI)},
+	{"females", STATS_COLUMN_UINT, offsetof(struct StatsRow, stats.numFemales)},
+	{"potentiallyInfective", STATS_COLUMN_UINT, offsetof(struct StatsRow, stats.numPotentiallyInfective)},
+	{"males", STATS_COLUMN_UINT, offsetof(struct StatsRow, stats.numMales)},
+	{"numCyclesReported", STATS_COLUMN_UINT, offsetof(struct StatsRow, bnc.numCyclesReported)},
+	{"sumCyclesReported", STATS_COLUMN_UINT, offsetof(struct StatsRow, bnc.sumCyclesReported)},
+	{"numBitesReported", STATS_COLUMN_UINT, offsetof(struct StatsRow, bnc.numBitesReported)},
+	{"numInfectBitesReported", STATS_COLUMN_UINT, offsetof(struct StatsRow, bnc.numInfectBitesReported)}
+};
+
+/*
+ * single producer, single consumer queue. The simulation thread only writes head, the writer thread only writes tail. Both are increased without
+ * bounds, the position in the queue is taken modulo STATS_QUEUE_ROWS
+ */
+struct StatsWriter {
+	FILE* file;
+	pthread_t thread;
+	struct StatsRow* queue;
+	volatile UINT head;
+	volatile UINT tail;
+	volatile bool closing;
+	UINT* block; // values of STATS_BLOCK_ROWS rows, stored by column
+	UINT blockRows;
+};
+
+static void statsWait() {
+	struct timespec wait = {0, STATS_WAIT_NS};
+	nanosleep(&wait, NULL);
+}
+
+static void writeBlock(struct StatsWriter* writer) {
+	if(writer->blockRows == 0)
+		return;
+
+	fwrite(&writer->blockRows, sizeof(UINT), 1, writer->file);
+	for(UINT c = 0; c < NUM_STATS_COLUMNS; ++c)
+		fwrite(&writer->block[c * STATS_BLOCK_ROWS], sizeof(UINT), writer->blockRows, writer->file);
+	writer->blockRows = 0;
+}
+
+static void* statsWriterThread(void* arg) {
+	struct StatsWriter* writer = (struct StatsWriter*)arg;
+
+	for(;;) {
+		// closing has to be read before head, otherwise rows pushed right before closing could be missed
+		bool closing = writer->closing;
+		__sync_synchronize();
+		UINT head = writer->head;
+		UINT tail = writer->tail;
+		if(head == tail) {
+			if(closing)
+				break;
+			statsWait();
+			continue;
+		}
+
+		for(; tail != head; ++tail) {
+			const char* row = (const char*)&writer->queue[tail % STATS_QUEUE_ROWS];
+			for(UINT c = 0; c < NUM_STATS_COLUMNS; ++c)
+				memcpy(&writer->block[c * STATS_BLOCK_ROWS + writer->blockRows], row + statsColumns[c].offset, sizeof(UINT));
+			if(++writer->blockRows == STATS_BLOCK_ROWS)
+				writeBlock(writer);
+		}
+		// the rows are copied before their slots are released
+		__sync_synchronize();
+		writer->tail = tail;
+	}
+
+	writeBlock(writer);
+	return NULL;
+}
+
+struct StatsWriter* openStatsWriter(const char* path) {
+	FILE* file = fopen(path, "wb");
+	if(!file) {
+		printf("Cannot create %s\n", path);
+		return NULL;
+	}
+
+	struct StatsFileHeader header;
+	memset(&header, 0, sizeof(struct StatsFileHeader));
+	memcpy(header.magic, statsMagic, sizeof(statsMagic));
+	header.numColumns = NUM_STATS_COLUMNS;
+	fwrite(&header, sizeof(struct StatsFileHeader), 1, file);
+	for(UINT c = 0; c < NUM_STATS_COLUMNS; ++c) {
+		struct StatsColumn column;
+		memset(&column, 0, sizeof(struct StatsColumn));
+		strncpy(column.name, statsColumns[c].name, sizeof(column.name) - 1);
+		column.type = statsColumns[c].type;
+		fwrite(&column, sizeof(struct StatsColumn), 1, file);
+	}
+
+	struct StatsWriter* writer = (struct StatsWriter*)malloc(sizeof(struct StatsWriter));
+	writer->file = file;
+	writer->queue = (struct StatsRow*)malloc(STATS_QUEUE_ROWS * sizeof(struct StatsRow));
+	writer->head = 0;
+	writer->tail = 0;
+	writer->closing = false;
+	writer->block = (UINT*)malloc(NUM_STATS_COLUMNS * STATS_BLOCK_ROWS * sizeof(UINT));
+	writer->blockRows = 0;
+	pthread_create(&writer->thread, NULL, statsWriterThread, writer);
+
+	return writer;
+}
+
+void pushStats(struct StatsWriter* writer, struct StatsRow* row) {
+	UINT head = writer->head;
+	while(head - writer->tail == STATS_QUEUE_ROWS)
+		statsWait();
+
+	writer->queue[head % STATS_QUEUE_ROWS] = *row;
+	// the row is complete before the writer thread can see it
+	__sync_synchronize();
+	writer->head = head + 1;
+}
+
+void closeStatsWriter(struct StatsWriter* writer) {
+	__sync_synchronize();
+	writer->closing = true;
+	pthread_join(writer->thread, NULL);
+
+	if(fclose(writer->file) != 0)
+		printf("Cannot write the statistics file\n");
+	free(writer->queue);
+	free(writer->block);
+	free(writer);
+}
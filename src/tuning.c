@@ -0,0 +1,85 @@
+/*
+ * @author      Klaus Kofler
+ * @date		07/01/2013
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "tuning.h"
+#include "agent.h"
+
+// the coarsened loops of the kill and update kernels are vectorized by the compilers of CPU devices, GPUs are faster with a work-item per agent
+#define CPU_COARSENING 16
+// more than one chunk per compute unit balances chunks with many dead agents or gaps
+#define CHUNKS_PER_COMPUTE_UNIT 4
+
+struct WorkSizes defaultWorkSizes(icl_device* dev) {
+	struct WorkSizes sizes;
+	sizes.updateGroupSize = LOCAL_SIZE;
+	sizes.coarsening = (dev->type & CL_DEVICE_TYPE_CPU) ? CPU_COARSENING : 1;
+	sizes.compactionGroupSize = LOCAL_SIZE;
+	sizes.chunksPerComputeUnit = CHUNKS_PER_COMPUTE_UNIT;
+	// the coarsened kernels of CPUs do not need whole groups per range, shorter gaps between the ranges keep the populations compact
+	sizes.rangeAlignment = (dev->type & CL_DEVICE_TYPE_CPU) ? CPU_COARSENING : RANGE_ALIGNMENT;
+	return sizes;
+}
+
+void workSizesProfile(icl_device* dev, char* path, size_t size) {
+	// the profiles are kept next to the cached kernel binaries
+	snprintf(path, size, "%s%s.%s.profile", ICL_BINARY_CACHE_PATH, dev->name, dev->driver_version);
+	for(char* c = path + strlen(ICL_BINARY_CACHE_PATH); *c; ++c)
+		if(!isalnum((int)*c) && *c != '.')
+			*c = '_';
+}
+
+int loadWorkSizes(icl_device* dev, struct WorkSizes* sizes) {
+	char path[512];
+	workSizesProfile(dev, path, sizeof(path));
+	FILE* file = fopen(path, "r");
+	if(!file)
+		return -1;
+
+	// one work size per line, its name followed by its value
+	char name[64];
+	UINT value;
+	while(fscanf(file, "%63s %u", name, &value) == 2) {
+		if(strcmp(name, "updateGroupSize") == 0)
+			sizes->updateGroupSize = value;
+		else if(strcmp(name, "coarsening") == 0)
+			sizes->coarsening = value;
+		else if(strcmp(name, "compactionGroupSize") == 0)
+			sizes->compactionGroupSize = value;
+		else if(strcmp(name, "chunksPerComputeUnit") == 0)
+			sizes->chunksPerComputeUnit = value;
+		else if(strcmp(name, "rangeAlignment") == 0)
+			sizes->rangeAlignment = value;
+	}
+	fclose(file);
+	return 0;
+}
+
+int storeWorkSizes(icl_device* dev, struct WorkSizes* sizes) {
+	char path[512];
+	workSizesProfile(dev, path, sizeof(path));
+	FILE* file = fopen(path, "w");
+	if(!file)
+		return -1;
+
+	fprintf(file, "updateGroupSize %u\n", sizes->updateGroupSize);
+	fprintf(file, "coarsening %u\n", sizes->coarsening);
+	fprintf(file, "compactionGroupSize %u\n", sizes->compactionGroupSize);
+	fprintf(file, "chunksPerComputeUnit %u\n", sizes->chunksPerComputeUnit);
+	fprintf(file, "rangeAlignment %u\n", sizes->rangeAlignment);
+	fclose(file);
+	return 0;
+}
+
+UINT fittingGroupSize(icl_kernel* kernel, UINT size) {
+	size_t limit = size;
+	clGetKernelWorkGroupInfo(kernel->kernel, kernel->dev->device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &limit, NULL);
+	while(size > 1 && size > limit)
+		size /= 2;
+	return size;
+}